@@ -0,0 +1,47 @@
+#ifndef SUPERCAMERA_BAND_POOL_H
+#define SUPERCAMERA_BAND_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace supercamera {
+
+// Persistent workers for splitting one frame's work into bands. run() hands
+// band i to worker i (band 0 runs on the caller) and returns once all bands
+// are done, so per-frame stages pay a wakeup rather than a thread start.
+// With one thread everything runs inline on the caller.
+class BandPool {
+public:
+    explicit BandPool(unsigned threads = 1);
+    ~BandPool();
+
+    unsigned threads() const { return threads_; }
+
+    // Calls fn(band, bands) for band in [0, bands); bands is at most threads()
+    void run(unsigned bands, const std::function<void(unsigned, unsigned)>& fn);
+
+private:
+    BandPool(const BandPool&);
+    BandPool& operator=(const BandPool&);
+
+    void worker(unsigned band);
+
+    unsigned threads_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    uint64_t generation_;
+    unsigned bands_;
+    unsigned pending_;
+    bool shutdown_;
+    const std::function<void(unsigned, unsigned)>* fn_;
+};
+
+} // namespace supercamera
+
+#endif // SUPERCAMERA_BAND_POOL_H
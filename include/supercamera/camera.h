@@ -0,0 +1,125 @@
+#ifndef SUPERCAMERA_CAMERA_H
+#define SUPERCAMERA_CAMERA_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "supercamera/frame_source.h"
+#include "supercamera/transfer_tuner.h"
+
+struct libusb_context;
+struct libusb_device_handle;
+struct libusb_transfer;
+
+namespace supercamera {
+
+// --- Camera Configuration (Corrected based on capture_usb_packets_3s.cpp) ---
+struct CameraConfig {
+    uint16_t vendor_id    = 0x0329;
+    uint16_t product_id   = 0x2022;
+    int interface_num     = 1;
+    int alt_setting       = 1;
+    int bulk_ep_in        = 0x81; // Correct IN endpoint
+    int bulk_ep_out       = 0x01; // Command endpoint (PC to Camera)
+    int transfer_size     = 512;
+    int transfers_in_flight = 1;             // Bulk IN transfers queued at once
+    unsigned int transfer_timeout_ms = 1000;
+    unsigned int frame_timeout_ms    = 3000; // next_frame() gives up after this long
+    bool zero_copy = true;                   // Receive into usbfs-mapped memory where the host supports it
+    bool autotune = false;                   // Pick the three settings above at start(), see autotune()
+    TunerConfig tuner;
+    Decimation decimation;                   // Skipped frames count against frame_timeout_ms
+};
+
+// The Geek Szitman supercamera (0329:2022) as an in-process frame source.
+// open() claims the interface, start()/stop() switch the stream on and off
+// and next_frame() handles bulk transfers until a complete frame is
+// assembled. While streaming, transfers_in_flight transfers stay queued and
+// are resubmitted as they complete, so the host controller always has a
+// buffer to fill.
+class Camera : public FrameSource {
+public:
+    explicit Camera(const CameraConfig& config = CameraConfig());
+    ~Camera();
+
+    bool open();
+    bool start() override;
+    void stop() override;
+    void close();
+
+    bool next_frame(Frame& frame) override;
+    bool needs_restart() const override;
+
+    // Streams briefly with every candidate in config().tuner, applies the
+    // best settings for this host and saves them for the device. With
+    // CameraConfig::autotune, start() loads saved settings instead and only
+    // tunes when there are none. Call between open() and start().
+    bool autotune(std::vector<TransferTrial>* trials = nullptr);
+
+    // Identifies the camera and its port in the tuning file
+    std::string device_key() const;
+
+    // Copies every received bulk transfer to `sink` (nullptr to disable),
+    // e.g. to keep a raw capture for later replay with RawFileSource
+    void set_raw_sink(std::ostream* sink) { raw_sink_ = sink; }
+
+    const CameraConfig& config() const { return config_; }
+    bool is_open() const { return dev_handle_ != nullptr; }
+    bool is_streaming() const { return streaming_; }
+    // True while transfers land directly in device memory mapped by usbfs,
+    // sparing the kernel's copy into a user buffer; false after a fallback
+    bool zero_copy() const { return device_buffer_; }
+    void set_decimation(const Decimation& decimation) { assembler_.set_decimation(decimation); }
+    void set_check_packet_sizes(bool check) { assembler_.set_check_packet_sizes(check); }
+    const FrameAssembler& assembler() const { return assembler_; }
+
+private:
+    Camera(const Camera&);
+    Camera& operator=(const Camera&);
+
+    // One queued bulk IN transfer
+    struct Slot {
+        Camera* camera;
+        libusb_transfer* transfer;
+        uint8_t* buffer;
+        std::chrono::steady_clock::time_point submitted;
+    };
+    struct TrialSamples;
+
+    static void transfer_callback(libusb_transfer* transfer);
+    void transfer_done(Slot& slot);
+
+    bool send_command(uint8_t command);
+    bool allocate_transfers();
+    void free_transfers();
+    bool submit_transfers();
+    void cancel_transfers();
+    bool use_host_buffers(int error);
+    bool apply_settings(const TransferSettings& settings);
+    bool tune(std::vector<TransferTrial>* trials);
+    bool run_trial(TransferTrial& trial);
+
+    CameraConfig config_;
+    libusb_context* ctx_;
+    libusb_device_handle* dev_handle_;
+    bool kernel_driver_detached_;
+    bool streaming_;
+    std::ostream* raw_sink_;
+    uint8_t* buffer_;                  // Device memory or host_buffer_, one slice per slot
+    bool device_buffer_;
+    std::vector<uint8_t> host_buffer_;
+    std::vector<Slot> slots_;
+    int in_flight_;
+    bool resubmit_;
+    int transfer_error_;               // libusb error of the first failed transfer, 0 if none
+    TrialSamples* samples_;            // While tuning: completions are measured, not deframed
+    bool tuned_;
+    FrameAssembler assembler_;
+};
+
+} // namespace supercamera
+
+#endif // SUPERCAMERA_CAMERA_H
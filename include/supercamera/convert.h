@@ -0,0 +1,96 @@
+#ifndef SUPERCAMERA_CONVERT_H
+#define SUPERCAMERA_CONVERT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "supercamera/frame.h"
+
+namespace supercamera {
+
+enum class PixelFormat {
+    RGB,         // Packed 8-bit
+    BGR,
+    RGBA,        // Alpha is 255
+    NV12,        // Y plane, then interleaved UV at half resolution (BT.601 video range)
+    I420,        // Y, U and V planes, chroma at half resolution (BT.601 video range)
+    PlanarFloat, // R, G and B planes of float in [0, 1]
+};
+
+// Clockwise rotation applied after resizing
+enum class Rotation { None, Cw90, Cw180, Cw270 };
+
+// Color space of the source Image, which does not record it
+enum class ColorSpace {
+    RGB,   // DecodeOptions::RGB
+    YCbCr, // DecodeOptions::YCbCr: full-range JPEG YCbCr
+};
+
+struct ConvertSpec {
+    PixelFormat format = PixelFormat::RGB;
+    ColorSpace input = ColorSpace::RGB;
+    int width = 0;  // Output size after rotation; 0 keeps the (rotated) source size
+    int height = 0;
+    Rotation rotation = Rotation::None;
+};
+
+// Planes are stored back to back in `data` in the order listed for the format
+struct ConvertedImage {
+    PixelFormat format = PixelFormat::RGB;
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> data;
+
+    const float* float_data() const { return reinterpret_cast<const float*>(data.data()); }
+};
+
+size_t converted_size(PixelFormat format, int width, int height);
+
+// Format conversion, bilinear resize and 90-degree rotation of a decoded
+// image in a single pass. The output is produced in tiles: each tile's
+// source pixels are sampled (AVX2 gathers) into small planar buffers that
+// stay in L1, from which the SSE2/AVX2 kernels write the packed, Y/UV or
+// float output. Rotated output therefore walks the source in cache-sized
+// blocks instead of whole columns. For downscaling by more than 2x, decode
+// with DecodeOptions::scale_denom first; bilinear sampling only looks at the
+// four nearest pixels.
+//
+// With ColorSpace::YCbCr input, NV12 and I420 only rescale the JPEG's
+// full-range YCbCr to video range, so the decoder's color conversion and the
+// RGB round trip are both skipped; the other formats convert to RGB with the
+// JFIF matrix. Set `input` to match how the image was decoded: an Image does
+// not record its color space.
+class PixelConverter {
+public:
+    explicit PixelConverter(const ConvertSpec& spec = ConvertSpec());
+
+    // Fails unless the source has 3 channels, and for odd NV12/I420 output sizes
+    bool convert(const Image& source, ConvertedImage& out);
+
+    const ConvertSpec& spec() const { return spec_; }
+
+private:
+    // Per output column (A) and row (B): byte offset of the sample in the
+    // source, offset to its bilinear neighbour and the neighbour's weight
+    struct Taps {
+        std::vector<uint32_t> offset;
+        std::vector<uint32_t> step;
+        std::vector<uint16_t> weight; // 0..255 out of 256
+    };
+
+    void build_taps(int src_width, int src_height, int out_width, int out_height);
+
+    ConvertSpec spec_;
+    int src_width_;
+    int src_height_;
+    int out_width_;
+    int out_height_;
+    Taps a_;
+    Taps b_;
+    std::vector<uint8_t> tile_;
+};
+
+} // namespace supercamera
+
+#endif // SUPERCAMERA_CONVERT_H
@@ -0,0 +1,398 @@
+#ifndef SUPERCAMERA_CORO_H
+#define SUPERCAMERA_CORO_H
+
+// Optional C++20 layer: lets coroutines co_await frames from any FrameSource
+// without a thread per consumer.
+//
+//   EventLoop loop;
+//   AsyncCamera cam(camera, loop);
+//   cam.start();
+//   spawn: FrameResult r = co_await cam.next_frame(std::chrono::milliseconds(500), token);
+//   loop.run();
+//
+// A single capture thread reads the source and publishes each frame to a
+// FrameHub; waiting coroutines are resumed on the EventLoop thread, sharing
+// one immutable Frame. Waits end with a frame, a timeout, cancellation
+// through a CancellationToken, or the stream closing.
+
+#if !defined(__cpp_impl_coroutine) && !defined(__cpp_coroutines)
+#error "supercamera/coro.h requires C++20 coroutines (-std=c++20)"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "supercamera/frame.h"
+#include "supercamera/frame_source.h"
+
+namespace supercamera {
+namespace coro {
+
+using Clock = std::chrono::steady_clock;
+
+// --- Event loop: posted callbacks plus one-shot timers, run on one thread ---
+class EventLoop {
+public:
+    using Callback = std::function<void()>;
+
+    // Thread-safe
+    void post(Callback fn) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ready_.push_back(std::move(fn));
+        }
+        cv_.notify_one();
+    }
+
+    // Thread-safe; returns an id for cancel_timer()
+    uint64_t call_at(Clock::time_point when, Callback fn) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t id = next_timer_id_++;
+        timers_.emplace(TimerKey(when, id), std::move(fn));
+        timer_keys_.emplace(id, when);
+        cv_.notify_one();
+        return id;
+    }
+
+    void cancel_timer(uint64_t id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = timer_keys_.find(id);
+        if (it != timer_keys_.end()) {
+            timers_.erase(TimerKey(it->second, id));
+            timer_keys_.erase(it);
+        }
+    }
+
+    // Runs callbacks and due timers until stop()
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopped_) {
+            auto now = Clock::now();
+            while (!timers_.empty() && timers_.begin()->first.first <= now) {
+                ready_.push_back(std::move(timers_.begin()->second));
+                timer_keys_.erase(timers_.begin()->first.second);
+                timers_.erase(timers_.begin());
+            }
+            if (ready_.empty()) {
+                if (timers_.empty()) {
+                    cv_.wait(lock);
+                } else {
+                    cv_.wait_until(lock, timers_.begin()->first.first);
+                }
+                continue;
+            }
+            std::deque<Callback> batch;
+            batch.swap(ready_);
+            lock.unlock();
+            for (auto& fn : batch) {
+                fn();
+            }
+            lock.lock();
+        }
+        stopped_ = false;
+    }
+
+    // Thread-safe; run() returns after the current batch
+    void stop() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+        cv_.notify_one();
+    }
+
+private:
+    using TimerKey = std::pair<Clock::time_point, uint64_t>;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Callback> ready_;
+    std::map<TimerKey, Callback> timers_;
+    std::map<uint64_t, Clock::time_point> timer_keys_;
+    uint64_t next_timer_id_ = 1;
+    bool stopped_ = false;
+};
+
+// --- Cancellation ---
+class CancellationToken {
+public:
+    CancellationToken() = default;
+
+    bool can_be_cancelled() const { return state_ != nullptr; }
+    bool is_cancelled() const { return state_ && state_->cancelled.load(); }
+
+    // Runs fn (immediately if already cancelled); returns an id for unregister()
+    uint64_t on_cancel(std::function<void()> fn) const {
+        if (!state_) {
+            return 0;
+        }
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        if (state_->cancelled) {
+            lock.unlock();
+            fn();
+            return 0;
+        }
+        uint64_t id = state_->next_id++;
+        state_->callbacks.emplace(id, std::move(fn));
+        return id;
+    }
+
+    void unregister(uint64_t id) const {
+        if (state_ && id) {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            state_->callbacks.erase(id);
+        }
+    }
+
+private:
+    friend class CancellationSource;
+
+    struct State {
+        std::mutex mutex;
+        std::atomic<bool> cancelled{false};
+        std::map<uint64_t, std::function<void()>> callbacks;
+        uint64_t next_id = 1;
+    };
+
+    explicit CancellationToken(std::shared_ptr<State> state) : state_(std::move(state)) {}
+
+    std::shared_ptr<State> state_;
+};
+
+class CancellationSource {
+public:
+    CancellationSource() : state_(std::make_shared<CancellationToken::State>()) {}
+
+    CancellationToken token() const { return CancellationToken(state_); }
+
+    void cancel() {
+        std::map<uint64_t, std::function<void()>> callbacks;
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            if (state_->cancelled.exchange(true)) {
+                return;
+            }
+            callbacks.swap(state_->callbacks);
+        }
+        for (auto& entry : callbacks) {
+            entry.second();
+        }
+    }
+
+private:
+    std::shared_ptr<CancellationToken::State> state_;
+};
+
+// --- Frame waiting ---
+enum class WaitStatus { Frame, Timeout, Cancelled, Closed };
+
+struct FrameResult {
+    WaitStatus status = WaitStatus::Closed;
+    std::shared_ptr<const Frame> frame;
+
+    explicit operator bool() const { return status == WaitStatus::Frame; }
+};
+
+// Fans frames out from one publisher to any number of waiting coroutines
+class FrameHub {
+    struct Waiter {
+        std::coroutine_handle<> handle;
+        std::atomic<bool> done{false};
+        FrameResult result;
+        uint64_t timer_id = 0;
+        uint64_t cancel_id = 0;
+    };
+
+public:
+    class Awaiter {
+    public:
+        Awaiter(FrameHub& hub, Clock::duration timeout, CancellationToken token)
+            : hub_(hub), timeout_(timeout), token_(std::move(token)), waiter_(std::make_shared<Waiter>()) {}
+
+        bool await_ready() {
+            if (token_.is_cancelled()) {
+                waiter_->result.status = WaitStatus::Cancelled;
+                return true;
+            }
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            waiter_->handle = handle;
+            if (!hub_.add(waiter_)) {
+                waiter_->result.status = WaitStatus::Closed;
+                return false;
+            }
+            std::weak_ptr<Waiter> weak = waiter_;
+            FrameHub* hub = &hub_;
+            if (timeout_ > Clock::duration::zero()) {
+                waiter_->timer_id = hub_.loop_.call_at(Clock::now() + timeout_, [hub, weak]() {
+                    if (auto w = weak.lock()) {
+                        hub->complete(w, WaitStatus::Timeout, nullptr);
+                    }
+                });
+            }
+            waiter_->cancel_id = token_.on_cancel([hub, weak]() {
+                if (auto w = weak.lock()) {
+                    hub->complete(w, WaitStatus::Cancelled, nullptr);
+                }
+            });
+            return true;
+        }
+
+        FrameResult await_resume() {
+            if (waiter_->timer_id) {
+                hub_.loop_.cancel_timer(waiter_->timer_id);
+            }
+            token_.unregister(waiter_->cancel_id);
+            return std::move(waiter_->result);
+        }
+
+    private:
+        FrameHub& hub_;
+        Clock::duration timeout_;
+        CancellationToken token_;
+        std::shared_ptr<Waiter> waiter_;
+    };
+
+    explicit FrameHub(EventLoop& loop) : loop_(loop) {}
+
+    // Waits for the next published frame; a zero timeout waits indefinitely
+    Awaiter next_frame(Clock::duration timeout = Clock::duration::zero(),
+                       CancellationToken token = CancellationToken()) {
+        return Awaiter(*this, timeout, std::move(token));
+    }
+
+    // Thread-safe; resumes every current waiter with the same frame
+    void publish(std::shared_ptr<const Frame> frame) {
+        std::vector<std::shared_ptr<Waiter>> waiters;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            waiters.swap(waiters_);
+        }
+        for (auto& w : waiters) {
+            complete(w, WaitStatus::Frame, frame);
+        }
+    }
+
+    // Thread-safe; current and future waits end with WaitStatus::Closed
+    void close() {
+        std::vector<std::shared_ptr<Waiter>> waiters;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            waiters.swap(waiters_);
+        }
+        for (auto& w : waiters) {
+            complete(w, WaitStatus::Closed, nullptr);
+        }
+    }
+
+    size_t waiting() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return waiters_.size();
+    }
+
+private:
+    bool add(const std::shared_ptr<Waiter>& waiter) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_) {
+            return false;
+        }
+        waiters_.push_back(waiter);
+        return true;
+    }
+
+    void complete(const std::shared_ptr<Waiter>& waiter, WaitStatus status, std::shared_ptr<const Frame> frame) {
+        if (waiter->done.exchange(true)) {
+            return; // Another outcome won the race
+        }
+        if (status != WaitStatus::Frame && status != WaitStatus::Closed) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t i = 0; i < waiters_.size(); ++i) {
+                if (waiters_[i] == waiter) {
+                    waiters_[i] = waiters_.back();
+                    waiters_.pop_back();
+                    break;
+                }
+            }
+        }
+        waiter->result.status = status;
+        waiter->result.frame = std::move(frame);
+        std::coroutine_handle<> handle = waiter->handle;
+        loop_.post([handle]() { handle.resume(); });
+    }
+
+    EventLoop& loop_;
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<Waiter>> waiters_;
+    bool closed_ = false;
+};
+
+// Runs the blocking capture loop of a FrameSource on one thread and exposes
+// its frames as awaitables
+class AsyncCamera {
+public:
+    AsyncCamera(FrameSource& source, EventLoop& loop) : source_(source), hub_(loop) {}
+    ~AsyncCamera() { stop(); }
+
+    void start() {
+        running_ = true;
+        thread_ = std::thread([this]() {
+            while (running_) {
+                std::shared_ptr<Frame> frame = std::make_shared<Frame>();
+                if (!source_.next_frame(*frame)) {
+                    break;
+                }
+                hub_.publish(std::move(frame));
+            }
+            hub_.close();
+        });
+    }
+
+    // Returns once the source's current next_frame() call completes
+    void stop() {
+        running_ = false;
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    FrameHub::Awaiter next_frame(Clock::duration timeout = Clock::duration::zero(),
+                                 CancellationToken token = CancellationToken()) {
+        return hub_.next_frame(timeout, std::move(token));
+    }
+
+    FrameHub& hub() { return hub_; }
+
+private:
+    FrameSource& source_;
+    FrameHub hub_;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
+
+// Fire-and-forget coroutine type for tasks started on the event loop
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+} // namespace coro
+} // namespace supercamera
+
+#endif // SUPERCAMERA_CORO_H
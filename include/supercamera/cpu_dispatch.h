@@ -0,0 +1,49 @@
+#ifndef SUPERCAMERA_CPU_DISPATCH_H
+#define SUPERCAMERA_CPU_DISPATCH_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace supercamera {
+
+// Instruction set levels, in increasing order
+enum class CpuLevel { Scalar, SSE2, SSE41, AVX2, AVX512 };
+
+const char* cpu_level_name(CpuLevel level);
+
+// Best level this CPU (and OS) supports
+CpuLevel detected_cpu_level();
+
+// Level the kernels were bound for: detected_cpu_level(), lowered by the
+// SUPERCAMERA_CPU_LEVEL environment variable (scalar, sse2, sse4.1, avx2,
+// avx512) to force a slower variant for testing. Requests above what the
+// CPU supports are ignored.
+CpuLevel active_cpu_level();
+
+// Level of the code that actually runs for active_cpu_level(): SSE4.1 and
+// AVX-512 have no variants of their own, so they report SSE2 and AVX2.
+// Use this, not active_cpu_level(), when labelling results.
+CpuLevel bound_cpu_level();
+
+// Byte-stream kernels used by the deframer (and the focus metric), each bound once at first use to
+// the best variant for active_cpu_level(). Levels without a dedicated
+// variant use the next lower one.
+struct Kernels {
+    // Index of the first byte equal to `value` in p[0..n), or n
+    size_t (*find_byte)(const uint8_t* p, size_t n, uint8_t value);
+    // Index of the first "FF <second>" pair starting in p[0..n-1), or n
+    size_t (*find_marker)(const uint8_t* p, size_t n, uint8_t second);
+    // Rewrites every FF 24 pair in p[0..n) to FF 00
+    void (*unstuff)(uint8_t* p, size_t n);
+    // Adds the sum and sum of squares of the 4-neighbour Laplacian at
+    // row[1..n-1) (using the rows above and below) to *sum and *sum_sq
+    void (*laplacian_row)(const uint8_t* above, const uint8_t* row, const uint8_t* below, size_t n,
+                          int64_t* sum, int64_t* sum_sq);
+    CpuLevel level;
+};
+
+const Kernels& kernels();
+
+} // namespace supercamera
+
+#endif // SUPERCAMERA_CPU_DISPATCH_H
@@ -0,0 +1,85 @@
+#ifndef SUPERCAMERA_DECODE_CACHE_H
+#define SUPERCAMERA_DECODE_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "supercamera/decoder.h"
+#include "supercamera/frame.h"
+
+namespace supercamera {
+
+// Keeps frames compressed until someone asks for pixels. add() only stores
+// the JPEG (the last max_frames of them); image() decodes on first request
+// and keeps the result in an LRU cache bounded by max_decoded_bytes, keyed
+// by frame id and every DecodeOptions field, so a review tool scrubbing back
+// and forth over the same frames decodes each (frame, scale, format) once.
+// Images are shared, so evicting one never invalidates a caller's copy.
+// All calls are thread-safe; decodes are serialized on one Decoder.
+class DecodeCache {
+public:
+    static const size_t DEFAULT_MAX_DECODED_BYTES = 64 * 1024 * 1024;
+    static const size_t DEFAULT_MAX_FRAMES = 300;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;        // Requests that had to decode
+        uint64_t evictions = 0;     // Decoded images dropped to stay within max_decoded_bytes
+        uint64_t unknown_frames = 0;
+        uint64_t decode_errors = 0;
+        size_t decoded_bytes = 0;
+        size_t frames = 0;          // Compressed frames held
+    };
+
+    explicit DecodeCache(size_t max_decoded_bytes = DEFAULT_MAX_DECODED_BYTES,
+                         size_t max_frames = DEFAULT_MAX_FRAMES);
+
+    // Takes ownership of the frame's bytes; pass with std::move to avoid a copy
+    void add(Frame frame);
+    bool contains(uint64_t frame_id) const;
+
+    // nullptr if the frame is unknown (never added or already evicted) or fails to decode
+    std::shared_ptr<const Image> image(uint64_t frame_id, const DecodeOptions& options = DecodeOptions());
+
+    Stats stats() const;
+
+private:
+    DecodeCache(const DecodeCache&);
+    DecodeCache& operator=(const DecodeCache&);
+
+    struct Key {
+        uint64_t frame_id;
+        unsigned scale_denom;
+        int profile;
+        int format;
+        bool stats;
+        bool resilient;
+
+        bool operator<(const Key& other) const;
+    };
+
+    struct Entry {
+        Key key;
+        std::shared_ptr<const Image> image;
+    };
+
+    typedef std::list<Entry> LruList; // Most recently used first
+
+    size_t max_decoded_bytes_;
+    size_t max_frames_;
+
+    mutable std::mutex mutex_;
+    std::map<uint64_t, std::shared_ptr<const Frame>> frames_;
+    LruList lru_;
+    std::map<Key, LruList::iterator> index_;
+    Decoder decoder_;
+    Stats stats_;
+};
+
+} // namespace supercamera
+
+#endif // SUPERCAMERA_DECODE_CACHE_H
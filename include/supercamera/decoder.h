@@ -0,0 +1,72 @@
+#ifndef SUPERCAMERA_DECODER_H
+#define SUPERCAMERA_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "supercamera/frame.h"
+#include "supercamera/pyramid.h"
+
+namespace supercamera {
+
+// Trades quality for speed; the governor switches these under load
+struct DecodeOptions {
+    enum Profile { Quality, Fast };
+    enum Format { RGB, Gray, YCbCr };
+
+    unsigned scale_denom = 1;  // 1, 2, 4 or 8: downscale in the IDCT, output is 1/N per side
+    Profile profile = Quality; // Fast: integer IDCT, no fancy upsampling or block smoothing
+    Format format = RGB;       // Gray skips chroma entirely (one channel); YCbCr skips the
+                               // color conversion (interleaved Y, Cb, Cr)
+    bool stats = false;        // Fill Image::stats as scanlines are decoded. A convenience, not a
+                               // speedup: about 0.3 ms per 640x480 frame, no less than a separate pass
+    bool resilient = false;    // Keep the rows decoded before corrupt or missing data instead of
+                               // failing the frame; see Image::valid_rows
+};
+
+// libjpeg decoder producing interleaved RGB (or gray). The decompressor object
+// is created once and reused for every frame, so steady-state decoding does
+// not allocate beyond growing the output image.
+class Decoder {
+public:
+    Decoder();
+    ~Decoder();
+
+    bool decode(const Frame& frame, Image& image);
+    bool decode(const uint8_t* jpeg, size_t size, Image& image, uint64_t frame_id = 0);
+
+    // Decodes level 0 (scaled by options().scale_denom in the IDCT) and
+    // fills up to `levels` levels in total, halving each row pair into the
+    // next level as soon as the decoder has written it
+    bool decode_pyramid(const uint8_t* jpeg, size_t size, Pyramid& pyramid, int levels, uint64_t frame_id = 0);
+
+    // Block-level statistics in the configured format without decoding any
+    // pixels: each 8x8 luma block contributes its mean, read from the DC
+    // coefficients (with the co-sited chroma block's for color). Enough for
+    // exposure and "lens covered" checks at a fraction of a decode.
+    bool coarse_stats(const uint8_t* jpeg, size_t size, ImageStats& stats, uint64_t frame_id = 0);
+
+    void set_options(const DecodeOptions& options) { options_ = options; }
+    const DecodeOptions& options() const { return options_; }
+
+private:
+    Decoder(const Decoder&);
+    Decoder& operator=(const Decoder&);
+
+    struct Sink;
+    struct ImageSink;
+    struct PyramidSink;
+
+    bool run(const uint8_t* jpeg, size_t size, uint64_t frame_id, Sink& sink, ImageStats& stats);
+    int intact_rows() const;
+    void take_rows(int end, Sink& sink, ImageStats& stats);
+    int salvage(Sink& sink, ImageStats& stats);
+
+    struct State;
+    State* state_;
+    DecodeOptions options_;
+};
+
+} // namespace supercamera
+
+#endif // SUPERCAMERA_DECODER_H
@@ -0,0 +1,70 @@
+#ifndef SUPERCAMERA_DENOISE_H
+#define SUPERCAMERA_DENOISE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "supercamera/band_pool.h"
+#include "supercamera/frame.h"
+
+namespace supercamera {
+
+struct DenoiseConfig {
+    int block = 16;        // Motion is judged per block x block pixels
+    int strength = 192;    // Weight of the history in static blocks, 0..255 (0 disables)
+    int noise_level = 8;   // Mean absolute difference per byte still treated as noise; the
+                           // history weight fades to 0 at twice this
+    unsigned threads = 1;
+};
+
+// Recursive temporal filter for low-light noise: each output is a weighted
+// mean of the new frame and the previous output, kept in one frame-sized
+// state buffer that is allocated on the first frame and reused after that.
+// The weight is chosen per block from the mean absolute difference to the
+// state (psadbw on SSE2/AVX2), so static areas are averaged over many frames
+// while moving ones follow the new frame; motion spreads to the neighbouring
+// blocks to avoid trails at object edges. Works on any interleaved Image
+// (RGB, or YCbCr straight from the decoder, luma and chroma alike) and
+// filters in place with no added latency. Every CPU level and thread count
+// produces the same bytes.
+class TemporalDenoiser {
+public:
+    explicit TemporalDenoiser(const DenoiseConfig& config = DenoiseConfig());
+
+    // The first frame (and the first after a size change or reset()) only
+    // seeds the state and passes through unchanged
+    bool apply(Image& image);
+    void reset();
+
+    // Share of blocks in the last frame whose history weight was lowered for motion
+    double moving_fraction() const { return moving_fraction_; }
+
+    const DenoiseConfig& config() const { return config_; }
+
+private:
+    TemporalDenoiser(const TemporalDenoiser&);
+    TemporalDenoiser& operator=(const TemporalDenoiser&);
+
+    void measure_blocks(const Image& image, int by0, int by1);
+    void choose_weights();
+    void filter_rows(Image& image, int y0, int y1, uint8_t* weights);
+
+    DenoiseConfig config_;
+    int width_;
+    int height_;
+    int channels_;
+    int blocks_x_;
+    int blocks_y_;
+    std::vector<uint8_t> state_;        // Previous output
+    std::vector<uint32_t> sad_;         // Per block
+    std::vector<uint8_t> block_weight_; // Per block, history weight from its own difference
+    std::vector<uint8_t> weight_;       // Per block, after spreading
+    std::vector<uint8_t> scratch_;      // Per band: one row of per-byte weights
+    double moving_fraction_;
+    BandPool pool_;
+};
+
+} // namespace supercamera
+
+#endif // SUPERCAMERA_DENOISE_H
@@ -0,0 +1,87 @@
+#ifndef SUPERCAMERA_DUAL_PATH_H
+#define SUPERCAMERA_DUAL_PATH_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "supercamera/decoder.h"
+#include "supercamera/frame.h"
+
+namespace supercamera {
+
+struct DualPathConfig {
+    unsigned preview_scale_denom = 2;                  // Preview is decoded at 1/N per side
+    DecodeOptions::Profile preview_profile = DecodeOptions::Fast;
+    size_t retained_frames = 60;                       // Compressed frames kept for request_full()
+};
+
+// Live preview plus full quality on demand. Every submitted frame is decoded
+// at reduced scale for the preview, and its compressed bytes are retained so
+// that a full-resolution, full-quality decode of that exact frame can be
+// requested later (e.g. when an operator freezes the view for export).
+// Decoding runs on one worker thread; full-resolution requests are served
+// before the next preview, and a preview that is superseded by a newer frame
+// before the worker reaches it is skipped rather than queued.
+class DualPathDecoder {
+public:
+    typedef std::function<void(const Frame&, const Image&)> ImageCallback;
+
+    struct Stats {
+        uint64_t previews = 0;
+        uint64_t previews_skipped = 0; // Superseded by a newer frame before being decoded
+        uint64_t full_decodes = 0;
+        uint64_t full_misses = 0;      // Requested frame no longer retained
+        uint64_t decode_errors = 0;
+    };
+
+    // Callbacks run on the worker thread and must not block
+    explicit DualPathDecoder(ImageCallback on_preview, const DualPathConfig& config = DualPathConfig());
+    ~DualPathDecoder();
+
+    // Takes ownership of the frame's bytes; pass with std::move to avoid a copy
+    void submit(Frame frame);
+
+    // Queues a full-resolution decode of a retained frame ahead of any pending
+    // preview. Returns false if the frame has already been evicted; otherwise
+    // on_full runs exactly once, with an empty image (width 0) if the decode
+    // fails or the decoder is destroyed before reaching the request.
+    bool request_full(uint64_t frame_id, ImageCallback on_full);
+
+    Stats stats() const;
+
+private:
+    DualPathDecoder(const DualPathDecoder&);
+    DualPathDecoder& operator=(const DualPathDecoder&);
+
+    typedef std::shared_ptr<const Frame> FramePtr;
+
+    struct FullRequest {
+        FramePtr frame;
+        ImageCallback callback;
+    };
+
+    void run();
+
+    DualPathConfig config_;
+    ImageCallback on_preview_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<FramePtr> retained_;
+    std::deque<FullRequest> full_requests_;
+    FramePtr pending_preview_;
+    bool shutdown_;
+    Stats stats_;
+
+    std::thread thread_;
+};
+
+} // namespace supercamera
+
+#endif // SUPERCAMERA_DUAL_PATH_H
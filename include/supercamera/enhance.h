@@ -0,0 +1,108 @@
+#ifndef SUPERCAMERA_ENHANCE_H
+#define SUPERCAMERA_ENHANCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "supercamera/band_pool.h"
+#include "supercamera/frame.h"
+
+namespace supercamera {
+
+struct EnhanceConfig {
+    // How to read three-channel images. YCbCr (DecodeOptions::YCbCr) equalizes
+    // channel 0 directly and leaves chroma alone; RGB equalizes the BT.601
+    // luma and scales all three channels by the same gain, preserving hue.
+    // One-channel images are always treated as luma.
+    enum ColorSpace { RGB, YCbCr };
+
+    ColorSpace color_space = RGB;
+    bool clahe = true;
+    int tiles_x = 8;          // Contextual regions across and down the frame
+    int tiles_y = 8;
+    double clip_limit = 2.0;  // Histogram bin ceiling as a multiple of the mean bin; <= 0 disables clipping
+    unsigned threads = 1;
+};
+
+// Fills curve with the gamma correction v' = 255 * (v / 255)^(1 / gamma);
+// gamma > 1 brightens the shadows
+void make_gamma_curve(double gamma, uint8_t curve[256]);
+
+// Contrast enhancement for the live view, applied in place in three steps:
+// contrast-limited adaptive histogram equalization (CLAHE) of luma, per-channel
+// 1D curves, then an optional 3D color LUT. CLAHE histograms are gathered per
+// tile, tile rows split across the worker threads. The four tile mappings a
+// pixel blends are stored side by side, so each pixel costs one 32-bit
+// lookup; the rest runs in row bands. The blend, RGB gain and color LUT have
+// SSE2 and AVX2 kernels; luma, the quad lookups and the curves have AVX2
+// kernels that gather eight table entries at a time.
+// Curves are folded into the color LUT's input when both are set. All
+// arithmetic is fixed point, so every CPU level and thread count produces
+// the same bytes. Steps that are disabled or unset cost nothing.
+class Enhancer {
+public:
+    explicit Enhancer(const EnhanceConfig& config = EnhanceConfig());
+
+    // Curve applied to channel 0..2 after CLAHE
+    bool set_curve(int channel, const uint8_t curve[256]);
+    void clear_curves();
+
+    // size^3 output triples (size 2..65) with the first channel varying
+    // fastest, as in .cube files; interpolated tetrahedrally. Channels are
+    // taken as stored, so for YCbCr images the table maps YCbCr triples.
+    bool set_color_lut(int size, const std::vector<uint8_t>& table);
+    void clear_color_lut();
+
+    // Fails for images that are not one- or three-channel, or smaller than
+    // one pixel per tile
+    bool apply(Image& image);
+
+    const EnhanceConfig& config() const { return config_; }
+
+private:
+    Enhancer(const Enhancer&);
+    Enhancer& operator=(const Enhancer&);
+
+    // Tile geometry along one axis: per pixel, the first of the two tiles
+    // whose centres bracket it and the weight of the second, 0..128
+    struct Axis {
+        std::vector<int> start; // tiles + 1 boundaries
+        std::vector<uint16_t> first;
+        std::vector<uint16_t> weight;
+    };
+
+    void prepare(int width, int height, int channels);
+    void equalize_tiles(const Image& image, int ty0, int ty1);
+    void build_quads();
+    void enhance_rows(Image& image, int y0, int y1, uint8_t* scratch);
+    void compose_color_lut();
+
+    EnhanceConfig config_;
+    int width_;
+    int height_;
+    int channels_;
+    Axis cols_;
+    Axis rows_;
+    std::vector<uint32_t> col_weights_; // (128 - w) | w << 16, a pmaddwd pair
+    std::vector<uint8_t> luma_;         // RGB input only
+    std::vector<uint8_t> tile_lut_;     // 256 entries per tile, row-major
+    std::vector<uint8_t> tile_quads_;   // Per tile and value: itself, right, below, below right
+    std::vector<uint8_t> scratch_;      // Per band: gathered quads and the blend for one row
+
+    uint32_t curves_[3][256]; // Widened so the AVX2 kernel can gather them
+    bool has_curves_;
+
+    int lut_size_;
+    std::vector<uint8_t> color_lut_; // RGB plus a pad byte per entry
+    // Per channel and input value (after its curve): byte offset of the
+    // lower grid point along that axis << 9 | the weight of the upper, 0..256.
+    // One 32-bit entry, so the AVX2 kernel fetches both with one gather.
+    uint32_t lut_axis_[3][256];
+
+    BandPool pool_;
+};
+
+} // namespace supercamera
+
+#endif // SUPERCAMERA_ENHANCE_H
@@ -0,0 +1,46 @@
+#ifndef SUPERCAMERA_FRAME_H
+#define SUPERCAMERA_FRAME_H
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace supercamera {
+
+// One JPEG frame as delivered by a FrameSource: complete SOI..EOI with the
+// camera's FF 24 stuffing already replaced, ready for any JPEG decoder
+struct Frame {
+    uint64_t id = 0;
+    std::chrono::steady_clock::time_point timestamp; // When the EOI arrived
+    std::vector<uint8_t> jpeg;
+};
+
+// Per-channel statistics of a decoded image, gathered by the Decoder while
+// it writes scanlines (DecodeOptions::stats) or from the DC coefficients
+// alone (Decoder::coarse_stats, the cheap one)
+struct ImageStats {
+    enum Source { None, Pixels, Blocks };
+
+    Source source = None;            // Blocks: one sample per 8x8 luma block (its mean)
+    int channels = 0;                // In the decoder's output format
+    uint64_t samples = 0;            // Per channel
+    uint32_t histogram[3][256] = {};
+    double mean[3] = {};
+    double variance[3] = {};
+    uint64_t clipped_low[3] = {};    // Samples at 0
+    uint64_t clipped_high[3] = {};   // Samples at 255
+};
+
+// Decoded pixels, rows packed without padding
+struct Image {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    std::vector<uint8_t> pixels;
+    int valid_rows = 0; // Rows decoded from intact data; the rest were filled (DecodeOptions::resilient)
+    ImageStats stats;   // source is None unless the decoder was asked for them
+};
+
+} // namespace supercamera
+
+#endif // SUPERCAMERA_FRAME_H
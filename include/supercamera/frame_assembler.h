@@ -0,0 +1,135 @@
+#ifndef SUPERCAMERA_FRAME_ASSEMBLER_H
+#define SUPERCAMERA_FRAME_ASSEMBLER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace supercamera {
+
+// A complete SOI..EOI JPEG frame, still carrying the camera's FF 24 stuffing
+struct AssembledFrame {
+    uint64_t id = 0;
+    std::vector<uint8_t> data;
+};
+
+// Capture-side rate control for consumers that need far fewer frames than the
+// camera sends. every_nth and max_fps are decided when the SOI is seen, so a
+// skipped frame is only scanned for its EOI and never copied. Keep-on-change
+// is decided at EOI from the compressed size (a static scene compresses to
+// nearly the same size every frame) and drops the frame before unstuffing or
+// decoding. Skipped frames still consume a frame id.
+struct Decimation {
+    unsigned every_nth = 1;        // Keep one frame in N
+    double max_fps = 0;            // Pace kept frames on their SOI arrival time; 0 = unlimited
+    double change_threshold = 0;   // Drop frames within this fraction of the last kept size; 0 = off
+    unsigned max_unchanged_ms = 0; // With change_threshold, still keep one frame this often; 0 = never
+};
+
+// Incremental deframer for the camera's bulk stream. Bytes are pushed as they
+// arrive from the endpoint (in any chunking); the 12-byte "AA BB 07" vendor
+// packet headers are stripped, the payloads are scanned for SOI/EOI and each
+// complete frame is queued for pop_frame(). Bytes before the first packet
+// header and between EOI and the next SOI are discarded.
+//
+// Lost data is inferred from the stream's structure. A new SOI cannot appear
+// before the current frame's EOI, so an SOI inside a frame (resyncs) drops
+// just that frame, which still consumes its id, and assembly picks up again
+// at the next SOI instead of stitching unrelated payloads together.
+// Optionally (set_check_packet_sizes) a packet of the wrong size inside a
+// frame (packet_gaps) drops it too, on the assumption that every packet but
+// a frame's last is full. That holds for the synthetic corpus but has not
+// been checked against a real capture, nor has whether bytes 3-11 of the
+// vendor header carry a sequence number, so it is off by default. A packet
+// lost whole leaves no trace in the framing; resilient decoding
+// (DecodeOptions::resilient) is the remaining line of defence.
+class FrameAssembler {
+public:
+    static const size_t PACKET_HEADER_SIZE = 12;
+    static const size_t DEFAULT_MAX_FRAME_SIZE = 4 * 1024 * 1024;
+
+    struct Stats {
+        uint64_t bytes_in = 0;
+        uint64_t packets = 0;
+        uint64_t payload_bytes = 0;
+        uint64_t frames = 0;
+        uint64_t discarded_bytes = 0;  // Payload outside any SOI..EOI frame
+        uint64_t oversized_frames = 0; // Frames dropped for exceeding max_frame_size
+        uint64_t skipped_frames = 0;   // Frames dropped by the Decimation policy
+        uint64_t packet_gaps = 0;      // Packets of the wrong size inside a frame (set_check_packet_sizes)
+        uint64_t resyncs = 0;          // SOIs inside a frame: its EOI was lost
+        uint64_t damaged_frames = 0;   // Frames dropped for either of the above
+    };
+
+    explicit FrameAssembler(size_t max_frame_size = DEFAULT_MAX_FRAME_SIZE);
+
+    void push(const uint8_t* data, size_t length);
+    // Flushes bytes held back while checking for a header split across pushes
+    void finish();
+    // Drops any partial frame and the counters, for a new stream. Frame ids
+    // keep counting up, so an id never names two frames of one assembler.
+    void reset();
+
+    // Takes effect from the next SOI; reset() keeps the policy
+    void set_decimation(const Decimation& decimation);
+    const Decimation& decimation() const { return decimation_; }
+
+    // Drop frames with a packet of the wrong size (default off, see above);
+    // reset() keeps the setting
+    void set_check_packet_sizes(bool check) { check_packet_sizes_ = check; }
+    bool check_packet_sizes() const { return check_packet_sizes_; }
+
+    // The buffer `frame.data` held before is kept and filled with a later
+    // frame, so a consumer that reuses its AssembledFrame cycles the same
+    // few buffers instead of growing a new one per frame
+    bool pop_frame(AssembledFrame& frame);
+    size_t frames_ready() const { return ready_.size(); }
+    bool frame_in_progress() const { return in_frame_; }
+    const Stats& stats() const { return stats_; }
+
+private:
+    enum ParseState { SEEK_HEADER, PAYLOAD, HEADER };
+
+    void begin_header();
+    void on_payload(const uint8_t* p, size_t n);
+    bool admit_frame();
+    void complete_frame();
+    void skip_frame(size_t frame_bytes);
+    void drop_damaged_frame();
+
+    size_t max_frame_size_;
+    ParseState state_;
+    size_t magic_matched_;    // Header magic bytes seen so far (held back from the payload)
+    size_t header_remaining_;
+    uint64_t header_offset_;
+    uint64_t packet_payload_;
+    uint64_t full_packet_payload_; // 0 until learned
+    uint64_t last_packet_payload_; // Of the last packet without an EOI
+    bool eoi_in_packet_;
+
+    bool in_frame_;
+    bool skipping_;           // Current frame was rejected at SOI; only its EOI is tracked
+    size_t skipped_size_;
+    bool prev_ff_;            // Last payload byte was 0xFF (marker split across chunks)
+    uint64_t next_frame_id_;
+    std::vector<uint8_t> frame_;
+    std::deque<AssembledFrame> ready_;
+    std::vector<std::vector<uint8_t> > spare_; // Buffers handed back by pop_frame()
+    Stats stats_;
+
+    Decimation decimation_;
+    bool check_packet_sizes_;
+    uint64_t soi_count_;
+    std::chrono::steady_clock::time_point next_due_;  // max_fps pacing
+    std::chrono::steady_clock::time_point last_kept_; // max_unchanged_ms heartbeat
+    size_t last_kept_size_;                           // 0 until a frame has been kept
+};
+
+// Replaces the camera's FF 24 inside scan data with the standard FF 00 stuffing
+void unstuff_jpeg(std::vector<uint8_t>& jpeg);
+
+} // namespace supercamera
+
+#endif // SUPERCAMERA_FRAME_ASSEMBLER_H
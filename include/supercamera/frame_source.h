@@ -0,0 +1,58 @@
+#ifndef SUPERCAMERA_FRAME_SOURCE_H
+#define SUPERCAMERA_FRAME_SOURCE_H
+
+#include <string>
+#include <vector>
+
+#include "supercamera/frame.h"
+#include "supercamera/frame_assembler.h"
+
+namespace supercamera {
+
+// Anything that yields camera frames in order: the live device or a replay
+class FrameSource {
+public:
+    virtual ~FrameSource() {}
+
+    // Blocks until the next frame is complete; false at end of stream or on error
+    virtual bool next_frame(Frame& frame) = 0;
+
+    // Switch the stream on and off where the source supports it (the camera
+    // sends its start/end commands); replays are always streaming
+    virtual bool start() { return true; }
+    virtual void stop() {}
+
+    // After next_frame() failed: true if only stop() and start() recover
+    // (the camera lost its device). Other failures are reported once and
+    // the next call reads on.
+    virtual bool needs_restart() const { return false; }
+};
+
+// Replays a raw bulk-stream capture (such as image_data.raw) chunk by chunk
+// through the same deframing path as the live camera
+class RawFileSource : public FrameSource {
+public:
+    explicit RawFileSource(const std::string& path, size_t chunk_size = 512);
+
+    bool open();
+    bool next_frame(Frame& frame) override;
+
+    void set_decimation(const Decimation& decimation) { assembler_.set_decimation(decimation); }
+    void set_check_packet_sizes(bool check) { assembler_.set_check_packet_sizes(check); }
+    const FrameAssembler& assembler() const { return assembler_; }
+
+private:
+    std::string path_;
+    size_t chunk_size_;
+    std::vector<uint8_t> data_;
+    size_t pos_;
+    bool finished_;
+    FrameAssembler assembler_;
+};
+
+// Moves the next assembled frame into `frame`, unstuffed and timestamped
+bool take_frame(FrameAssembler& assembler, Frame& frame);
+
+} // namespace supercamera
+
+#endif // SUPERCAMERA_FRAME_SOURCE_H
@@ -0,0 +1,76 @@
+#ifndef SUPERCAMERA_GOVERNOR_H
+#define SUPERCAMERA_GOVERNOR_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "supercamera/decoder.h"
+
+namespace supercamera {
+
+// One step of the quality ladder, from full quality (index 0) downwards. A
+// level only sets decode scale and profile; the caller's other decode
+// options (output format, stats, resilient) are kept.
+struct QualityLevel {
+    const char* name;
+    unsigned scale_denom;
+    DecodeOptions::Profile profile;
+    unsigned analysis_interval; // Run per-frame analysis on one frame in N
+
+    void apply(DecodeOptions& options) const {
+        options.scale_denom = scale_denom;
+        options.profile = profile;
+    }
+};
+
+struct GovernorConfig {
+    double frame_budget_ms = 1000.0 / 30; // Processing time one frame may take across all stages
+    size_t queue_high = 2;                // Degrade when this many frames are waiting
+    double degrade_load = 0.9;            // ...or when smoothed latency exceeds this share of the budget
+    double restore_load = 0.5;            // Restore when below this share with an empty queue
+    unsigned hold_frames = 15;            // Frames to let a change settle before the next one
+    unsigned restore_frames = 60;         // Frames load must stay low before restoring a step
+};
+
+// Load-adaptive quality control. The processing loop reports each frame's
+// latency and the queue depth it saw; under pressure the governor steps down
+// the ladder (full -> fast IDCT -> half scale -> quarter scale, with analysis
+// thinned out along the way) instead of letting the queue overflow and drop
+// arbitrary frames, and steps back up once load has stayed low. A restore that
+// is undone straight away doubles the wait before the next attempt, so the
+// governor does not oscillate around a level the machine cannot sustain.
+// Every decision is logged as "governor".
+class QualityGovernor {
+public:
+    explicit QualityGovernor(const GovernorConfig& config = GovernorConfig());
+
+    // Returns true when the level changed; apply level() to the decode options before the next frame
+    bool observe(uint64_t frame_id, double latency_ms, size_t queue_depth);
+
+    // Counts frames and says whether this one is due for analysis at the current level
+    bool analysis_due();
+
+    size_t level_index() const { return level_; }
+    const QualityLevel& level() const;
+    double smoothed_latency_ms() const { return ewma_ms_; }
+
+    static size_t level_count();
+    static const QualityLevel& level_at(size_t index);
+
+private:
+    void change_level(size_t level, uint64_t frame_id, size_t queue_depth);
+
+    GovernorConfig config_;
+    size_t level_;
+    double ewma_ms_;
+    bool ewma_valid_;
+    unsigned frames_at_level_;
+    unsigned low_load_frames_;
+    unsigned restore_wait_;
+    bool just_restored_;
+    uint64_t analysis_counter_;
+};
+
+} // namespace supercamera
+
+#endif // SUPERCAMERA_GOVERNOR_H
@@ -0,0 +1,45 @@
+#ifndef SUPERCAMERA_LOG_H
+#define SUPERCAMERA_LOG_H
+
+#include <cstdint>
+#include <cstdio>
+
+namespace supercamera {
+namespace log {
+
+enum class Level { Debug, Info, Warning, Error };
+
+const uint64_t NO_FRAME = UINT64_MAX;
+
+// Asynchronous logger for the capture and decode paths. write() formats into
+// a fixed-size record and pushes it onto a lock-free ring; a background
+// thread does the actual output. Callers never block and never take a lock:
+// if the ring is full the record is dropped and counted. Each message type
+// (a string literal such as "transfer") is rate limited per second, and the
+// number of suppressed messages is reported once its window has passed, by
+// the next message of that type or else by the background thread. Messages
+// below the minimum level are discarded before they are formatted.
+//
+//   log::write(log::Level::Error, "transfer", frame_id, r, "Error reading from bulk endpoint: %s", name);
+//   -> "Error [transfer] frame=12 code=-1: Error reading from bulk endpoint: LIBUSB_ERROR_IO"
+void write(Level level, const char* type, uint64_t frame_id, int code, const char* format, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 5, 6)))
+#endif
+    ;
+
+// Messages per second allowed for each type (default 20, 0 = unlimited)
+void set_rate_limit(unsigned per_second);
+// Least severe level that is written (default Debug, i.e. everything)
+void set_min_level(Level level);
+// Destination of the background writer (default stderr)
+void set_output(std::FILE* out);
+// Blocks until every record written so far has been output
+void flush();
+// Records dropped because the ring was full
+uint64_t dropped();
+
+} // namespace log
+} // namespace supercamera
+
+#endif // SUPERCAMERA_LOG_H
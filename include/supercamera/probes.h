@@ -0,0 +1,54 @@
+#ifndef SUPERCAMERA_PROBES_H
+#define SUPERCAMERA_PROBES_H
+
+// --- USDT static probes (provider "supercamera") ---
+// Each probe compiles to a single NOP plus an ELF note when sys/sdt.h is
+// available, so they cost nothing until bpftrace/perf attaches to them.
+// Without sys/sdt.h (or with CAMERA_USDT_PROBES=OFF) they compile to nothing.
+//
+//   transfer_done  (status, bytes, duration_us)
+//   packet_header  (stream_offset, payload_bytes_of_previous_packet)
+//   frame_start    (frame_id, payload_offset)
+//   frame_end      (frame_id, frame_bytes)
+//   frame_skipped  (frame_id, frame_bytes)   dropped by the Decimation policy
+//   frame_damaged  (frame_id, frame_bytes)   dropped after a packet gap or a lost EOI
+//   decode_start   (frame_id, jpeg_bytes)
+//   decode_end     (frame_id, width, height, duration_us)
+//   sink_write     (frame_id, bytes, duration_us)
+
+//
+// A tracer raises a probe's semaphore while it is attached, and the probe
+// arguments are only evaluated then. CAMERA_PROBE_ENABLED(name) tells the
+// same, for timestamps taken just to feed a probe. Each probe's semaphore is
+// defined once, at global scope, in the file that fires it:
+//
+//   CAMERA_PROBE_SEMAPHORE(frame_end);
+
+#if defined(CAMERA_ENABLE_USDT)
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define CAMERA_PROBE_SEMAPHORE(name) \
+    volatile unsigned short supercamera_##name##_semaphore __attribute__((unused, section(".probes")))
+#define CAMERA_PROBE_ENABLED(name) __builtin_expect(supercamera_##name##_semaphore != 0, 0)
+
+#define CAMERA_PROBE2(name, a, b) \
+    do { if (CAMERA_PROBE_ENABLED(name)) DTRACE_PROBE2(supercamera, name, a, b); } while (0)
+#define CAMERA_PROBE3(name, a, b, c) \
+    do { if (CAMERA_PROBE_ENABLED(name)) DTRACE_PROBE3(supercamera, name, a, b, c); } while (0)
+#define CAMERA_PROBE4(name, a, b, c, d) \
+    do { if (CAMERA_PROBE_ENABLED(name)) DTRACE_PROBE4(supercamera, name, a, b, c, d); } while (0)
+#else
+// The arguments still count as used, but are never evaluated
+#define CAMERA_PROBE_SEMAPHORE(name) static_assert(true, #name)
+#define CAMERA_PROBE_ENABLED(name) false
+
+#define CAMERA_PROBE2(name, a, b) \
+    do { (void) sizeof(a); (void) sizeof(b); } while (0)
+#define CAMERA_PROBE3(name, a, b, c) \
+    do { (void) sizeof(a); (void) sizeof(b); (void) sizeof(c); } while (0)
+#define CAMERA_PROBE4(name, a, b, c, d) \
+    do { (void) sizeof(a); (void) sizeof(b); (void) sizeof(c); (void) sizeof(d); } while (0)
+#endif
+
+#endif // SUPERCAMERA_PROBES_H
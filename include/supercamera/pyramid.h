@@ -0,0 +1,50 @@
+#ifndef SUPERCAMERA_PYRAMID_H
+#define SUPERCAMERA_PYRAMID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "supercamera/frame.h"
+
+namespace supercamera {
+
+// Multi-resolution copy of one image: level 0 plus successive halvings by a
+// 2x2 box filter (640x480, 320x240, 160x120, ...), all stored back to back
+// in one buffer with rows packed. An odd last row or column is dropped when
+// halving. Keep one Pyramid per frame in flight and reuse it: the buffer only
+// grows, so steady-state decoding into it does not allocate.
+struct Pyramid {
+    struct Level {
+        int width = 0;
+        int height = 0;
+        size_t offset = 0; // Into pixels
+    };
+
+    int channels = 0;
+    std::vector<Level> levels;
+    std::vector<uint8_t> pixels;
+    int valid_rows = 0; // Of level 0, as in Image
+    ImageStats stats;   // Of level 0, when the decoder was asked for them
+
+    uint8_t* data(size_t level) { return &pixels[levels[level].offset]; }
+    const uint8_t* data(size_t level) const { return &pixels[levels[level].offset]; }
+    size_t stride(size_t level) const { return static_cast<size_t>(levels[level].width) * channels; }
+
+    // Sizes the levels for a width x height level 0: up to `count` of them,
+    // fewer if halving reaches zero pixels
+    void layout(int width, int height, int channel_count, int count);
+
+    // Writes row y of level + 1 from rows 2y and 2y + 1 of level
+    void halve_row(size_t level, int y);
+
+    // Fills every level past the first from level 0
+    void build();
+
+    // Copies one level out, e.g. for a PixelConverter
+    bool copy_level(size_t level, Image& out) const;
+};
+
+} // namespace supercamera
+
+#endif // SUPERCAMERA_PYRAMID_H
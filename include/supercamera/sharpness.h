@@ -0,0 +1,48 @@
+#ifndef SUPERCAMERA_SHARPNESS_H
+#define SUPERCAMERA_SHARPNESS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "supercamera/frame.h"
+#include "supercamera/frame_source.h"
+
+namespace supercamera {
+
+enum class FocusMetric {
+    LaplacianVariance, // Variance of the Laplacian of the decoded luma
+    DctEnergy,         // Mean high-frequency AC energy of the luma blocks, no IDCT
+};
+
+// Focus score of a decoded image; RGB is reduced to luma on the fly
+double laplacian_variance(const Image& image);
+
+// Mean energy of the dequantized luma AC coefficients above the lowest
+// frequencies, read straight from the entropy-coded data. Much cheaper than
+// a decode and ranks blur the same way within a burst of one scene.
+bool dct_energy(const uint8_t* jpeg, size_t size, double& energy);
+
+struct BurstScore {
+    size_t index = 0;  // Position in the scored burst
+    uint64_t frame_id = 0;
+    double score = -1; // -1 if the frame could not be scored
+};
+
+struct BurstConfig {
+    size_t frames = 10;                       // Frames to capture
+    size_t keep = 1;                          // Sharpest frames to return
+    FocusMetric metric = FocusMetric::DctEnergy;
+    unsigned threads = 0;                     // 0 = one per core
+};
+
+// Scores every frame in parallel and returns them sharpest first
+std::vector<BurstScore> rank_by_sharpness(const std::vector<Frame>& frames, FocusMetric metric, unsigned threads = 0);
+
+// Captures a burst of config.frames from `source` and moves the config.keep
+// sharpest into `best`, sharpest first. Fails only if no frame was read.
+bool capture_best(FrameSource& source, const BurstConfig& config, std::vector<Frame>& best);
+
+} // namespace supercamera
+
+#endif // SUPERCAMERA_SHARPNESS_H
@@ -0,0 +1,68 @@
+#ifndef SUPERCAMERA_STREAM_GATE_H
+#define SUPERCAMERA_STREAM_GATE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "supercamera/frame_source.h"
+
+namespace supercamera {
+
+// Runs a FrameSource on demand for daemon-style use. The stream is started
+// when the first consumer subscribes and stopped once no consumer has been
+// subscribed for idle_timeout_ms; while idle within the timeout frames keep
+// being read and discarded. The source itself (for the camera: the claimed
+// interface, transfer buffer and assembler) stays open in between, so a
+// restart costs the start command plus one frame interval.
+class StreamGate {
+public:
+    typedef std::function<void(const Frame&)> FrameCallback;
+
+    struct Stats {
+        uint64_t starts = 0;
+        uint64_t stops = 0;
+        uint64_t frames_delivered = 0;
+        uint64_t frames_discarded = 0; // Read while idle, before the stream stopped
+        uint64_t errors = 0;
+    };
+
+    explicit StreamGate(FrameSource& source, unsigned idle_timeout_ms = 5000);
+    ~StreamGate();
+
+    // Callbacks run on the gate's capture thread and must not block
+    uint64_t subscribe(FrameCallback callback);
+    void unsubscribe(uint64_t id);
+
+    bool is_streaming() const { return streaming_.load(); }
+    Stats stats() const;
+
+private:
+    StreamGate(const StreamGate&);
+    StreamGate& operator=(const StreamGate&);
+
+    void run();
+
+    FrameSource& source_;
+    unsigned idle_timeout_ms_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::map<uint64_t, FrameCallback> subscribers_;
+    uint64_t next_id_;
+    std::chrono::steady_clock::time_point idle_since_;
+    bool shutdown_;
+    Stats stats_;
+
+    std::atomic<bool> streaming_;
+    std::thread thread_;
+};
+
+} // namespace supercamera
+
+#endif // SUPERCAMERA_STREAM_GATE_H
@@ -0,0 +1,88 @@
+#ifndef SUPERCAMERA_C_H
+#define SUPERCAMERA_C_H
+
+/*
+ * Stable C ABI of libsupercamera.so for FFI users (ctypes/cffi/numpy, Rust).
+ *
+ * Frames are handed out as pointers into a fixed pool of buffers owned by the
+ * camera handle, so callers can wrap them without copying (for example
+ * numpy.frombuffer over data/size). A frame stays valid until it is passed to
+ * sc_release_frame(). The pool is recycled, and a slot's JPEG buffer goes
+ * back to the deframer for the next frame, so steady-state capture does not
+ * reallocate frame-sized buffers. When every pool slot is held,
+ * sc_next_frame() fails with SC_ERR_POOL_EXHAUSTED instead of blocking.
+ *
+ * No C++ exception crosses this interface: an allocation failure or other
+ * internal error is returned as SC_ERR_INTERNAL.
+ *
+ * Only append to the structs and enums below; bump SC_ABI_VERSION when the
+ * layout of sc_frame changes.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define SC_API __declspec(dllexport)
+#else
+#define SC_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SC_ABI_VERSION 1
+
+typedef enum sc_status {
+    SC_OK                 =  0,
+    SC_ERR_INVALID        = -1, /* Bad argument or call order */
+    SC_ERR_NO_DEVICE      = -2, /* Camera not found or could not be claimed */
+    SC_ERR_IO             = -3, /* Transfer failure or timeout */
+    SC_ERR_END_OF_STREAM  = -4, /* Replay source exhausted */
+    SC_ERR_POOL_EXHAUSTED = -5, /* All frames are held; release one first */
+    SC_ERR_DECODE         = -6, /* JPEG could not be decoded */
+    SC_ERR_INTERNAL       = -7  /* Out of memory or another internal failure */
+} sc_status;
+
+typedef enum sc_format {
+    SC_FORMAT_JPEG  = 0, /* Cleaned JPEG bitstream; width/height/stride are 0 */
+    SC_FORMAT_RGB24 = 1  /* Interleaved 8-bit RGB rows, stride bytes apart */
+} sc_format;
+
+typedef struct sc_frame {
+    uint64_t id;
+    int64_t timestamp_ns;   /* CLOCK_MONOTONIC time the frame completed */
+    int32_t format;         /* sc_format */
+    int32_t width;
+    int32_t height;
+    int32_t channels;
+    size_t stride;          /* Bytes per row for pixel formats */
+    const uint8_t* data;    /* Points into the handle's pool, read-only */
+    size_t size;            /* Bytes at data */
+} sc_frame;
+
+typedef struct sc_camera sc_camera;
+
+SC_API int sc_abi_version(void);
+SC_API const char* sc_status_string(int status);
+
+/* Opens the USB camera (0329:2022) with `pool_size` frame slots (0 = default 4) */
+SC_API int sc_open(sc_camera** camera, int pool_size);
+/* Opens a raw bulk capture such as image_data.raw instead of the device */
+SC_API int sc_open_raw_file(sc_camera** camera, const char* path, int pool_size);
+
+SC_API int sc_start(sc_camera* camera);
+/* Waits for the next frame in `format` and points *frame at a pooled slot */
+SC_API int sc_next_frame(sc_camera* camera, int format, const sc_frame** frame);
+/* Returns a frame's slot to the pool; safe from any thread */
+SC_API void sc_release_frame(sc_camera* camera, const sc_frame* frame);
+SC_API int sc_stop(sc_camera* camera);
+/* Stops streaming and frees the handle; all frames must have been released */
+SC_API void sc_close(sc_camera* camera);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SUPERCAMERA_C_H */
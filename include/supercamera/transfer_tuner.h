@@ -0,0 +1,69 @@
+#ifndef SUPERCAMERA_TRANSFER_TUNER_H
+#define SUPERCAMERA_TRANSFER_TUNER_H
+
+#include <string>
+#include <vector>
+
+namespace supercamera {
+
+// How the camera's bulk IN endpoint is read
+struct TransferSettings {
+    int transfer_size = 512;             // Bytes per transfer, a multiple of the 512-byte packet size
+    int transfers_in_flight = 1;         // Transfers queued at once
+    unsigned transfer_timeout_ms = 1000;
+};
+
+const int TRANSFER_PACKET_SIZE = 512;
+const int MAX_TRANSFER_SIZE = 1 << 20;
+const int MAX_TRANSFERS_IN_FLIGHT = 64;
+
+// A transfer_size that is a positive multiple of TRANSFER_PACKET_SIZE up to
+// MAX_TRANSFER_SIZE, 1 to MAX_TRANSFERS_IN_FLIGHT transfers and a non-zero
+// timeout (0 would make libusb wait forever)
+bool valid_transfer_settings(const TransferSettings& settings);
+
+// Candidates the tuner measures (every size with every queue depth) and how it chooses
+struct TunerConfig {
+    std::vector<int> transfer_sizes = {512, 4096, 16384, 65536};
+    std::vector<int> transfers_in_flight = {1, 2, 4, 8};
+    unsigned trial_ms = 250;         // Streaming time per candidate
+    double target_latency_ms = 35;   // Longest wait between completions; about one frame at 30 fps
+    double throughput_share = 0.95;  // Candidates within this share of the best throughput qualify
+    double cpu_tolerance_pct = 1.0;  // Smaller CPU differences are noise: prefer less buffer memory
+    unsigned min_timeout_ms = 250;   // The tuned timeout is 4x the worst wait, clamped to these
+    unsigned max_timeout_ms = 1000;
+    std::string path;                // Where tuned settings persist; empty for default_tuning_path()
+};
+
+// What one candidate achieved, measured from its first completion on
+struct TransferTrial {
+    TransferSettings settings;
+    bool ok = false;           // False if a transfer failed
+    double bytes_per_s = 0;
+    double latency_ms = 0;     // 95th percentile wait between completions
+    double max_latency_ms = 0;
+    double cpu_pct = 0;        // Of one core, on the thread handling the transfers
+};
+
+// The cheapest candidate that keeps up: among trials within throughput_share
+// of the best throughput and under target_latency_ms (or, if none is, the
+// lowest latency), the lowest CPU, then the least buffer memory. False when
+// no trial succeeded.
+bool pick_transfer_settings(const std::vector<TransferTrial>& trials, const TunerConfig& config,
+                            TransferSettings& best);
+
+// Tuned settings are kept in a text file with one line per device,
+//   <device> <transfer_size> <transfers_in_flight> <transfer_timeout_ms>
+// where <device> names the camera and the port it hangs off (e.g.
+// "0329:2022@1-3.2"), since the best settings follow the host controller.
+// A line that is unreadable or fails valid_transfer_settings() does not
+// load, so the device is tuned again and the line replaced.
+bool load_transfer_settings(const std::string& path, const std::string& device, TransferSettings& settings);
+bool save_transfer_settings(const std::string& path, const std::string& device, const TransferSettings& settings);
+
+// $XDG_CACHE_HOME/supercamera/transfers, or ~/.cache/supercamera/transfers
+std::string default_tuning_path();
+
+} // namespace supercamera
+
+#endif // SUPERCAMERA_TRANSFER_TUNER_H
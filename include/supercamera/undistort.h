@@ -0,0 +1,61 @@
+#ifndef SUPERCAMERA_UNDISTORT_H
+#define SUPERCAMERA_UNDISTORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "supercamera/band_pool.h"
+#include "supercamera/frame.h"
+
+namespace supercamera {
+
+// Pinhole intrinsics plus Brown-Conrady distortion, in the same convention
+// as OpenCV's calibrateCamera (k1, k2, p1, p2, k3)
+struct LensModel {
+    double fx = 0, fy = 0; // Focal lengths in pixels
+    double cx = 0, cy = 0; // Principal point
+    double k1 = 0, k2 = 0, k3 = 0; // Radial
+    double p1 = 0, p2 = 0;         // Tangential
+    double zoom = 1.0;     // Output focal length scale; > 1 crops the empty border of a barrel correction
+};
+
+// Removes lens distortion from RGB frames. The remap from each output pixel
+// to its source position is computed once per calibration and stored in
+// fixed point (source byte offset plus 7-bit bilinear weights); apply() then
+// only interpolates, with an SSE2 kernel where available, splitting the
+// frame into row bands across `threads` workers that live as long as the
+// Undistorter. Output pixels that map outside the source are black.
+class Undistorter {
+public:
+    Undistorter(const LensModel& model, int width, int height, unsigned threads = 1);
+
+    // Fails if the image is not RGB at the calibrated size
+    bool apply(const Image& source, Image& out);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+private:
+    Undistorter(const Undistorter&);
+    Undistorter& operator=(const Undistorter&);
+
+    struct Tap {
+        uint32_t offset; // Byte offset of the top-left source pixel, or INVALID
+        uint8_t wx;      // Weight of the right/bottom neighbours, 0..128
+        uint8_t wy;
+        uint16_t pad;
+    };
+
+    void build_map(const LensModel& model);
+    void remap_rows(const Image& source, Image& out, int y0, int y1) const;
+
+    int width_;
+    int height_;
+    std::vector<Tap> map_;
+    BandPool pool_;
+};
+
+} // namespace supercamera
+
+#endif // SUPERCAMERA_UNDISTORT_H
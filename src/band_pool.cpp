@@ -0,0 +1,71 @@
+#include "supercamera/band_pool.h"
+
+#include <algorithm>
+
+namespace supercamera {
+
+BandPool::BandPool(unsigned threads)
+    : threads_(std::max(1u, threads)), generation_(0), bands_(0), pending_(0), shutdown_(false), fn_(nullptr) {
+    for (unsigned band = 1; band < threads_; ++band) {
+        workers_.push_back(std::thread(&BandPool::worker, this, band));
+    }
+}
+
+BandPool::~BandPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shutdown_ = true;
+    }
+    start_cv_.notify_all();
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        workers_[i].join();
+    }
+}
+
+void BandPool::run(unsigned bands, const std::function<void(unsigned, unsigned)>& fn) {
+    bands = std::min(std::max(1u, bands), threads_);
+    if (bands == 1) {
+        fn(0, 1);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fn_ = &fn;
+        bands_ = bands;
+        pending_ = threads_ - 1;
+        ++generation_;
+    }
+    start_cv_.notify_all();
+    fn(0, bands);
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this]() { return pending_ == 0; });
+}
+
+void BandPool::worker(unsigned band) {
+    uint64_t seen = 0;
+    while (true) {
+        const std::function<void(unsigned, unsigned)>* fn;
+        unsigned bands;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_cv_.wait(lock, [&]() { return shutdown_ || generation_ != seen; });
+            if (shutdown_) {
+                return;
+            }
+            seen = generation_;
+            fn = fn_;
+            bands = bands_;
+        }
+        // Workers beyond the requested band count just check in
+        if (band < bands) {
+            (*fn)(band, bands);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --pending_;
+        }
+        done_cv_.notify_one();
+    }
+}
+
+} // namespace supercamera
@@ -0,0 +1,529 @@
+#include "supercamera/camera.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+#include <sys/resource.h>
+
+#include <libusb-1.0/libusb.h>
+
+#include "supercamera/log.h"
+#include "supercamera/probes.h"
+
+CAMERA_PROBE_SEMAPHORE(transfer_done);
+
+namespace supercamera {
+
+static const uint8_t CMD_START_STREAM = 0x05;
+static const uint8_t CMD_END_STREAM   = 0x06;
+
+Camera::Camera(const CameraConfig& config)
+    : config_(config),
+      ctx_(nullptr),
+      dev_handle_(nullptr),
+      kernel_driver_detached_(false),
+      streaming_(false),
+      raw_sink_(nullptr),
+      buffer_(nullptr),
+      device_buffer_(false),
+      in_flight_(0),
+      resubmit_(false),
+      transfer_error_(0),
+      samples_(nullptr),
+      tuned_(false) {
+    assembler_.set_decimation(config.decimation);
+}
+
+Camera::~Camera() {
+    close();
+}
+
+bool Camera::open() {
+    if (dev_handle_) {
+        return true;
+    }
+
+    int r = libusb_init(&ctx_);
+    if (r < 0) {
+        std::cerr << "Error initializing libusb: " << libusb_error_name(r) << std::endl;
+        ctx_ = nullptr;
+        return false;
+    }
+
+    dev_handle_ = libusb_open_device_with_vid_pid(ctx_, config_.vendor_id, config_.product_id);
+    if (!dev_handle_) {
+        std::cerr << "Could not find or open the USB device." << std::endl;
+        close();
+        return false;
+    }
+
+    if (libusb_kernel_driver_active(dev_handle_, config_.interface_num) == 1) {
+        r = libusb_detach_kernel_driver(dev_handle_, config_.interface_num);
+        if (r != 0) {
+            std::cerr << "Could not detach kernel driver! Error: " << libusb_error_name(r) << std::endl;
+            close();
+            return false;
+        }
+        kernel_driver_detached_ = true; // Set flag if detachment was successful
+    }
+
+    r = libusb_claim_interface(dev_handle_, config_.interface_num);
+    if (r < 0) {
+        std::cerr << "Error claiming interface: " << libusb_error_name(r) << std::endl;
+        close();
+        return false;
+    }
+
+    r = libusb_set_interface_alt_setting(dev_handle_, config_.interface_num, config_.alt_setting);
+    if (r != 0) {
+        std::cerr << "Error setting alternate setting: " << libusb_error_name(r) << std::endl;
+        libusb_release_interface(dev_handle_, config_.interface_num);
+        close();
+        return false;
+    }
+    if (!allocate_transfers()) {
+        std::cerr << "Error allocating bulk transfers." << std::endl;
+        libusb_release_interface(dev_handle_, config_.interface_num);
+        close();
+        return false;
+    }
+    return true;
+}
+
+// --- Transfers ---
+
+// usbfs can map DMA-able memory into the process (libusb 1.0.21+, Linux
+// 4.6+); bulk transfers into it skip the kernel's copy to a user buffer.
+// Anything else gets an ordinary heap buffer. Either way one buffer is
+// sliced between all slots.
+bool Camera::allocate_transfers() {
+    size_t bytes = static_cast<size_t>(config_.transfer_size) * config_.transfers_in_flight;
+#if defined(LIBUSB_API_VERSION) && LIBUSB_API_VERSION >= 0x01000105
+    if (config_.zero_copy) {
+        buffer_ = libusb_dev_mem_alloc(dev_handle_, bytes);
+        if (buffer_) {
+            device_buffer_ = true;
+        } else {
+            log::write(log::Level::Info, "zero_copy", log::NO_FRAME, 0,
+                       "Device memory not available, using regular transfer buffers.");
+        }
+    }
+#endif
+    if (!device_buffer_) {
+        host_buffer_.resize(bytes);
+        buffer_ = host_buffer_.data();
+    }
+
+    // Slots are never resized while transfers point at them
+    slots_.resize(config_.transfers_in_flight);
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        slots_[i].camera = this;
+        slots_[i].buffer = buffer_ + i * config_.transfer_size;
+        slots_[i].transfer = libusb_alloc_transfer(0);
+        if (!slots_[i].transfer) {
+            slots_.resize(i);
+            free_transfers();
+            return false;
+        }
+    }
+    return true;
+}
+
+void Camera::free_transfers() {
+    for (Slot& slot : slots_) {
+        libusb_free_transfer(slot.transfer);
+    }
+    slots_.clear();
+#if defined(LIBUSB_API_VERSION) && LIBUSB_API_VERSION >= 0x01000105
+    if (device_buffer_) {
+        libusb_dev_mem_free(dev_handle_, buffer_,
+                            static_cast<size_t>(config_.transfer_size) * config_.transfers_in_flight);
+        device_buffer_ = false;
+    }
+#endif
+    std::vector<uint8_t>().swap(host_buffer_);
+    buffer_ = nullptr;
+}
+
+// Some hosts map device memory but reject transfers into it; switch to
+// heap buffers for good. Only while no transfer is in flight.
+bool Camera::use_host_buffers(int error) {
+    log::write(log::Level::Info, "zero_copy", log::NO_FRAME, error,
+               "Transfer into device memory failed (%s), using regular transfer buffers.", libusb_error_name(error));
+    free_transfers();
+    config_.zero_copy = false;
+    if (!allocate_transfers()) {
+        transfer_error_ = LIBUSB_ERROR_NO_MEM;
+        return false;
+    }
+    return true;
+}
+
+// Reallocates for new settings; only while no transfer is in flight
+bool Camera::apply_settings(const TransferSettings& settings) {
+    free_transfers();
+    config_.transfer_size = settings.transfer_size;
+    config_.transfers_in_flight = settings.transfers_in_flight;
+    config_.transfer_timeout_ms = settings.transfer_timeout_ms;
+    return allocate_transfers();
+}
+
+bool Camera::submit_transfers() {
+    if (slots_.empty()) {
+        transfer_error_ = LIBUSB_ERROR_NO_MEM;
+        return false;
+    }
+    transfer_error_ = 0;
+    resubmit_ = true;
+    for (Slot& slot : slots_) {
+        libusb_fill_bulk_transfer(slot.transfer, dev_handle_, static_cast<unsigned char>(config_.bulk_ep_in),
+                                  slot.buffer, config_.transfer_size, transfer_callback, &slot,
+                                  config_.transfer_timeout_ms);
+        slot.submitted = std::chrono::steady_clock::now();
+        int r = libusb_submit_transfer(slot.transfer);
+        if (r < 0) {
+            cancel_transfers();
+            if (device_buffer_ && r != LIBUSB_ERROR_NO_DEVICE) {
+                return use_host_buffers(r) && submit_transfers();
+            }
+            log::write(log::Level::Error, "transfer", log::NO_FRAME, r, "Error submitting bulk transfer: %s",
+                       libusb_error_name(r));
+            transfer_error_ = r;
+            return false;
+        }
+        ++in_flight_;
+    }
+    return true;
+}
+
+// Cancelled transfers still complete through the event loop, so wait for
+// every one of them before their buffers may be reused or freed
+void Camera::cancel_transfers() {
+    resubmit_ = false;
+    for (Slot& slot : slots_) {
+        libusb_cancel_transfer(slot.transfer); // Fails harmlessly for slots not in flight
+    }
+    while (in_flight_ > 0) {
+        struct timeval tv = {0, 100000};
+        if (libusb_handle_events_timeout_completed(ctx_, &tv, nullptr) < 0) {
+            break;
+        }
+    }
+}
+
+// Completion times and sizes of one tuning trial
+struct Camera::TrialSamples {
+    std::vector<std::chrono::steady_clock::time_point> completions;
+    uint64_t bytes = 0; // After the first completion
+
+    void record(std::chrono::steady_clock::time_point when, int length) {
+        if (!completions.empty()) {
+            bytes += static_cast<uint64_t>(length);
+        }
+        completions.push_back(when);
+    }
+};
+
+void Camera::transfer_callback(libusb_transfer* transfer) {
+    Slot* slot = static_cast<Slot*>(transfer->user_data);
+    slot->camera->transfer_done(*slot);
+}
+
+void Camera::transfer_done(Slot& slot) {
+    libusb_transfer* transfer = slot.transfer;
+    --in_flight_;
+    auto now = std::chrono::steady_clock::now();
+    CAMERA_PROBE3(transfer_done, transfer->status, transfer->actual_length,
+                  std::chrono::duration_cast<std::chrono::microseconds>(now - slot.submitted).count());
+
+    // A timed-out transfer keeps what it received before the timeout
+    bool received = transfer->status == LIBUSB_TRANSFER_COMPLETED || transfer->status == LIBUSB_TRANSFER_TIMED_OUT;
+    if (received && transfer->actual_length > 0) {
+        if (samples_) {
+            samples_->record(now, transfer->actual_length);
+        } else {
+            if (raw_sink_) {
+                raw_sink_->write(reinterpret_cast<const char*>(slot.buffer), transfer->actual_length);
+            }
+            assembler_.push(slot.buffer, transfer->actual_length);
+        }
+    }
+
+    if (!received) {
+        // Mapped to libusb errors as libusb_bulk_transfer() does
+        if (transfer->status != LIBUSB_TRANSFER_CANCELLED && transfer_error_ == 0) {
+            transfer_error_ = transfer->status == LIBUSB_TRANSFER_NO_DEVICE ? LIBUSB_ERROR_NO_DEVICE
+                              : transfer->status == LIBUSB_TRANSFER_STALL   ? LIBUSB_ERROR_PIPE
+                              : transfer->status == LIBUSB_TRANSFER_OVERFLOW ? LIBUSB_ERROR_OVERFLOW
+                                                                             : LIBUSB_ERROR_IO;
+        }
+        return;
+    }
+    if (resubmit_) {
+        slot.submitted = now;
+        int r = libusb_submit_transfer(transfer);
+        if (r < 0) {
+            if (transfer_error_ == 0) {
+                transfer_error_ = r;
+            }
+        } else {
+            ++in_flight_;
+        }
+    }
+}
+
+bool Camera::send_command(uint8_t command) {
+    uint8_t cmd[] = {0xBB, 0xAA, command, 0x00, 0x00};
+    int transferred = 0;
+    int r = libusb_bulk_transfer(dev_handle_, config_.bulk_ep_out, cmd, sizeof(cmd), &transferred,
+                                 config_.transfer_timeout_ms);
+    return r == 0 && transferred == static_cast<int>(sizeof(cmd));
+}
+
+bool Camera::start() {
+    if (!dev_handle_) {
+        return false;
+    }
+    if (streaming_) {
+        return true;
+    }
+    if (!send_command(CMD_START_STREAM)) {
+        log::write(log::Level::Warning, "command", log::NO_FRAME, 0, "Failed to send start command.");
+    }
+    if (config_.autotune && !tuned_) {
+        std::string path = config_.tuner.path.empty() ? default_tuning_path() : config_.tuner.path;
+        TransferSettings saved;
+        if (load_transfer_settings(path, device_key(), saved)) {
+            tuned_ = apply_settings(saved);
+        } else {
+            tune(nullptr); // The stream is already running
+        }
+        if (!tuned_) {
+            log::write(log::Level::Warning, "autotune", log::NO_FRAME, 0,
+                       "Transfer tuning failed, keeping %d x %d bytes.", config_.transfers_in_flight,
+                       config_.transfer_size);
+            tuned_ = true; // Do not retry on every start
+        }
+    }
+    assembler_.reset();
+    if (!submit_transfers()) {
+        send_command(CMD_END_STREAM);
+        return false;
+    }
+    streaming_ = true;
+    return true;
+}
+
+void Camera::stop() {
+    if (!dev_handle_ || !streaming_) {
+        return;
+    }
+    if (!send_command(CMD_END_STREAM)) {
+        log::write(log::Level::Warning, "command", log::NO_FRAME, 0, "Failed to send end command.");
+    }
+    cancel_transfers();
+    streaming_ = false;
+}
+
+void Camera::close() {
+    stop();
+    if (dev_handle_) {
+        free_transfers();
+        libusb_release_interface(dev_handle_, config_.interface_num);
+        // Re-attaching the kernel driver after a detach stays disabled, as in the original capture tool
+        libusb_close(dev_handle_);
+        dev_handle_ = nullptr;
+    }
+    if (ctx_) {
+        libusb_exit(ctx_);
+        ctx_ = nullptr;
+    }
+    tuned_ = false;
+}
+
+bool Camera::needs_restart() const {
+    return transfer_error_ == LIBUSB_ERROR_NO_DEVICE;
+}
+
+bool Camera::next_frame(Frame& frame) {
+    if (!streaming_) {
+        return false;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(config_.frame_timeout_ms);
+    while (!take_frame(assembler_, frame)) {
+        if (transfer_error_ != 0) {
+            log::write(log::Level::Error, "transfer", assembler_.stats().frames, transfer_error_,
+                       "Error reading from bulk endpoint: %s", libusb_error_name(transfer_error_));
+            // Failed slots are not resubmitted. Reported once, a transient
+            // error is cleared by queueing every slot again, so the next
+            // call reads on; only a lost device stays an error.
+            if (transfer_error_ != LIBUSB_ERROR_NO_DEVICE) {
+                cancel_transfers();
+                // Nothing ever arrived in device memory: treat it as rejected
+                if (device_buffer_ && assembler_.stats().bytes_in == 0 && !use_host_buffers(transfer_error_)) {
+                    return false;
+                }
+                submit_transfers();
+            }
+            return false;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            log::write(log::Level::Error, "frame_timeout", assembler_.stats().frames, 0,
+                       "Timed out waiting for a complete frame.");
+            return false;
+        }
+
+        // Completions land in transfer_done(), which feeds the assembler
+        long long wait_us = std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count();
+        struct timeval tv = {static_cast<time_t>(wait_us / 1000000), static_cast<suseconds_t>(wait_us % 1000000)};
+        int r = libusb_handle_events_timeout_completed(ctx_, &tv, nullptr);
+        if (r < 0 && r != LIBUSB_ERROR_INTERRUPTED) {
+            log::write(log::Level::Error, "transfer", assembler_.stats().frames, r,
+                       "Error handling USB events: %s", libusb_error_name(r));
+            return false;
+        }
+    }
+    return true;
+}
+
+// --- Transfer tuning ---
+
+static double thread_cpu_seconds() {
+    struct rusage usage;
+#if defined(RUSAGE_THREAD)
+    getrusage(RUSAGE_THREAD, &usage);
+#else
+    getrusage(RUSAGE_SELF, &usage);
+#endif
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+std::string Camera::device_key() const {
+    char key[64];
+    std::snprintf(key, sizeof(key), "%04x:%04x", config_.vendor_id, config_.product_id);
+    std::string device = key;
+    if (dev_handle_) {
+        libusb_device* usb = libusb_get_device(dev_handle_);
+        uint8_t ports[7];
+        int depth = libusb_get_port_numbers(usb, ports, sizeof(ports));
+        std::snprintf(key, sizeof(key), "@%d", libusb_get_bus_number(usb));
+        device += key;
+        for (int i = 0; i < depth; ++i) {
+            std::snprintf(key, sizeof(key), "%c%d", i == 0 ? '-' : '.', ports[i]);
+            device += key;
+        }
+    }
+    return device;
+}
+
+// Streams with the trial's settings for tuner.trial_ms, counting from the
+// first completion so the time the camera takes to start sending is left out
+bool Camera::run_trial(TransferTrial& trial) {
+    if (!apply_settings(trial.settings)) {
+        return false;
+    }
+    TrialSamples samples;
+    samples_ = &samples;
+    bool started = false;
+    double cpu_start = 0, cpu_end = 0;
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(config_.tuner.trial_ms + 1000);
+    if (submit_transfers()) {
+        while (transfer_error_ == 0) {
+            if (!started && !samples.completions.empty()) {
+                started = true;
+                cpu_start = thread_cpu_seconds();
+                end = samples.completions.front() + std::chrono::milliseconds(config_.tuner.trial_ms);
+            }
+            if (std::chrono::steady_clock::now() >= end) {
+                break;
+            }
+            struct timeval tv = {0, 10000};
+            if (libusb_handle_events_timeout_completed(ctx_, &tv, nullptr) < 0) {
+                break;
+            }
+        }
+        cpu_end = thread_cpu_seconds();
+        cancel_transfers();
+    }
+    samples_ = nullptr;
+
+    trial.ok = transfer_error_ == 0 && samples.completions.size() > 1;
+    if (!trial.ok) {
+        return false;
+    }
+    std::vector<double> waits;
+    for (size_t i = 1; i < samples.completions.size(); ++i) {
+        waits.push_back(std::chrono::duration<double, std::milli>(samples.completions[i] - samples.completions[i - 1])
+                            .count());
+    }
+    std::sort(waits.begin(), waits.end());
+    double seconds = std::chrono::duration<double>(samples.completions.back() - samples.completions.front()).count();
+    trial.bytes_per_s = seconds > 0 ? samples.bytes / seconds : 0;
+    trial.latency_ms = waits[std::min(waits.size() - 1, waits.size() * 95 / 100)];
+    trial.max_latency_ms = waits.back();
+    trial.cpu_pct = seconds > 0 ? 100.0 * (cpu_end - cpu_start) / seconds : 0;
+    log::write(log::Level::Debug, "autotune", log::NO_FRAME, 0,
+               "%d x %d bytes: %.0f KB/s, p95 wait %.1f ms, max %.1f ms, CPU %.1f%%",
+               trial.settings.transfers_in_flight, trial.settings.transfer_size, trial.bytes_per_s / 1024,
+               trial.latency_ms, trial.max_latency_ms, trial.cpu_pct);
+    return true;
+}
+
+// Expects the stream to be running and no transfer in flight
+bool Camera::tune(std::vector<TransferTrial>* trials) {
+    TransferSettings initial;
+    initial.transfer_size = config_.transfer_size;
+    initial.transfers_in_flight = config_.transfers_in_flight;
+    initial.transfer_timeout_ms = config_.transfer_timeout_ms;
+
+    std::vector<TransferTrial> measured;
+    for (int size : config_.tuner.transfer_sizes) {
+        for (int depth : config_.tuner.transfers_in_flight) {
+            TransferTrial trial;
+            trial.settings.transfer_size = size;
+            trial.settings.transfers_in_flight = depth;
+            trial.settings.transfer_timeout_ms = initial.transfer_timeout_ms;
+            run_trial(trial);
+            measured.push_back(trial);
+        }
+    }
+
+    TransferSettings best;
+    bool picked = pick_transfer_settings(measured, config_.tuner, best);
+    if (trials) {
+        *trials = measured;
+    }
+    if (!picked) {
+        apply_settings(initial);
+        return false;
+    }
+    tuned_ = apply_settings(best);
+    log::write(log::Level::Info, "autotune", log::NO_FRAME, 0, "Tuned to %d x %d bytes, timeout %u ms.",
+               best.transfers_in_flight, best.transfer_size, best.transfer_timeout_ms);
+    std::string path = config_.tuner.path.empty() ? default_tuning_path() : config_.tuner.path;
+    if (!save_transfer_settings(path, device_key(), best)) {
+        log::write(log::Level::Warning, "autotune", log::NO_FRAME, 0, "Could not save transfer settings to %s.",
+                   path.c_str());
+    }
+    return tuned_;
+}
+
+bool Camera::autotune(std::vector<TransferTrial>* trials) {
+    if (!dev_handle_ || streaming_) {
+        return false;
+    }
+    if (!send_command(CMD_START_STREAM)) {
+        log::write(log::Level::Warning, "command", log::NO_FRAME, 0, "Failed to send start command.");
+    }
+    bool ok = tune(trials);
+    if (!send_command(CMD_END_STREAM)) {
+        log::write(log::Level::Warning, "command", log::NO_FRAME, 0, "Failed to send end command.");
+    }
+    return ok;
+}
+
+} // namespace supercamera
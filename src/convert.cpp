@@ -0,0 +1,658 @@
+#include "supercamera/convert.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "simd.h"
+
+namespace supercamera {
+
+static const int TILE_COLS = 64; // Even, so chroma pairs never straddle tiles
+static const int TILE_ROWS = 16;
+
+// --- Kernels ---
+// Every format goes through the same two stages: bilinear sampling of a tile
+// row into three planar rows, then color kernels from those rows to the
+// output. The colour kernels evaluate one Mix per output channel, in 8-bit
+// fixed point over the three sampled channels. The SIMD variants compute the
+// same expressions as pmaddwd pairs (first, second) and (third, 1), so every
+// level produces identical bytes.
+
+// ((c0 a + c1 b + c2 c + round) >> 8) + bias, saturated to 0..255
+struct Mix {
+    int16_t c0, c1, c2, round, bias;
+};
+
+// BT.601 video range from RGB
+static const Mix RGB_TO_YUV[3] = {
+    {66, 129, 25, 128, 16},
+    {-38, -74, 112, 128, 128},
+    {112, -94, -18, 128, 128},
+};
+
+// BT.601 video range from full-range (JPEG) YCbCr: 219/255 and 224/255
+// scaling, with neutral chroma staying at 128
+static const Mix YCBCR_TO_YUV[3] = {
+    {220, 0, 0, 128, 16},
+    {0, 225, 0, 0, 16},
+    {0, 0, 225, 0, 16},
+};
+
+// JFIF YCbCr to RGB (1.402, -0.344, -0.714, 1.772), with the 128 chroma
+// offsets folded into the bias
+static const Mix YCBCR_TO_RGB[3] = {
+    {256, 0, 359, 0, -179},
+    {256, -88, -183, 0, 136},
+    {256, 454, 0, 128, -227},
+};
+
+struct ConvertKernels {
+    // n output pixels of one row into planar rows c0..c2. Pixel i reads the
+    // source at off_b + off_a[i], with neighbours step_a[i] and step_b further.
+    void (*sample)(const uint8_t* src, size_t src_size, const uint32_t* off_a, const uint32_t* step_a,
+                   const uint16_t* w_a, uint32_t off_b, uint32_t step_b, uint32_t w_b,
+                   uint8_t* c0, uint8_t* c1, uint8_t* c2, size_t n);
+    void (*mix)(const uint8_t* a, const uint8_t* b, const uint8_t* c, const Mix& m, uint8_t* out, size_t n);
+    // n source pixels from two rows (n even) -> n / 2 samples each of u and v,
+    // from the rounded mean of each 2x2 block
+    void (*chroma)(const uint8_t* a0, const uint8_t* b0, const uint8_t* c0,
+                   const uint8_t* a1, const uint8_t* b1, const uint8_t* c1,
+                   const Mix& mu, const Mix& mv, uint8_t* u, uint8_t* v, size_t n);
+    void (*interleave)(const uint8_t* u, const uint8_t* v, uint8_t* uv, size_t n);
+    void (*pack3)(const uint8_t* a, const uint8_t* b, const uint8_t* c, uint8_t* out, size_t n);
+    void (*pack4)(const uint8_t* a, const uint8_t* b, const uint8_t* c, uint8_t* out, size_t n); // Fourth byte 255
+    void (*to_float)(const uint8_t* p, float* out, size_t n);
+};
+
+static inline uint8_t clamp_u8(int v) {
+    return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+// Pixels i..n of sample(). The offsets already include the rotation, so the
+// same code serves every orientation.
+static void sample_from(const uint8_t* src, const uint32_t* off_a, const uint32_t* step_a, const uint16_t* w_a,
+                        uint32_t off_b, uint32_t step_b, uint32_t w_b,
+                        uint8_t* c0, uint8_t* c1, uint8_t* c2, size_t i, size_t n) {
+    uint32_t ib = 256 - w_b;
+    for (; i < n; ++i) {
+        const uint8_t* p = src + off_a[i] + off_b;
+        if ((w_a[i] | w_b) == 0) {
+            // On the source grid: always the case without resizing
+            c0[i] = p[0];
+            c1[i] = p[1];
+            c2[i] = p[2];
+            continue;
+        }
+        const uint8_t* q = p + step_b;
+        uint32_t sa = step_a[i], wa = w_a[i], ia = 256 - wa;
+        uint8_t px[3];
+        for (int c = 0; c < 3; ++c) {
+            uint32_t top = p[c] * ia + p[sa + c] * wa;
+            uint32_t bottom = q[c] * ia + q[sa + c] * wa;
+            px[c] = static_cast<uint8_t>((top * ib + bottom * w_b + 32768) >> 16);
+        }
+        c0[i] = px[0];
+        c1[i] = px[1];
+        c2[i] = px[2];
+    }
+}
+
+static void sample_scalar(const uint8_t* src, size_t, const uint32_t* off_a, const uint32_t* step_a,
+                          const uint16_t* w_a, uint32_t off_b, uint32_t step_b, uint32_t w_b,
+                          uint8_t* c0, uint8_t* c1, uint8_t* c2, size_t n) {
+    sample_from(src, off_a, step_a, w_a, off_b, step_b, w_b, c0, c1, c2, 0, n);
+}
+
+static void mix_from(const uint8_t* a, const uint8_t* b, const uint8_t* c, const Mix& m, uint8_t* out,
+                     size_t i, size_t n) {
+    for (; i < n; ++i) {
+        out[i] = clamp_u8(((m.c0 * a[i] + m.c1 * b[i] + m.c2 * c[i] + m.round) >> 8) + m.bias);
+    }
+}
+
+static void mix_scalar(const uint8_t* a, const uint8_t* b, const uint8_t* c, const Mix& m, uint8_t* out, size_t n) {
+    mix_from(a, b, c, m, out, 0, n);
+}
+
+static void chroma_from(const uint8_t* a0, const uint8_t* b0, const uint8_t* c0,
+                        const uint8_t* a1, const uint8_t* b1, const uint8_t* c1,
+                        const Mix& mu, const Mix& mv, uint8_t* u, uint8_t* v, size_t i, size_t n) {
+    for (; i + 1 < n; i += 2) {
+        int a = (a0[i] + a0[i + 1] + a1[i] + a1[i + 1] + 2) >> 2;
+        int b = (b0[i] + b0[i + 1] + b1[i] + b1[i + 1] + 2) >> 2;
+        int c = (c0[i] + c0[i + 1] + c1[i] + c1[i + 1] + 2) >> 2;
+        u[i / 2] = clamp_u8(((mu.c0 * a + mu.c1 * b + mu.c2 * c + mu.round) >> 8) + mu.bias);
+        v[i / 2] = clamp_u8(((mv.c0 * a + mv.c1 * b + mv.c2 * c + mv.round) >> 8) + mv.bias);
+    }
+}
+
+static void chroma_scalar(const uint8_t* a0, const uint8_t* b0, const uint8_t* c0,
+                          const uint8_t* a1, const uint8_t* b1, const uint8_t* c1,
+                          const Mix& mu, const Mix& mv, uint8_t* u, uint8_t* v, size_t n) {
+    chroma_from(a0, b0, c0, a1, b1, c1, mu, mv, u, v, 0, n);
+}
+
+static void interleave_scalar(const uint8_t* u, const uint8_t* v, uint8_t* uv, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        uv[2 * i] = u[i];
+        uv[2 * i + 1] = v[i];
+    }
+}
+
+static void pack3_scalar(const uint8_t* a, const uint8_t* b, const uint8_t* c, uint8_t* out, size_t n) {
+    for (size_t i = 0; i < n; ++i, out += 3) {
+        out[0] = a[i];
+        out[1] = b[i];
+        out[2] = c[i];
+    }
+}
+
+static void pack4_scalar(const uint8_t* a, const uint8_t* b, const uint8_t* c, uint8_t* out, size_t n) {
+    for (size_t i = 0; i < n; ++i, out += 4) {
+        out[0] = a[i];
+        out[1] = b[i];
+        out[2] = c[i];
+        out[3] = 255;
+    }
+}
+
+static const float INV_255 = 1.0f / 255.0f;
+
+static void to_float_scalar(const uint8_t* p, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = p[i] * INV_255;
+    }
+}
+
+#if defined(SUPERCAMERA_X86)
+
+// 8 values each of a, b, c (16-bit lanes) -> 8 results of
+// ((c0 a + c1 b + c2 c + round) >> 8) + bias, saturated to 16 bits
+__attribute__((target("sse2")))
+static __m128i weigh_sse2(__m128i a, __m128i b, __m128i c, __m128i ab_coef, __m128i c1_coef, __m128i bias) {
+    const __m128i one = _mm_set1_epi16(1);
+    __m128i c1_lo = _mm_unpacklo_epi16(c, one), c1_hi = _mm_unpackhi_epi16(c, one);
+    __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), ab_coef), _mm_madd_epi16(c1_lo, c1_coef));
+    __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), ab_coef), _mm_madd_epi16(c1_hi, c1_coef));
+    return _mm_add_epi16(_mm_packs_epi32(_mm_srai_epi32(lo, 8), _mm_srai_epi32(hi, 8)), bias);
+}
+
+__attribute__((target("sse2")))
+static inline __m128i coef_pair_sse2(int a, int b) {
+    return _mm_set_epi16(b, a, b, a, b, a, b, a);
+}
+
+__attribute__((target("sse2")))
+static void mix_sse2(const uint8_t* a, const uint8_t* b, const uint8_t* c, const Mix& m, uint8_t* out, size_t n) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ab = coef_pair_sse2(m.c0, m.c1), c1 = coef_pair_sse2(m.c2, m.round), bias = _mm_set1_epi16(m.bias);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i a16 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(a + i)), zero);
+        __m128i b16 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(b + i)), zero);
+        __m128i c16 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(c + i)), zero);
+        __m128i v16 = weigh_sse2(a16, b16, c16, ab, c1, bias);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(v16, v16));
+    }
+    mix_from(a, b, c, m, out, i, n);
+}
+
+// Rounded mean of each horizontal pair across two rows: 16 pixels -> 8 lanes
+__attribute__((target("sse2")))
+static __m128i quad_mean_sse2(const uint8_t* p0, const uint8_t* p1) {
+    const __m128i low = _mm_set1_epi16(0x00FF);
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p0));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p1));
+    __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a, low), _mm_srli_epi16(a, 8)),
+                                _mm_add_epi16(_mm_and_si128(b, low), _mm_srli_epi16(b, 8)));
+    return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+}
+
+__attribute__((target("sse2")))
+static void chroma_sse2(const uint8_t* a0, const uint8_t* b0, const uint8_t* c0,
+                        const uint8_t* a1, const uint8_t* b1, const uint8_t* c1,
+                        const Mix& mu, const Mix& mv, uint8_t* u, uint8_t* v, size_t n) {
+    const __m128i u_ab = coef_pair_sse2(mu.c0, mu.c1), u_c1 = coef_pair_sse2(mu.c2, mu.round);
+    const __m128i v_ab = coef_pair_sse2(mv.c0, mv.c1), v_c1 = coef_pair_sse2(mv.c2, mv.round);
+    const __m128i u_bias = _mm_set1_epi16(mu.bias), v_bias = _mm_set1_epi16(mv.bias);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = quad_mean_sse2(a0 + i, a1 + i);
+        __m128i b = quad_mean_sse2(b0 + i, b1 + i);
+        __m128i c = quad_mean_sse2(c0 + i, c1 + i);
+        __m128i u16 = weigh_sse2(a, b, c, u_ab, u_c1, u_bias);
+        __m128i v16 = weigh_sse2(a, b, c, v_ab, v_c1, v_bias);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(u + i / 2), _mm_packus_epi16(u16, u16));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(v + i / 2), _mm_packus_epi16(v16, v16));
+    }
+    chroma_from(a0, b0, c0, a1, b1, c1, mu, mv, u, v, i, n);
+}
+
+__attribute__((target("sse2")))
+static void interleave_sse2(const uint8_t* u, const uint8_t* v, uint8_t* uv, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(u + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(uv + 2 * i), _mm_unpacklo_epi8(a, b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(uv + 2 * i + 16), _mm_unpackhi_epi8(a, b));
+    }
+    interleave_scalar(u + i, v + i, uv + 2 * i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void pack4_sse2(const uint8_t* a, const uint8_t* b, const uint8_t* c, uint8_t* out, size_t n) {
+    const __m128i opaque = _mm_set1_epi8(-1);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        __m128i vc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c + i));
+        __m128i ab_lo = _mm_unpacklo_epi8(va, vb), ab_hi = _mm_unpackhi_epi8(va, vb);
+        __m128i cx_lo = _mm_unpacklo_epi8(vc, opaque), cx_hi = _mm_unpackhi_epi8(vc, opaque);
+        __m128i* dst = reinterpret_cast<__m128i*>(out + 4 * i);
+        _mm_storeu_si128(dst,     _mm_unpacklo_epi16(ab_lo, cx_lo));
+        _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(ab_lo, cx_lo));
+        _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(ab_hi, cx_hi));
+        _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(ab_hi, cx_hi));
+    }
+    pack4_scalar(a + i, b + i, c + i, out + 4 * i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void to_float_sse2(const uint8_t* p, float* out, size_t n) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 scale = _mm_set1_ps(INV_255);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+        _mm_storeu_ps(out + i,      _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale));
+        _mm_storeu_ps(out + i + 4,  _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale));
+        _mm_storeu_ps(out + i + 8,  _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale));
+        _mm_storeu_ps(out + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale));
+    }
+    to_float_scalar(p + i, out + i, n - i);
+}
+
+// Channel c of the pixels gathered in `left` and `right` as 16-bit pairs
+// (left, right) in each 32-bit lane, ready for pmaddwd with (1 - w, w)
+__attribute__((target("avx2")))
+static __m256i channel_pair_avx2(__m256i left, __m256i right, int c) {
+    const __m256i low = _mm256_set1_epi32(0x00FF00FF);
+    if (c == 1) {
+        left = _mm256_srli_epi16(left, 8);
+        right = _mm256_srli_epi16(right, 8);
+    } else {
+        left = _mm256_and_si256(left, low);
+        right = _mm256_and_si256(right, low);
+        if (c == 2) {
+            return _mm256_blend_epi16(_mm256_srli_epi32(left, 16), right, 0xAA);
+        }
+    }
+    return _mm256_blend_epi16(left, _mm256_slli_epi32(right, 16), 0xAA);
+}
+
+// Eight pixels per step from four 32-bit gathers (the fourth byte is the
+// next pixel's and is dropped). A gather reads one byte past the pixel, so
+// steps whose farthest read would pass the end of the source go scalar.
+// Gathers for a neighbour with zero weight are skipped, and a step with no
+// weights at all (always the case without resizing) only reorders bytes.
+__attribute__((target("avx2")))
+static void sample_avx2(const uint8_t* src, size_t src_size, const uint32_t* off_a, const uint32_t* step_a,
+                        const uint16_t* w_a, uint32_t off_b, uint32_t step_b, uint32_t w_b,
+                        uint8_t* c0, uint8_t* c1, uint8_t* c2, size_t n) {
+    size_t i = 0;
+    if (src_size >= 4) {
+        const int* base = reinterpret_cast<const int*>(src);
+        const __m256i last = _mm256_set1_epi32(static_cast<int>(src_size - 4));
+        const __m256i row = _mm256_set1_epi32(static_cast<int>(off_b));
+        const __m256i down = _mm256_set1_epi32(static_cast<int>(step_b));
+        const __m256i full = _mm256_set1_epi32(256);
+        const __m256i wb = _mm256_set1_epi32(static_cast<int>(w_b)), ib = _mm256_sub_epi32(full, wb);
+        const __m256i round = _mm256_set1_epi32(32768);
+        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        const __m256i planar = _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+                                                0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+        for (; i + 8 <= n; i += 8) {
+            __m256i p = _mm256_add_epi32(row, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(off_a + i)));
+            __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(step_a + i));
+            __m256i far = _mm256_add_epi32(_mm256_add_epi32(p, right), down);
+            if (_mm256_movemask_epi8(_mm256_cmpgt_epi32(far, last))) {
+                sample_from(src, off_a, step_a, w_a, off_b, step_b, w_b, c0, c1, c2, i, i + 8);
+                continue;
+            }
+            __m256i wa = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(w_a + i)));
+            __m256i weights = _mm256_or_si256(_mm256_sub_epi32(full, wa), _mm256_slli_epi32(wa, 16));
+            bool across = !_mm256_testz_si256(wa, wa);
+            __m256i tl = _mm256_i32gather_epi32(base, p, 1);
+            // Bytes per lane: c0, c1, c2 and a fourth of pixels 0-3 | the same of 4-7
+            __m256i bytes;
+            if (!across && !w_b) {
+                bytes = _mm256_shuffle_epi8(tl, planar);
+            } else {
+                __m256i tr = across ? _mm256_i32gather_epi32(base, _mm256_add_epi32(p, right), 1) : tl;
+                __m256i bl = tl, br = tr;
+                if (w_b) {
+                    __m256i q = _mm256_add_epi32(p, down);
+                    bl = _mm256_i32gather_epi32(base, q, 1);
+                    br = across ? _mm256_i32gather_epi32(base, _mm256_add_epi32(q, right), 1) : bl;
+                }
+                __m256i v[3];
+                for (int c = 0; c < 3; ++c) {
+                    __m256i top = _mm256_madd_epi16(channel_pair_avx2(tl, tr, c), weights);
+                    __m256i bottom = _mm256_madd_epi16(channel_pair_avx2(bl, br, c), weights);
+                    __m256i sum = _mm256_add_epi32(_mm256_mullo_epi32(top, ib), _mm256_mullo_epi32(bottom, wb));
+                    v[c] = _mm256_srli_epi32(_mm256_add_epi32(sum, round), 16);
+                }
+                bytes = _mm256_packus_epi16(_mm256_packus_epi32(v[0], v[1]), _mm256_packus_epi32(v[2], v[2]));
+            }
+            bytes = _mm256_permutevar8x32_epi32(bytes, order);
+            __m128i lo = _mm256_castsi256_si128(bytes);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(c0 + i), lo);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(c1 + i), _mm_unpackhi_epi64(lo, lo));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(c2 + i), _mm256_extracti128_si256(bytes, 1));
+        }
+        _mm256_zeroupper();
+    }
+    sample_from(src, off_a, step_a, w_a, off_b, step_b, w_b, c0, c1, c2, i, n);
+}
+
+// AVX2 versions of weigh_sse2: unpack/pack work per 128-bit lane, and since
+// unpacklo/unpackhi followed by packs restores the order within each lane,
+// 16 in-order lanes in give 16 in-order results out.
+__attribute__((target("avx2")))
+static __m256i weigh_avx2(__m256i a, __m256i b, __m256i c, __m256i ab_coef, __m256i c1_coef, __m256i bias) {
+    const __m256i one = _mm256_set1_epi16(1);
+    __m256i c1_lo = _mm256_unpacklo_epi16(c, one), c1_hi = _mm256_unpackhi_epi16(c, one);
+    __m256i lo = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), ab_coef), _mm256_madd_epi16(c1_lo, c1_coef));
+    __m256i hi = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), ab_coef), _mm256_madd_epi16(c1_hi, c1_coef));
+    return _mm256_add_epi16(_mm256_packs_epi32(_mm256_srai_epi32(lo, 8), _mm256_srai_epi32(hi, 8)), bias);
+}
+
+__attribute__((target("avx2")))
+static __m128i pack_u8_avx2(__m256i v16) {
+    return _mm_packus_epi16(_mm256_castsi256_si128(v16), _mm256_extracti128_si256(v16, 1));
+}
+
+__attribute__((target("avx2")))
+static void mix_avx2(const uint8_t* a, const uint8_t* b, const uint8_t* c, const Mix& m, uint8_t* out, size_t n) {
+    const __m256i ab = _mm256_broadcastsi128_si256(coef_pair_sse2(m.c0, m.c1));
+    const __m256i c1 = _mm256_broadcastsi128_si256(coef_pair_sse2(m.c2, m.round));
+    const __m256i bias = _mm256_set1_epi16(m.bias);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i a16 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+        __m256i b16 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        __m256i c16 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(c + i)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), pack_u8_avx2(weigh_avx2(a16, b16, c16, ab, c1, bias)));
+    }
+    _mm256_zeroupper();
+    mix_sse2(a + i, b + i, c + i, m, out + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static __m256i quad_mean_avx2(const uint8_t* p0, const uint8_t* p1) {
+    const __m256i low = _mm256_set1_epi16(0x00FF);
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p0));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p1));
+    __m256i sum = _mm256_add_epi16(_mm256_add_epi16(_mm256_and_si256(a, low), _mm256_srli_epi16(a, 8)),
+                                   _mm256_add_epi16(_mm256_and_si256(b, low), _mm256_srli_epi16(b, 8)));
+    return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(2)), 2);
+}
+
+__attribute__((target("avx2")))
+static void chroma_avx2(const uint8_t* a0, const uint8_t* b0, const uint8_t* c0,
+                        const uint8_t* a1, const uint8_t* b1, const uint8_t* c1,
+                        const Mix& mu, const Mix& mv, uint8_t* u, uint8_t* v, size_t n) {
+    const __m256i u_ab = _mm256_broadcastsi128_si256(coef_pair_sse2(mu.c0, mu.c1));
+    const __m256i u_c1 = _mm256_broadcastsi128_si256(coef_pair_sse2(mu.c2, mu.round));
+    const __m256i v_ab = _mm256_broadcastsi128_si256(coef_pair_sse2(mv.c0, mv.c1));
+    const __m256i v_c1 = _mm256_broadcastsi128_si256(coef_pair_sse2(mv.c2, mv.round));
+    const __m256i u_bias = _mm256_set1_epi16(mu.bias), v_bias = _mm256_set1_epi16(mv.bias);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i a = quad_mean_avx2(a0 + i, a1 + i);
+        __m256i b = quad_mean_avx2(b0 + i, b1 + i);
+        __m256i c = quad_mean_avx2(c0 + i, c1 + i);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(u + i / 2), pack_u8_avx2(weigh_avx2(a, b, c, u_ab, u_c1, u_bias)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(v + i / 2), pack_u8_avx2(weigh_avx2(a, b, c, v_ab, v_c1, v_bias)));
+    }
+    _mm256_zeroupper();
+    chroma_sse2(a0 + i, b0 + i, c0 + i, a1 + i, b1 + i, c1 + i, mu, mv, u + i / 2, v + i / 2, n - i);
+}
+
+// 16 pixels -> 48 bytes with pshufb (only in the AVX2 table: SSE2 has no
+// byte shuffle). Mask [j][k] places channel k into output vector j.
+__attribute__((target("avx2")))
+static void pack3_avx2(const uint8_t* a, const uint8_t* b, const uint8_t* c, uint8_t* out, size_t n) {
+    static const int8_t masks[3][3][16] = {
+        {{0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5},
+         {-1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1},
+         {-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1}},
+        {{-1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1},
+         {5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10},
+         {-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1}},
+        {{-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1},
+         {-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1},
+         {10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15}},
+    };
+    __m128i m[3][3];
+    for (int j = 0; j < 3; ++j) {
+        for (int k = 0; k < 3; ++k) {
+            m[j][k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(masks[j][k]));
+        }
+    }
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        __m128i vc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c + i));
+        __m128i* dst = reinterpret_cast<__m128i*>(out + 3 * i);
+        for (int j = 0; j < 3; ++j) {
+            __m128i v = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(va, m[j][0]), _mm_shuffle_epi8(vb, m[j][1])),
+                                     _mm_shuffle_epi8(vc, m[j][2]));
+            _mm_storeu_si128(dst + j, v);
+        }
+    }
+    pack3_scalar(a + i, b + i, c + i, out + 3 * i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void to_float_avx2(const uint8_t* p, float* out, size_t n) {
+    const __m256 scale = _mm256_set1_ps(INV_255);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + i)));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    _mm256_zeroupper();
+    to_float_scalar(p + i, out + i, n - i);
+}
+
+#endif // SUPERCAMERA_X86
+
+static const ConvertKernels& convert_kernels() {
+    static const KernelVariant<ConvertKernels> variants[] = {
+        {CpuLevel::Scalar, {sample_scalar, mix_scalar, chroma_scalar, interleave_scalar,
+                            pack3_scalar, pack4_scalar, to_float_scalar}},
+#if defined(SUPERCAMERA_X86)
+        {CpuLevel::SSE2, {sample_scalar, mix_sse2, chroma_sse2, interleave_sse2,
+                          pack3_scalar, pack4_sse2, to_float_sse2}},
+        {CpuLevel::AVX2, {sample_avx2, mix_avx2, chroma_avx2, interleave_sse2,
+                          pack3_avx2, pack4_sse2, to_float_avx2}},
+#endif
+    };
+    static const ConvertKernels bound = select_kernels(variants);
+    return bound;
+}
+
+size_t converted_size(PixelFormat format, int width, int height) {
+    size_t pixels = static_cast<size_t>(width) * height;
+    switch (format) {
+        case PixelFormat::RGB:
+        case PixelFormat::BGR:         return pixels * 3;
+        case PixelFormat::RGBA:        return pixels * 4;
+        case PixelFormat::NV12:
+        case PixelFormat::I420:        return pixels + 2 * (pixels / 4);
+        case PixelFormat::PlanarFloat: return pixels * 3 * sizeof(float);
+    }
+    return 0;
+}
+
+PixelConverter::PixelConverter(const ConvertSpec& spec)
+    : spec_(spec), src_width_(0), src_height_(0), out_width_(0), out_height_(0) {
+}
+
+// Source coordinate of each output sample along one axis, with the output
+// pixel centres mapped onto the source grid (align-corners off)
+static void build_axis(int out_size, int src_size, uint32_t unit, bool reverse,
+                       std::vector<uint32_t>& offset, std::vector<uint32_t>& step, std::vector<uint16_t>& weight) {
+    offset.resize(out_size);
+    step.resize(out_size);
+    weight.resize(out_size);
+    double ratio = static_cast<double>(src_size) / out_size;
+    for (int i = 0; i < out_size; ++i) {
+        double pos = std::min(std::max((i + 0.5) * ratio - 0.5, 0.0), src_size - 1.0);
+        int i0 = static_cast<int>(pos);
+        int w = static_cast<int>(std::lround((pos - i0) * 256));
+        if (w == 256) {
+            ++i0;
+            w = 0;
+        }
+        int i1 = std::min(i0 + 1, src_size - 1);
+        int k = reverse ? out_size - 1 - i : i;
+        offset[k] = i0 * unit;
+        step[k] = (i1 - i0) * unit;
+        weight[k] = static_cast<uint16_t>(w);
+    }
+}
+
+void PixelConverter::build_taps(int src_width, int src_height, int out_width, int out_height) {
+    uint32_t row = static_cast<uint32_t>(src_width) * 3;
+    switch (spec_.rotation) {
+        case Rotation::None:
+            build_axis(out_width, src_width, 3, false, a_.offset, a_.step, a_.weight);
+            build_axis(out_height, src_height, row, false, b_.offset, b_.step, b_.weight);
+            break;
+        case Rotation::Cw180:
+            build_axis(out_width, src_width, 3, true, a_.offset, a_.step, a_.weight);
+            build_axis(out_height, src_height, row, true, b_.offset, b_.step, b_.weight);
+            break;
+        case Rotation::Cw90: // Output column x shows source row (height - 1 - x)
+            build_axis(out_width, src_height, row, true, a_.offset, a_.step, a_.weight);
+            build_axis(out_height, src_width, 3, false, b_.offset, b_.step, b_.weight);
+            break;
+        case Rotation::Cw270: // Output column x shows source row x, read right to left
+            build_axis(out_width, src_height, row, false, a_.offset, a_.step, a_.weight);
+            build_axis(out_height, src_width, 3, true, b_.offset, b_.step, b_.weight);
+            break;
+    }
+    src_width_ = src_width;
+    src_height_ = src_height;
+    out_width_ = out_width;
+    out_height_ = out_height;
+}
+
+
+bool PixelConverter::convert(const Image& source, ConvertedImage& out) {
+    if (source.channels != 3 || source.width <= 0 || source.height <= 0) {
+        return false;
+    }
+    bool sideways = spec_.rotation == Rotation::Cw90 || spec_.rotation == Rotation::Cw270;
+    int width = spec_.width > 0 ? spec_.width : (sideways ? source.height : source.width);
+    int height = spec_.height > 0 ? spec_.height : (sideways ? source.width : source.height);
+    bool yuv = spec_.format == PixelFormat::NV12 || spec_.format == PixelFormat::I420;
+    if (yuv && (width % 2 || height % 2)) {
+        return false;
+    }
+    if (source.width != src_width_ || source.height != src_height_ || width != out_width_ || height != out_height_) {
+        build_taps(source.width, source.height, width, height);
+    }
+
+    out.format = spec_.format;
+    out.width = width;
+    out.height = height;
+    out.data.resize(converted_size(spec_.format, width, height));
+
+    const uint8_t* src = source.pixels.data();
+    const ConvertKernels& k = convert_kernels();
+    size_t plane = static_cast<size_t>(width) * height;
+    bool ycbcr = spec_.input == ColorSpace::YCbCr;
+    const Mix* to_yuv = ycbcr ? YCBCR_TO_YUV : RGB_TO_YUV;
+
+    // Sample each tile into planar rows, then run the color kernels over
+    // them while they are still in L1. YCbCr input for RGB-based formats goes
+    // through one more set of rows, which also holds the chroma of NV12.
+    tile_.resize(static_cast<size_t>(TILE_ROWS + 1) * 3 * TILE_COLS);
+    uint8_t* extra = &tile_[static_cast<size_t>(TILE_ROWS) * 3 * TILE_COLS];
+    for (int ty = 0; ty < height; ty += TILE_ROWS) {
+        int y_end = std::min(ty + TILE_ROWS, height);
+        for (int tx = 0; tx < width; tx += TILE_COLS) {
+            int x_end = std::min(tx + TILE_COLS, width);
+            size_t n = static_cast<size_t>(x_end - tx);
+            for (int y = ty; y < y_end; ++y) {
+                uint8_t* c0 = &tile_[static_cast<size_t>(y - ty) * 3 * TILE_COLS];
+                uint8_t* c1 = c0 + TILE_COLS;
+                uint8_t* c2 = c1 + TILE_COLS;
+                k.sample(src, source.pixels.size(), &a_.offset[tx], &a_.step[tx], &a_.weight[tx],
+                         b_.offset[y], b_.step[y], b_.weight[y], c0, c1, c2, n);
+
+                size_t at = static_cast<size_t>(y) * width + tx;
+                if (yuv) {
+                    k.mix(c0, c1, c2, to_yuv[0], &out.data[at], n);
+                    if ((y - ty) % 2 == 1) {
+                        const uint8_t* p0 = c0 - 3 * TILE_COLS;
+                        size_t chroma_at = static_cast<size_t>(y / 2) * (width / 2) + tx / 2;
+                        if (spec_.format == PixelFormat::I420) {
+                            uint8_t* u = &out.data[plane + chroma_at];
+                            uint8_t* v = u + plane / 4;
+                            k.chroma(p0, p0 + TILE_COLS, p0 + 2 * TILE_COLS, c0, c1, c2, to_yuv[1], to_yuv[2], u, v, n);
+                        } else {
+                            k.chroma(p0, p0 + TILE_COLS, p0 + 2 * TILE_COLS, c0, c1, c2, to_yuv[1], to_yuv[2],
+                                     extra, extra + TILE_COLS / 2, n);
+                            k.interleave(extra, extra + TILE_COLS / 2, &out.data[plane + static_cast<size_t>(y / 2) * width + tx], n / 2);
+                        }
+                    }
+                    continue;
+                }
+
+                const uint8_t* r = c0;
+                const uint8_t* g = c1;
+                const uint8_t* b = c2;
+                if (ycbcr) {
+                    k.mix(c0, c1, c2, YCBCR_TO_RGB[0], extra, n);
+                    k.mix(c0, c1, c2, YCBCR_TO_RGB[1], extra + TILE_COLS, n);
+                    k.mix(c0, c1, c2, YCBCR_TO_RGB[2], extra + 2 * TILE_COLS, n);
+                    r = extra;
+                    g = extra + TILE_COLS;
+                    b = extra + 2 * TILE_COLS;
+                }
+                switch (spec_.format) {
+                    case PixelFormat::RGB:
+                        k.pack3(r, g, b, &out.data[at * 3], n);
+                        break;
+                    case PixelFormat::BGR:
+                        k.pack3(b, g, r, &out.data[at * 3], n);
+                        break;
+                    case PixelFormat::RGBA:
+                        k.pack4(r, g, b, &out.data[at * 4], n);
+                        break;
+                    case PixelFormat::PlanarFloat: {
+                        float* planes = reinterpret_cast<float*>(out.data.data());
+                        k.to_float(r, planes + at, n);
+                        k.to_float(g, planes + plane + at, n);
+                        k.to_float(b, planes + 2 * plane + at, n);
+                        break;
+                    }
+                    case PixelFormat::NV12:
+                    case PixelFormat::I420:
+                        break;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace supercamera
@@ -0,0 +1,337 @@
+#include "supercamera/cpu_dispatch.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "simd.h"
+
+namespace supercamera {
+
+// --- Scalar variants ---
+
+static size_t find_byte_scalar(const uint8_t* p, size_t n, uint8_t value) {
+    const void* hit = std::memchr(p, value, n);
+    return hit ? static_cast<size_t>(static_cast<const uint8_t*>(hit) - p) : n;
+}
+
+static size_t find_marker_from(const uint8_t* p, size_t i, size_t n, uint8_t second) {
+    for (; i + 1 < n; ++i) {
+        if (p[i] == 0xFF && p[i + 1] == second) {
+            return i;
+        }
+    }
+    return n;
+}
+
+static size_t find_marker_scalar(const uint8_t* p, size_t n, uint8_t second) {
+    size_t i = 0;
+    while (i + 1 < n) {
+        const void* ff = std::memchr(p + i, 0xFF, n - 1 - i);
+        if (!ff) {
+            return n;
+        }
+        i = static_cast<const uint8_t*>(ff) - p;
+        if (p[i + 1] == second) {
+            return i;
+        }
+        ++i;
+    }
+    return n;
+}
+
+static void unstuff_from(uint8_t* p, size_t i, size_t n) {
+    for (; i + 1 < n; ++i) {
+        if (p[i] == 0xFF && p[i + 1] == 0x24) {
+            p[i + 1] = 0x00;
+        }
+    }
+}
+
+static void unstuff_scalar(uint8_t* p, size_t n) {
+    unstuff_from(p, 0, n);
+}
+
+static void laplacian_from(const uint8_t* above, const uint8_t* row, const uint8_t* below, size_t x, size_t n,
+                           int64_t* sum, int64_t* sum_sq) {
+    int64_t s = 0, s2 = 0;
+    for (; x + 1 < n; ++x) {
+        int v = 4 * row[x] - row[x - 1] - row[x + 1] - above[x] - below[x];
+        s += v;
+        s2 += v * v;
+    }
+    *sum += s;
+    *sum_sq += s2;
+}
+
+static void laplacian_row_scalar(const uint8_t* above, const uint8_t* row, const uint8_t* below, size_t n,
+                                 int64_t* sum, int64_t* sum_sq) {
+    laplacian_from(above, row, below, 1, n, sum, sum_sq);
+}
+
+// --- x86 SIMD variants ---
+// Markers are found by comparing a block with the same block shifted by one
+// byte. Unstuffing only ever turns 0x24 into 0x00, neither of which is 0xFF,
+// so blocks can be rewritten independently with overlapping stores.
+
+#if defined(SUPERCAMERA_X86)
+
+__attribute__((target("sse2")))
+static size_t find_byte_sse2(const uint8_t* p, size_t n, uint8_t value) {
+    const __m128i v = _mm_set1_epi8(static_cast<char>(value));
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)), v));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    size_t rest = find_byte_scalar(p + i, n - i, value);
+    return i + rest;
+}
+
+__attribute__((target("sse2")))
+static size_t find_marker_sse2(const uint8_t* p, size_t n, uint8_t second) {
+    const __m128i ff = _mm_set1_epi8(static_cast<char>(0xFF));
+    const __m128i v2 = _mm_set1_epi8(static_cast<char>(second));
+    size_t i = 0;
+    for (; i + 17 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + 1));
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, ff), _mm_cmpeq_epi8(b, v2)));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return find_marker_from(p, i, n, second);
+}
+
+__attribute__((target("sse2")))
+static void unstuff_sse2(uint8_t* p, size_t n) {
+    const __m128i ff = _mm_set1_epi8(static_cast<char>(0xFF));
+    const __m128i v24 = _mm_set1_epi8(0x24);
+    size_t i = 0;
+    for (; i + 17 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + 1));
+        __m128i hit = _mm_and_si128(_mm_cmpeq_epi8(a, ff), _mm_cmpeq_epi8(b, v24));
+        if (_mm_movemask_epi8(hit)) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(p + i + 1), _mm_andnot_si128(hit, b));
+        }
+    }
+    unstuff_from(p, i, n);
+}
+
+__attribute__((target("avx2")))
+static size_t find_byte_avx2(const uint8_t* p, size_t n, uint8_t value) {
+    const __m256i v = _mm256_set1_epi8(static_cast<char>(value));
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i)), v)));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return i + find_byte_sse2(p + i, n - i, value);
+}
+
+__attribute__((target("avx2")))
+static size_t find_marker_avx2(const uint8_t* p, size_t n, uint8_t second) {
+    const __m256i ff = _mm256_set1_epi8(static_cast<char>(0xFF));
+    const __m256i v2 = _mm256_set1_epi8(static_cast<char>(second));
+    size_t i = 0;
+    for (; i + 33 <= n; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i + 1));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, ff), _mm256_cmpeq_epi8(b, v2))));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return find_marker_from(p, i, n, second);
+}
+
+__attribute__((target("avx2")))
+static void unstuff_avx2(uint8_t* p, size_t n) {
+    const __m256i ff = _mm256_set1_epi8(static_cast<char>(0xFF));
+    const __m256i v24 = _mm256_set1_epi8(0x24);
+    size_t i = 0;
+    for (; i + 33 <= n; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i + 1));
+        __m256i hit = _mm256_and_si256(_mm256_cmpeq_epi8(a, ff), _mm256_cmpeq_epi8(b, v24));
+        if (_mm256_movemask_epi8(hit)) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(p + i + 1), _mm256_andnot_si256(hit, b));
+        }
+    }
+    _mm256_zeroupper();
+    unstuff_from(p, i, n);
+}
+
+// The Laplacian of 8-bit input lies in [-1020, 1020], so it is computed in
+// 16-bit lanes and squared with madd into 32-bit lanes. Those are flushed to
+// 64 bits every LAPLACIAN_FLUSH iterations, well before they could overflow.
+
+static const int LAPLACIAN_FLUSH = 256;
+
+__attribute__((target("sse2")))
+static int64_t sum_epi32_sse2(__m128i v) {
+    int32_t lanes[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), v);
+    return static_cast<int64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+}
+
+__attribute__((target("sse2")))
+static void laplacian_row_sse2(const uint8_t* above, const uint8_t* row, const uint8_t* below, size_t n,
+                               int64_t* sum, int64_t* sum_sq) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    size_t x = 1;
+    while (x + 9 <= n) {
+        __m128i acc = _mm_setzero_si128(), acc_sq = _mm_setzero_si128();
+        for (int k = 0; k < LAPLACIAN_FLUSH && x + 9 <= n; ++k, x += 8) {
+            __m128i c = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + x)), zero);
+            __m128i l = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + x - 1)), zero);
+            __m128i r = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + x + 1)), zero);
+            __m128i u = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(above + x)), zero);
+            __m128i d = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(below + x)), zero);
+            __m128i lap = _mm_sub_epi16(_mm_slli_epi16(c, 2), _mm_add_epi16(_mm_add_epi16(l, r), _mm_add_epi16(u, d)));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(lap, ones));
+            acc_sq = _mm_add_epi32(acc_sq, _mm_madd_epi16(lap, lap));
+        }
+        *sum += sum_epi32_sse2(acc);
+        *sum_sq += sum_epi32_sse2(acc_sq);
+    }
+    laplacian_from(above, row, below, x, n, sum, sum_sq);
+}
+
+__attribute__((target("avx2")))
+static void laplacian_row_avx2(const uint8_t* above, const uint8_t* row, const uint8_t* below, size_t n,
+                               int64_t* sum, int64_t* sum_sq) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    size_t x = 1;
+    while (x + 17 <= n) {
+        __m256i acc = _mm256_setzero_si256(), acc_sq = _mm256_setzero_si256();
+        for (int k = 0; k < LAPLACIAN_FLUSH && x + 17 <= n; ++k, x += 16) {
+            __m256i c = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x)));
+            __m256i l = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x - 1)));
+            __m256i r = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x + 1)));
+            __m256i u = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x)));
+            __m256i d = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x)));
+            __m256i lap = _mm256_sub_epi16(_mm256_slli_epi16(c, 2),
+                                           _mm256_add_epi16(_mm256_add_epi16(l, r), _mm256_add_epi16(u, d)));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(lap, ones));
+            acc_sq = _mm256_add_epi32(acc_sq, _mm256_madd_epi16(lap, lap));
+        }
+        *sum += sum_epi32_sse2(_mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1)));
+        *sum_sq += sum_epi32_sse2(_mm_add_epi32(_mm256_castsi256_si128(acc_sq), _mm256_extracti128_si256(acc_sq, 1)));
+    }
+    _mm256_zeroupper();
+    laplacian_row_sse2(above + x - 1, row + x - 1, below + x - 1, n - x + 1, sum, sum_sq);
+}
+
+#endif // SUPERCAMERA_X86
+
+// --- Detection and binding ---
+
+const char* cpu_level_name(CpuLevel level) {
+    switch (level) {
+        case CpuLevel::Scalar: return "scalar";
+        case CpuLevel::SSE2:   return "sse2";
+        case CpuLevel::SSE41:  return "sse4.1";
+        case CpuLevel::AVX2:   return "avx2";
+        case CpuLevel::AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+CpuLevel detected_cpu_level() {
+#if defined(SUPERCAMERA_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        return CpuLevel::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return CpuLevel::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return CpuLevel::SSE41;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return CpuLevel::SSE2;
+    }
+#endif
+    return CpuLevel::Scalar;
+}
+
+static CpuLevel select_cpu_level() {
+    CpuLevel level = detected_cpu_level();
+    const char* env = std::getenv("SUPERCAMERA_CPU_LEVEL");
+    if (!env || !*env) {
+        return level;
+    }
+    const CpuLevel all[] = {CpuLevel::Scalar, CpuLevel::SSE2, CpuLevel::SSE41, CpuLevel::AVX2, CpuLevel::AVX512};
+    for (CpuLevel requested : all) {
+        if (std::string(env) == cpu_level_name(requested)) {
+            if (requested > level) {
+                std::cerr << "Warning: SUPERCAMERA_CPU_LEVEL=" << env << " exceeds this CPU, using "
+                          << cpu_level_name(level) << "." << std::endl;
+                return level;
+            }
+            return requested;
+        }
+    }
+    std::cerr << "Warning: unknown SUPERCAMERA_CPU_LEVEL \"" << env << "\", using " << cpu_level_name(level) << "." << std::endl;
+    return level;
+}
+
+static Kernels bind_kernels() {
+    Kernels k;
+    k.level = select_cpu_level();
+    k.find_byte = find_byte_scalar;
+    k.find_marker = find_marker_scalar;
+    k.unstuff = unstuff_scalar;
+    k.laplacian_row = laplacian_row_scalar;
+#if defined(SUPERCAMERA_X86)
+    if (k.level >= CpuLevel::SSE2) {
+        k.find_byte = find_byte_sse2;
+        k.find_marker = find_marker_sse2;
+        k.unstuff = unstuff_sse2;
+        k.laplacian_row = laplacian_row_sse2;
+    }
+    if (k.level >= CpuLevel::AVX2) {
+        k.find_byte = find_byte_avx2;
+        k.find_marker = find_marker_avx2;
+        k.unstuff = unstuff_avx2;
+        k.laplacian_row = laplacian_row_avx2;
+    }
+#endif
+    return k;
+}
+
+CpuLevel active_cpu_level() {
+    return kernels().level;
+}
+
+CpuLevel bound_cpu_level() {
+    CpuLevel level = active_cpu_level();
+    if (level == CpuLevel::SSE41) {
+        return CpuLevel::SSE2;
+    }
+    if (level == CpuLevel::AVX512) {
+        return CpuLevel::AVX2;
+    }
+    return level;
+}
+
+const Kernels& kernels() {
+    static const Kernels bound = bind_kernels();
+    return bound;
+}
+
+} // namespace supercamera
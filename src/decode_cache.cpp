@@ -0,0 +1,96 @@
+#include "supercamera/decode_cache.h"
+
+#include <utility>
+
+namespace supercamera {
+
+bool DecodeCache::Key::operator<(const Key& other) const {
+    if (frame_id != other.frame_id) {
+        return frame_id < other.frame_id;
+    }
+    if (scale_denom != other.scale_denom) {
+        return scale_denom < other.scale_denom;
+    }
+    if (profile != other.profile) {
+        return profile < other.profile;
+    }
+    if (format != other.format) {
+        return format < other.format;
+    }
+    if (stats != other.stats) {
+        return stats < other.stats;
+    }
+    return resilient < other.resilient;
+}
+
+DecodeCache::DecodeCache(size_t max_decoded_bytes, size_t max_frames)
+    : max_decoded_bytes_(max_decoded_bytes), max_frames_(max_frames) {
+}
+
+void DecodeCache::add(Frame frame) {
+    uint64_t id = frame.id;
+    std::shared_ptr<const Frame> stored = std::make_shared<const Frame>(std::move(frame));
+    std::lock_guard<std::mutex> lock(mutex_);
+    frames_[id] = stored;
+    // Frame ids only grow, so the lowest id is the oldest frame. Its decoded
+    // images are left to age out of the LRU on their own.
+    while (frames_.size() > max_frames_) {
+        frames_.erase(frames_.begin());
+    }
+}
+
+bool DecodeCache::contains(uint64_t frame_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return frames_.count(frame_id) != 0;
+}
+
+std::shared_ptr<const Image> DecodeCache::image(uint64_t frame_id, const DecodeOptions& options) {
+    Key key = {frame_id, options.scale_denom, options.profile, options.format, options.stats, options.resilient};
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::map<Key, LruList::iterator>::iterator cached = index_.find(key);
+    if (cached != index_.end()) {
+        ++stats_.hits;
+        lru_.splice(lru_.begin(), lru_, cached->second);
+        return cached->second->image;
+    }
+
+    std::map<uint64_t, std::shared_ptr<const Frame>>::iterator frame = frames_.find(frame_id);
+    if (frame == frames_.end()) {
+        ++stats_.unknown_frames;
+        return std::shared_ptr<const Image>();
+    }
+
+    ++stats_.misses;
+    std::shared_ptr<Image> decoded = std::make_shared<Image>();
+    decoder_.set_options(options);
+    if (!decoder_.decode(*frame->second, *decoded)) {
+        ++stats_.decode_errors;
+        return std::shared_ptr<const Image>();
+    }
+
+    size_t bytes = decoded->pixels.size();
+    if (bytes > max_decoded_bytes_) {
+        return decoded; // Would evict everything and still not fit
+    }
+    while (stats_.decoded_bytes + bytes > max_decoded_bytes_) {
+        stats_.decoded_bytes -= lru_.back().image->pixels.size();
+        index_.erase(lru_.back().key);
+        lru_.pop_back();
+        ++stats_.evictions;
+    }
+    Entry entry = {key, decoded};
+    lru_.push_front(entry);
+    index_[key] = lru_.begin();
+    stats_.decoded_bytes += bytes;
+    return decoded;
+}
+
+DecodeCache::Stats DecodeCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.frames = frames_.size();
+    return stats;
+}
+
+} // namespace supercamera
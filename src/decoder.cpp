@@ -0,0 +1,455 @@
+#include "supercamera/decoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <jpeglib.h>
+#include <setjmp.h>
+
+#include "supercamera/log.h"
+#include "supercamera/probes.h"
+
+CAMERA_PROBE_SEMAPHORE(decode_start);
+CAMERA_PROBE_SEMAPHORE(decode_end);
+
+namespace supercamera {
+
+static const JDIMENSION NO_DAMAGE = ~static_cast<JDIMENSION>(0);
+static const int MAX_BATCH_ROWS = 16; // Scanlines per jpeg_read_scanlines() call: up to one iMCU row
+
+struct Decoder::State {
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    jmp_buf jpeg_jmp_buf;
+    uint64_t frame_id;
+    void (*emit_message)(j_common_ptr, int); // libjpeg's own
+    bool scanning;                           // Between jpeg_start_decompress and the end of the frame
+    JDIMENSION damaged_imcu_row;             // First iMCU row reached by corrupt or missing data
+
+    // The frame being decoded
+    uint8_t* rows;
+    int width;
+    int height;
+    int channels;
+    int taken_rows; // Passed to the statistics and the sink
+    std::chrono::steady_clock::time_point started; // For the decode_end probe; kept here, clear of setjmp
+
+    // Corrupt-data warnings and errors alike leave every iMCU row before
+    // the one being read intact
+    void mark_damage() {
+        if (scanning) {
+            damaged_imcu_row = std::min(damaged_imcu_row, cinfo.input_iMCU_row);
+        }
+    }
+};
+
+// --- Statistics ---
+
+static void reset_stats(ImageStats& stats, ImageStats::Source source, int channels) {
+    stats.source = source;
+    stats.channels = channels;
+    stats.samples = 0;
+    std::memset(stats.histogram, 0, sizeof(stats.histogram));
+}
+
+// Separate tables per channel keep consecutive increments independent
+static void accumulate_rows(const uint8_t* pixels, size_t count, int channels, ImageStats& stats) {
+    if (channels == 1) {
+        uint32_t* h = stats.histogram[0];
+        for (size_t x = 0; x < count; ++x) {
+            ++h[pixels[x]];
+        }
+    } else {
+        uint32_t* h0 = stats.histogram[0];
+        uint32_t* h1 = stats.histogram[1];
+        uint32_t* h2 = stats.histogram[2];
+        for (size_t x = 0; x < count; ++x, pixels += 3) {
+            ++h0[pixels[0]];
+            ++h1[pixels[1]];
+            ++h2[pixels[2]];
+        }
+    }
+    stats.samples += count;
+}
+
+// Moments and clipping follow from the histogram: 256 steps instead of
+// per-pixel sums
+static void finish_stats(ImageStats& stats) {
+    for (int c = 0; c < 3; ++c) {
+        const uint32_t* h = stats.histogram[c];
+        uint64_t sum = 0, sum_sq = 0;
+        for (uint64_t v = 0; v < 256; ++v) {
+            sum += v * h[v];
+            sum_sq += v * v * h[v];
+        }
+        double n = static_cast<double>(std::max<uint64_t>(stats.samples, 1));
+        bool present = c < stats.channels;
+        stats.mean[c] = present ? sum / n : 0.0;
+        stats.variance[c] = present ? std::max(0.0, sum_sq / n - stats.mean[c] * stats.mean[c]) : 0.0;
+        stats.clipped_low[c] = present ? h[0] : 0;
+        stats.clipped_high[c] = present ? h[255] : 0;
+    }
+}
+
+// --- Decoder ---
+
+Decoder::Decoder() : state_(new State) {
+    struct jpeg_decompress_struct& cinfo = state_->cinfo;
+    cinfo.err = jpeg_std_error(&state_->jerr);
+    state_->jerr.trace_level = 0; // Set trace level to 2 for more detailed messages
+    // Custom error handling for libjpeg-turbo; messages go to the async logger
+    state_->jerr.error_exit = [](j_common_ptr cinfo) {
+        (*cinfo->err->output_message)(cinfo);
+        State* state = static_cast<State*>(cinfo->client_data);
+        state->mark_damage();
+        longjmp(state->jpeg_jmp_buf, 1);
+    };
+    state_->emit_message = state_->jerr.emit_message;
+    state_->jerr.emit_message = [](j_common_ptr cinfo, int msg_level) {
+        State* state = static_cast<State*>(cinfo->client_data);
+        if (msg_level < 0) {
+            state->mark_damage();
+        }
+        state->emit_message(cinfo, msg_level);
+    };
+    state_->jerr.output_message = [](j_common_ptr cinfo) {
+        char buffer[JMSG_LENGTH_MAX];
+        (*cinfo->err->format_message)(cinfo, buffer);
+        log::write(log::Level::Warning, "libjpeg", static_cast<State*>(cinfo->client_data)->frame_id,
+                   cinfo->err->msg_code, "%s", buffer);
+    };
+    state_->frame_id = log::NO_FRAME;
+    state_->scanning = false;
+    state_->damaged_imcu_row = NO_DAMAGE;
+    cinfo.client_data = static_cast<void*>(state_);
+    jpeg_create_decompress(&cinfo);
+}
+
+Decoder::~Decoder() {
+    jpeg_destroy_decompress(&state_->cinfo);
+    delete state_;
+}
+
+bool Decoder::decode(const Frame& frame, Image& image) {
+    return decode(frame.jpeg.data(), frame.jpeg.size(), image, frame.id);
+}
+
+// Output rows per iMCU row, the unit in which damage is tracked
+static int rows_per_imcu_row(const jpeg_decompress_struct& cinfo) {
+#if JPEG_LIB_VERSION >= 70
+    return cinfo.max_v_samp_factor * cinfo.min_DCT_v_scaled_size;
+#else
+    return cinfo.max_v_samp_factor * cinfo.min_DCT_scaled_size;
+#endif
+}
+
+// Where decoded scanlines go: begin() sizes the destination and returns
+// level 0's rows, row() runs once each is final and end() reports how many
+// came from intact data
+struct Decoder::Sink {
+    Sink() : has_previous(false) {}
+    virtual ~Sink() {}
+    virtual uint8_t* begin(int width, int height, int channels) = 0;
+    virtual void row(int y) = 0;
+    virtual void end(int valid_rows) = 0;
+
+    bool has_previous; // Set by begin(): the last good frame, same size, is still in place
+};
+
+struct Decoder::ImageSink : Decoder::Sink {
+    explicit ImageSink(Image& image) : image(image) {}
+
+    uint8_t* begin(int width, int height, int channels) override {
+        has_previous = image.valid_rows > 0 && image.width == width && image.height == height &&
+                       image.channels == channels;
+        image.width = width;
+        image.height = height;
+        image.channels = channels;
+        image.pixels.resize(static_cast<size_t>(width) * channels * height);
+        return image.pixels.data();
+    }
+    void row(int) override {}
+    void end(int valid_rows) override { image.valid_rows = valid_rows; }
+
+    Image& image;
+};
+
+// Halves each completed row pair straight into the next level while both
+// rows are still in cache, cascading down the levels
+struct Decoder::PyramidSink : Decoder::Sink {
+    PyramidSink(Pyramid& pyramid, int levels) : pyramid(pyramid), levels(levels) {}
+
+    uint8_t* begin(int width, int height, int channels) override {
+        has_previous = pyramid.valid_rows > 0 && !pyramid.levels.empty() && pyramid.levels[0].width == width &&
+                       pyramid.levels[0].height == height && pyramid.channels == channels;
+        pyramid.layout(width, height, channels, levels);
+        return pyramid.data(0);
+    }
+    void row(int y) override {
+        for (size_t level = 0; level + 1 < pyramid.levels.size() && y % 2 == 1; ++level) {
+            y /= 2;
+            if (y >= pyramid.levels[level + 1].height) {
+                break;
+            }
+            pyramid.halve_row(level, y);
+        }
+    }
+    void end(int valid_rows) override { pyramid.valid_rows = valid_rows; }
+
+    Pyramid& pyramid;
+    int levels;
+};
+
+bool Decoder::decode(const uint8_t* jpeg, size_t size, Image& image, uint64_t frame_id) {
+    ImageSink sink(image);
+    return run(jpeg, size, frame_id, sink, image.stats);
+}
+
+bool Decoder::decode_pyramid(const uint8_t* jpeg, size_t size, Pyramid& pyramid, int levels, uint64_t frame_id) {
+    if (levels < 1) {
+        return false;
+    }
+    PyramidSink sink(pyramid, levels);
+    return run(jpeg, size, frame_id, sink, pyramid.stats);
+}
+
+bool Decoder::run(const uint8_t* jpeg, size_t size, uint64_t frame_id, Sink& sink, ImageStats& stats) {
+    struct jpeg_decompress_struct& cinfo = state_->cinfo;
+    state_->started = CAMERA_PROBE_ENABLED(decode_end) ? std::chrono::steady_clock::now()
+                                                       : std::chrono::steady_clock::time_point();
+    CAMERA_PROBE2(decode_start, frame_id, size);
+    state_->frame_id = frame_id;
+    state_->scanning = false;
+    state_->damaged_imcu_row = NO_DAMAGE;
+    state_->rows = nullptr;
+
+    if (setjmp(state_->jpeg_jmp_buf)) {
+        int valid_rows = options_.resilient ? salvage(sink, stats) : 0;
+        // Leaves the object ready for the next frame
+        state_->scanning = false;
+        jpeg_abort_decompress(&cinfo);
+        if (valid_rows == 0) {
+            if (state_->rows) {
+                sink.end(0);
+            }
+            log::write(log::Level::Error, "decode", frame_id, 0, "libjpeg-turbo failed to decompress JPEG data.");
+            return false;
+        }
+        if (options_.stats) {
+            finish_stats(stats);
+        }
+        sink.end(valid_rows);
+        return true;
+    }
+
+    // Provide the JPEG data to the decompressor
+    jpeg_mem_src(&cinfo, const_cast<unsigned char*>(jpeg), static_cast<unsigned long>(size));
+
+    // Read the JPEG header
+    (void) jpeg_read_header(&cinfo, TRUE);
+
+    // Set parameters for decompression
+    switch (options_.format) {
+    case DecodeOptions::Gray: cinfo.out_color_space = JCS_GRAYSCALE; break;
+    case DecodeOptions::YCbCr: cinfo.out_color_space = JCS_YCbCr; break;
+    default: cinfo.out_color_space = JCS_RGB; break;
+    }
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = options_.scale_denom;
+    if (options_.profile == DecodeOptions::Quality) {
+        cinfo.dct_method = JDCT_ISLOW;
+        cinfo.do_fancy_upsampling = TRUE; // Use fancy upsampling for better quality
+        cinfo.do_block_smoothing = TRUE; // Use block smoothing
+    } else {
+        cinfo.dct_method = JDCT_IFAST;
+        cinfo.do_fancy_upsampling = FALSE;
+        cinfo.do_block_smoothing = FALSE;
+    }
+
+    // Start decompression
+    state_->scanning = true;
+    (void) jpeg_start_decompress(&cinfo);
+
+    // Allocate output buffer
+    state_->width = cinfo.output_width;
+    state_->height = cinfo.output_height;
+    state_->channels = cinfo.output_components;
+    state_->rows = sink.begin(state_->width, state_->height, state_->channels);
+    state_->taken_rows = 0;
+    size_t row_stride = static_cast<size_t>(state_->width) * state_->channels;
+    JSAMPROW row_pointers[MAX_BATCH_ROWS];
+    if (options_.stats) {
+        reset_stats(stats, ImageStats::Pixels, state_->channels);
+    } else {
+        stats.source = ImageStats::None;
+    }
+
+    // Read scanlines a batch at a time, taking statistics while the batch is
+    // still in cache. In resilient mode, stop at the first damaged iMCU row
+    // instead of decoding the garbage that follows it.
+    while (cinfo.output_scanline < cinfo.output_height) {
+        int batch = std::min<int>(MAX_BATCH_ROWS, cinfo.output_height - cinfo.output_scanline);
+        for (int i = 0; i < batch; ++i) {
+            row_pointers[i] = state_->rows + (cinfo.output_scanline + i) * row_stride;
+        }
+        (void) jpeg_read_scanlines(&cinfo, row_pointers, batch);
+        if (options_.resilient && intact_rows() < state_->height) {
+            break;
+        }
+        take_rows(cinfo.output_scanline, sink, stats);
+    }
+
+    int valid_rows;
+    if (cinfo.output_scanline < cinfo.output_height) {
+        valid_rows = salvage(sink, stats);
+        state_->scanning = false;
+        jpeg_abort_decompress(&cinfo);
+        if (valid_rows == 0) {
+            sink.end(0);
+            log::write(log::Level::Error, "decode", frame_id, 0, "No intact rows in damaged JPEG data.");
+            return false;
+        }
+    } else {
+        // Finish decompression
+        (void) jpeg_finish_decompress(&cinfo);
+        state_->scanning = false;
+        valid_rows = std::min(state_->height, intact_rows());
+    }
+    if (options_.stats) {
+        finish_stats(stats);
+    }
+    sink.end(valid_rows);
+
+    CAMERA_PROBE4(decode_end, frame_id, state_->width, state_->height,
+                  std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - state_->started).count());
+    return true;
+}
+
+int Decoder::intact_rows() const {
+    if (state_->damaged_imcu_row == NO_DAMAGE) {
+        return state_->height;
+    }
+    return static_cast<int>(state_->damaged_imcu_row) * rows_per_imcu_row(state_->cinfo);
+}
+
+// Rows are packed, so a batch is one run of pixels for the statistics
+void Decoder::take_rows(int end, Sink& sink, ImageStats& stats) {
+    if (end <= state_->taken_rows) {
+        return;
+    }
+    if (options_.stats) {
+        size_t row_stride = static_cast<size_t>(state_->width) * state_->channels;
+        accumulate_rows(state_->rows + state_->taken_rows * row_stride,
+                        static_cast<size_t>(end - state_->taken_rows) * state_->width, state_->channels, stats);
+    }
+    for (; state_->taken_rows < end; ++state_->taken_rows) {
+        sink.row(state_->taken_rows);
+    }
+}
+
+// Keeps the rows decoded before the damage and fills the rest from the last
+// good frame when the output still holds one of the same size, else with
+// mid-gray. Rows libjpeg had already written past the damage repeat the last
+// intact row. Returns the number of intact rows, 0 if there are none.
+int Decoder::salvage(Sink& sink, ImageStats& stats) {
+    int written = static_cast<int>(state_->cinfo.output_scanline);
+    int valid_rows = state_->rows ? std::min(written, intact_rows()) : 0;
+    if (valid_rows <= 0) {
+        return 0;
+    }
+    take_rows(valid_rows, sink, stats);
+
+    size_t row_stride = static_cast<size_t>(state_->width) * state_->channels;
+    const uint8_t* last_intact = state_->rows + (valid_rows - 1) * row_stride;
+    for (int y = valid_rows; y < state_->height; ++y) {
+        uint8_t* row = state_->rows + y * row_stride;
+        if (y < written) {
+            std::memcpy(row, last_intact, row_stride);
+        } else if (!sink.has_previous) {
+            std::memset(row, 128, row_stride);
+        }
+    }
+    take_rows(state_->height, sink, stats);
+    log::write(log::Level::Warning, "decode", state_->frame_id, valid_rows, "Kept %d of %d rows of damaged JPEG data.",
+               valid_rows, state_->height);
+    return valid_rows;
+}
+
+bool Decoder::coarse_stats(const uint8_t* jpeg, size_t size, ImageStats& stats, uint64_t frame_id) {
+    struct jpeg_decompress_struct& cinfo = state_->cinfo;
+    state_->frame_id = frame_id;
+
+    if (setjmp(state_->jpeg_jmp_buf)) {
+        jpeg_abort_decompress(&cinfo);
+        log::write(log::Level::Error, "decode", frame_id, 0, "libjpeg-turbo failed to read JPEG coefficients.");
+        stats.source = ImageStats::None;
+        return false;
+    }
+
+    jpeg_mem_src(&cinfo, const_cast<unsigned char*>(jpeg), static_cast<unsigned long>(size));
+    (void) jpeg_read_header(&cinfo, TRUE);
+    jvirt_barray_ptr* coefficients = jpeg_read_coefficients(&cinfo);
+
+    bool color = cinfo.num_components >= 3 && options_.format != DecodeOptions::Gray;
+    reset_stats(stats, ImageStats::Blocks, color ? 3 : 1);
+
+    // A DC coefficient is 8x the block's mean, level-shifted by 128
+    jpeg_component_info* luma = &cinfo.comp_info[0];
+    int dc_scale[3];
+    for (int c = 0; c < (color ? 3 : 1); ++c) {
+        dc_scale[c] = cinfo.comp_info[c].quant_table->quantval[0];
+    }
+    for (JDIMENSION row = 0; row < luma->height_in_blocks; ++row) {
+        JBLOCKARRAY y_blocks = (*cinfo.mem->access_virt_barray)(
+            reinterpret_cast<j_common_ptr>(&cinfo), coefficients[0], row, 1, FALSE);
+        JBLOCKROW chroma_rows[2] = {nullptr, nullptr};
+        JDIMENSION chroma_width[2] = {0, 0};
+        if (color) {
+            for (int c = 1; c < 3; ++c) {
+                jpeg_component_info* comp = &cinfo.comp_info[c];
+                JDIMENSION chroma_row = std::min<JDIMENSION>(row * comp->v_samp_factor / luma->v_samp_factor,
+                                                             comp->height_in_blocks - 1);
+                chroma_rows[c - 1] = (*cinfo.mem->access_virt_barray)(
+                    reinterpret_cast<j_common_ptr>(&cinfo), coefficients[c], chroma_row, 1, FALSE)[0];
+                chroma_width[c - 1] = comp->width_in_blocks;
+            }
+        }
+        for (JDIMENSION col = 0; col < luma->width_in_blocks; ++col) {
+            int y = y_blocks[0][col][0] * dc_scale[0] / 8 + 128;
+            if (!color) {
+                ++stats.histogram[0][std::min(255, std::max(0, y))];
+                continue;
+            }
+            int chroma[2];
+            for (int c = 0; c < 2; ++c) {
+                jpeg_component_info* comp = &cinfo.comp_info[c + 1];
+                JDIMENSION chroma_col = std::min<JDIMENSION>(col * comp->h_samp_factor / luma->h_samp_factor,
+                                                             chroma_width[c] - 1);
+                chroma[c] = chroma_rows[c][chroma_col][0] * dc_scale[c + 1] / 8;
+            }
+            int v[3];
+            if (options_.format == DecodeOptions::YCbCr) {
+                v[0] = y;
+                v[1] = chroma[0] + 128;
+                v[2] = chroma[1] + 128;
+            } else {
+                // JFIF full-range YCbCr -> RGB in 16-bit fixed point
+                v[0] = y + ((91881 * chroma[1] + 32768) >> 16);
+                v[1] = y - ((22554 * chroma[0] + 46802 * chroma[1] + 32768) >> 16);
+                v[2] = y + ((116130 * chroma[0] + 32768) >> 16);
+            }
+            for (int c = 0; c < 3; ++c) {
+                ++stats.histogram[c][std::min(255, std::max(0, v[c]))];
+            }
+        }
+        stats.samples += luma->width_in_blocks;
+    }
+    (void) jpeg_finish_decompress(&cinfo);
+    finish_stats(stats);
+    return true;
+}
+
+} // namespace supercamera
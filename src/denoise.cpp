@@ -0,0 +1,266 @@
+#include "supercamera/denoise.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "simd.h"
+
+namespace supercamera {
+
+// --- Kernels ---
+// The blend computes, per byte, with w the history weight (0..255)
+//   out = (cur * (256 - w) + prev * w + 128) >> 8
+// which stays within 16 unsigned bits, and stores it to both the frame and
+// the state. All levels produce identical bytes.
+
+struct DenoiseKernels {
+    // Sum of absolute differences of a[0..n) and b[0..n)
+    uint32_t (*sad)(const uint8_t* a, const uint8_t* b, size_t n);
+    void (*blend)(uint8_t* cur, uint8_t* prev, const uint8_t* w, size_t n);
+};
+
+static uint32_t sad_scalar(const uint8_t* a, const uint8_t* b, size_t n) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        sum += static_cast<uint32_t>(a[i] > b[i] ? a[i] - b[i] : b[i] - a[i]);
+    }
+    return sum;
+}
+
+static void blend_scalar(uint8_t* cur, uint8_t* prev, const uint8_t* w, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        uint8_t v = static_cast<uint8_t>((cur[i] * (256 - w[i]) + prev[i] * w[i] + 128) >> 8);
+        cur[i] = v;
+        prev[i] = v;
+    }
+}
+
+#if defined(SUPERCAMERA_X86)
+
+__attribute__((target("sse2")))
+static uint32_t sad_sse2(const uint8_t* a, const uint8_t* b, size_t n) {
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                                              _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i))));
+    }
+    uint32_t sum = static_cast<uint32_t>(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+    return sum + sad_scalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static inline __m128i blend_half_sse2(__m128i cur, __m128i prev, __m128i w, __m128i round) {
+    __m128i iw = _mm_sub_epi16(_mm_set1_epi16(256), w);
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(cur, iw), _mm_mullo_epi16(prev, w)), round), 8);
+}
+
+__attribute__((target("sse2")))
+static void blend_sse2(uint8_t* cur, uint8_t* prev, const uint8_t* w, size_t n) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(128);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + i));
+        __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + i));
+        __m128i wv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + i));
+        __m128i lo = blend_half_sse2(_mm_unpacklo_epi8(c, zero), _mm_unpacklo_epi8(p, zero),
+                                     _mm_unpacklo_epi8(wv, zero), round);
+        __m128i hi = blend_half_sse2(_mm_unpackhi_epi8(c, zero), _mm_unpackhi_epi8(p, zero),
+                                     _mm_unpackhi_epi8(wv, zero), round);
+        __m128i v = _mm_packus_epi16(lo, hi);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(cur + i), v);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(prev + i), v);
+    }
+    blend_scalar(cur + i, prev + i, w + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static uint32_t sad_avx2(const uint8_t* a, const uint8_t* b, size_t n) {
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+                                                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i))));
+    }
+    __m128i half = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    uint32_t sum = static_cast<uint32_t>(_mm_cvtsi128_si32(half) + _mm_cvtsi128_si32(_mm_srli_si128(half, 8)));
+    _mm256_zeroupper();
+    return sum + sad_sse2(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i blend_half_avx2(__m256i cur, __m256i prev, __m256i w, __m256i round) {
+    __m256i iw = _mm256_sub_epi16(_mm256_set1_epi16(256), w);
+    return _mm256_srli_epi16(
+        _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(cur, iw), _mm256_mullo_epi16(prev, w)), round), 8);
+}
+
+__attribute__((target("avx2")))
+static void blend_avx2(uint8_t* cur, uint8_t* prev, const uint8_t* w, size_t n) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i round = _mm256_set1_epi16(128);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur + i));
+        __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev + i));
+        __m256i wv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + i));
+        // Unpacks and the pack are per 128-bit lane, so byte order survives
+        __m256i lo = blend_half_avx2(_mm256_unpacklo_epi8(c, zero), _mm256_unpacklo_epi8(p, zero),
+                                     _mm256_unpacklo_epi8(wv, zero), round);
+        __m256i hi = blend_half_avx2(_mm256_unpackhi_epi8(c, zero), _mm256_unpackhi_epi8(p, zero),
+                                     _mm256_unpackhi_epi8(wv, zero), round);
+        __m256i v = _mm256_packus_epi16(lo, hi);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(cur + i), v);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(prev + i), v);
+    }
+    _mm256_zeroupper();
+    blend_sse2(cur + i, prev + i, w + i, n - i);
+}
+
+#endif // SUPERCAMERA_X86
+
+static const DenoiseKernels& denoise_kernels() {
+    static const KernelVariant<DenoiseKernels> variants[] = {
+        {CpuLevel::Scalar, {sad_scalar, blend_scalar}},
+#if defined(SUPERCAMERA_X86)
+        {CpuLevel::SSE2, {sad_sse2, blend_sse2}},
+        {CpuLevel::AVX2, {sad_avx2, blend_avx2}},
+#endif
+    };
+    static const DenoiseKernels bound = select_kernels(variants);
+    return bound;
+}
+
+// --- TemporalDenoiser ---
+
+TemporalDenoiser::TemporalDenoiser(const DenoiseConfig& config)
+    : config_(config), width_(0), height_(0), channels_(0), blocks_x_(0), blocks_y_(0), moving_fraction_(0),
+      pool_(std::max(1u, config.threads)) {
+    config_.block = std::max(1, config_.block);
+    config_.strength = std::min(255, std::max(0, config_.strength));
+    config_.noise_level = std::max(0, config_.noise_level);
+}
+
+void TemporalDenoiser::reset() {
+    width_ = height_ = channels_ = 0;
+    moving_fraction_ = 0;
+}
+
+bool TemporalDenoiser::apply(Image& image) {
+    size_t size = static_cast<size_t>(image.width) * image.height * image.channels;
+    if (image.width <= 0 || image.height <= 0 || image.channels <= 0 || image.pixels.size() < size) {
+        return false;
+    }
+    if (image.width != width_ || image.height != height_ || image.channels != channels_) {
+        width_ = image.width;
+        height_ = image.height;
+        channels_ = image.channels;
+        blocks_x_ = (width_ + config_.block - 1) / config_.block;
+        blocks_y_ = (height_ + config_.block - 1) / config_.block;
+        state_.assign(image.pixels.begin(), image.pixels.begin() + size);
+        sad_.assign(static_cast<size_t>(blocks_x_) * blocks_y_, 0);
+        block_weight_.assign(sad_.size(), 0);
+        weight_.assign(sad_.size(), 0);
+        scratch_.resize(static_cast<size_t>(pool_.threads()) * width_ * channels_);
+        moving_fraction_ = 0;
+        return true;
+    }
+    if (config_.strength == 0) {
+        return true;
+    }
+
+    pool_.run(std::min<unsigned>(pool_.threads(), blocks_y_), [&](unsigned band, unsigned bands) {
+        measure_blocks(image, blocks_y_ * band / bands, blocks_y_ * (band + 1) / bands);
+    });
+    choose_weights();
+    pool_.run(pool_.threads(), [&](unsigned band, unsigned bands) {
+        // Bands start on block rows so each can expand its weight row once per block row
+        int by0 = blocks_y_ * band / bands, by1 = blocks_y_ * (band + 1) / bands;
+        filter_rows(image, by0 * config_.block, std::min(height_, by1 * config_.block),
+                    &scratch_[static_cast<size_t>(band) * width_ * channels_]);
+    });
+    return true;
+}
+
+void TemporalDenoiser::measure_blocks(const Image& image, int by0, int by1) {
+    const DenoiseKernels& k = denoise_kernels();
+    size_t stride = static_cast<size_t>(width_) * channels_;
+    size_t block_bytes = static_cast<size_t>(config_.block) * channels_;
+
+    for (int by = by0; by < by1; ++by) {
+        uint32_t* sad = &sad_[static_cast<size_t>(by) * blocks_x_];
+        std::fill(sad, sad + blocks_x_, 0u);
+        int y1 = std::min(height_, (by + 1) * config_.block);
+        for (int y = by * config_.block; y < y1; ++y) {
+            const uint8_t* cur = &image.pixels[y * stride];
+            const uint8_t* prev = &state_[y * stride];
+            for (int bx = 0; bx < blocks_x_; ++bx) {
+                size_t offset = bx * block_bytes;
+                sad[bx] += k.sad(cur + offset, prev + offset, std::min(block_bytes, stride - offset));
+            }
+        }
+    }
+}
+
+// Full strength while the mean difference is within noise_level, fading
+// linearly to 0 at twice that; then each block takes the lowest weight of
+// its 3x3 neighbourhood
+void TemporalDenoiser::choose_weights() {
+    std::vector<uint8_t>& own = block_weight_;
+    int noise = config_.noise_level;
+    size_t moving = 0;
+
+    for (int by = 0; by < blocks_y_; ++by) {
+        uint64_t rows = std::min(height_, (by + 1) * config_.block) - by * config_.block;
+        for (int bx = 0; bx < blocks_x_; ++bx) {
+            uint64_t cols = std::min(width_, (bx + 1) * config_.block) - bx * config_.block;
+            uint64_t bytes = rows * cols * channels_;
+            uint64_t sad = sad_[static_cast<size_t>(by) * blocks_x_ + bx];
+            uint64_t w = 0;
+            if (noise == 0) {
+                w = sad == 0 ? config_.strength : 0;
+            } else if (sad < 2 * noise * bytes) {
+                uint64_t margin = std::min<uint64_t>(2 * noise * bytes - sad, noise * bytes);
+                w = config_.strength * margin / (noise * bytes);
+            }
+            own[static_cast<size_t>(by) * blocks_x_ + bx] = static_cast<uint8_t>(w);
+        }
+    }
+    for (int by = 0; by < blocks_y_; ++by) {
+        for (int bx = 0; bx < blocks_x_; ++bx) {
+            uint8_t w = 255;
+            for (int ny = std::max(0, by - 1); ny <= std::min(blocks_y_ - 1, by + 1); ++ny) {
+                for (int nx = std::max(0, bx - 1); nx <= std::min(blocks_x_ - 1, bx + 1); ++nx) {
+                    w = std::min(w, own[static_cast<size_t>(ny) * blocks_x_ + nx]);
+                }
+            }
+            weight_[static_cast<size_t>(by) * blocks_x_ + bx] = w;
+            if (w < config_.strength) {
+                ++moving;
+            }
+        }
+    }
+    moving_fraction_ = static_cast<double>(moving) / weight_.size();
+}
+
+void TemporalDenoiser::filter_rows(Image& image, int y0, int y1, uint8_t* weights) {
+    const DenoiseKernels& k = denoise_kernels();
+    size_t stride = static_cast<size_t>(width_) * channels_;
+    size_t block_bytes = static_cast<size_t>(config_.block) * channels_;
+
+    int block_row = -1;
+    for (int y = y0; y < y1; ++y) {
+        if (y / config_.block != block_row) {
+            block_row = y / config_.block;
+            const uint8_t* w = &weight_[static_cast<size_t>(block_row) * blocks_x_];
+            for (int bx = 0; bx < blocks_x_; ++bx) {
+                size_t offset = bx * block_bytes;
+                std::memset(weights + offset, w[bx], std::min(block_bytes, stride - offset));
+            }
+        }
+        k.blend(&image.pixels[y * stride], &state_[y * stride], weights, stride);
+    }
+}
+
+} // namespace supercamera
@@ -0,0 +1,124 @@
+#include "supercamera/dual_path.h"
+
+#include <utility>
+
+namespace supercamera {
+
+DualPathDecoder::DualPathDecoder(ImageCallback on_preview, const DualPathConfig& config)
+    : config_(config), on_preview_(on_preview), shutdown_(false) {
+    thread_ = std::thread(&DualPathDecoder::run, this);
+}
+
+DualPathDecoder::~DualPathDecoder() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shutdown_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void DualPathDecoder::submit(Frame frame) {
+    FramePtr retained = std::make_shared<const Frame>(std::move(frame));
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        retained_.push_back(retained);
+        while (retained_.size() > config_.retained_frames) {
+            retained_.pop_front();
+        }
+        if (pending_preview_) {
+            ++stats_.previews_skipped;
+        }
+        pending_preview_ = retained;
+    }
+    cv_.notify_one();
+}
+
+bool DualPathDecoder::request_full(uint64_t frame_id, ImageCallback on_full) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Recent frames are the likely targets, so search from the back
+        std::deque<FramePtr>::reverse_iterator it = retained_.rbegin();
+        while (it != retained_.rend() && (*it)->id != frame_id) {
+            ++it;
+        }
+        if (it == retained_.rend()) {
+            ++stats_.full_misses;
+            return false;
+        }
+        FullRequest request;
+        request.frame = *it;
+        request.callback = on_full;
+        full_requests_.push_back(request);
+    }
+    cv_.notify_one();
+    return true;
+}
+
+DualPathDecoder::Stats DualPathDecoder::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void DualPathDecoder::run() {
+    // One decompressor per path so neither pays for switching options
+    Decoder preview_decoder;
+    DecodeOptions preview_options;
+    preview_options.scale_denom = config_.preview_scale_denom;
+    preview_options.profile = config_.preview_profile;
+    preview_decoder.set_options(preview_options);
+    Decoder full_decoder;
+    Image preview, full;
+
+    while (true) {
+        FullRequest request;
+        FramePtr frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() { return shutdown_ || !full_requests_.empty() || pending_preview_; });
+            if (shutdown_) {
+                break;
+            }
+            if (!full_requests_.empty()) {
+                request = full_requests_.front();
+                full_requests_.pop_front();
+            } else {
+                frame.swap(pending_preview_);
+            }
+        }
+
+        if (request.frame) {
+            bool ok = full_decoder.decode(*request.frame, full);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++(ok ? stats_.full_decodes : stats_.decode_errors);
+            }
+            if (ok) {
+                request.callback(*request.frame, full);
+            } else {
+                request.callback(*request.frame, Image());
+            }
+        } else {
+            bool ok = preview_decoder.decode(*frame, preview);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++(ok ? stats_.previews : stats_.decode_errors);
+            }
+            if (ok) {
+                on_preview_(*frame, preview);
+            }
+        }
+    }
+
+    // Whoever asked for a full decode still hears back
+    std::deque<FullRequest> abandoned;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        abandoned.swap(full_requests_);
+    }
+    for (const FullRequest& request : abandoned) {
+        request.callback(*request.frame, Image());
+    }
+}
+
+} // namespace supercamera
@@ -0,0 +1,801 @@
+#include "supercamera/enhance.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "simd.h"
+
+namespace supercamera {
+
+static const int WEIGHT_ONE = 128; // 7-bit weights keep each blended tile row in 16 bits
+
+void make_gamma_curve(double gamma, uint8_t curve[256]) {
+    double exponent = gamma > 0 ? 1.0 / gamma : 1.0;
+    for (int v = 0; v < 256; ++v) {
+        curve[v] = static_cast<uint8_t>(std::lround(255.0 * std::pow(v / 255.0, exponent)));
+    }
+}
+
+// --- Blend kernels ---
+// Each pixel mixes the mappings of its four nearest tiles, gathered as a
+// quad (a b over c d) with the column weight as a (128 - wx, wx) pair:
+//   top = a * (128 - wx) + b * wx         (and bottom from c, d)
+//   out = (top * (128 - wy) + bottom * wy + 8192) >> 14
+// The SIMD variants evaluate both passes with pmaddwd, so every level
+// produces identical bytes.
+
+// Color LUT input tables: per channel and input value, the byte offset of
+// the lower grid point along that axis and the weight of the upper, 0..256,
+// packed as offset << 9 | weight
+struct LutAxes {
+    const uint32_t (*entry)[256];
+    uint32_t step[3];
+};
+
+static const int AXIS_WEIGHT_BITS = 9;
+static const uint32_t AXIS_WEIGHT_MASK = (1u << AXIS_WEIGHT_BITS) - 1;
+
+struct EnhanceKernels {
+    void (*blend)(const uint8_t* quads, const uint32_t* wx, int wy, uint8_t* out, size_t n);
+    // Scales n RGB pixels in place by mapped / luma, through recip = 65536 / luma
+    void (*gain)(const uint8_t* mapped, const uint8_t* luma, const uint32_t* recip, uint8_t* rgb, size_t n);
+    // BT.601 luma of n RGB pixels
+    void (*luma)(const uint8_t* rgb, uint8_t* luma, size_t n);
+    // Quad of tile mappings for each of n pixels: entry (first[x] << 8) + luma[x * step]
+    // of table, with step 1 or 3
+    void (*quads)(const uint8_t* table, const uint16_t* first, const uint8_t* luma, size_t step, uint8_t* out,
+                  size_t n);
+    // Maps n one- or three-channel pixels in place through their channel's curve
+    void (*curves)(const uint32_t (*curves)[256], int channels, uint8_t* p, size_t n);
+    // Tetrahedral lookup of n RGB pixels in place; table entries are padded to 4 bytes
+    void (*color_lut)(const uint8_t* table, const LutAxes& axes, uint8_t* rgb, size_t n);
+};
+
+static void blend_scalar(const uint8_t* quads, const uint32_t* wx, int wy, uint8_t* out, size_t n) {
+    for (size_t i = 0; i < n; ++i, quads += 4) {
+        int left = static_cast<int>(wx[i] & 0xFFFF), right = static_cast<int>(wx[i] >> 16);
+        int top = quads[0] * left + quads[1] * right;
+        int bottom = quads[2] * left + quads[3] * right;
+        out[i] = static_cast<uint8_t>((top * (WEIGHT_ONE - wy) + bottom * wy + 8192) >> 14);
+    }
+}
+
+// The gain is 8.8 fixed point, (mapped * recip + 128) >> 8, at most 65280,
+// so it fits 16 bits; each channel becomes min(255, (v * gain + 128) >> 8).
+static void gain_scalar(const uint8_t* mapped, const uint8_t* luma, const uint32_t* recip, uint8_t* rgb, size_t n) {
+    for (size_t i = 0; i < n; ++i, rgb += 3) {
+        uint32_t gain = (mapped[i] * recip[luma[i]] + 128) >> 8;
+        rgb[0] = static_cast<uint8_t>(std::min(255u, (rgb[0] * gain + 128) >> 8));
+        rgb[1] = static_cast<uint8_t>(std::min(255u, (rgb[1] * gain + 128) >> 8));
+        rgb[2] = static_cast<uint8_t>(std::min(255u, (rgb[2] * gain + 128) >> 8));
+    }
+}
+
+static void luma_scalar(const uint8_t* rgb, uint8_t* luma, size_t n) {
+    for (size_t i = 0; i < n; ++i, rgb += 3) {
+        luma[i] = static_cast<uint8_t>((77 * rgb[0] + 150 * rgb[1] + 29 * rgb[2] + 128) >> 8);
+    }
+}
+
+static void quads_scalar(const uint8_t* table, const uint16_t* first, const uint8_t* luma, size_t step, uint8_t* out,
+                         size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        size_t entry = (static_cast<size_t>(first[i]) << 8) + luma[i * step];
+        std::memcpy(out + i * 4, table + entry * 4, 4);
+    }
+}
+
+static void curves_scalar(const uint32_t (*curves)[256], int channels, uint8_t* p, size_t n) {
+    if (channels == 1) {
+        for (size_t i = 0; i < n; ++i) {
+            p[i] = static_cast<uint8_t>(curves[0][p[i]]);
+        }
+        return;
+    }
+    for (size_t i = 0; i < n; ++i, p += 3) {
+        p[0] = static_cast<uint8_t>(curves[0][p[0]]);
+        p[1] = static_cast<uint8_t>(curves[1][p[1]]);
+        p[2] = static_cast<uint8_t>(curves[2][p[2]]);
+    }
+}
+
+// The grid cell around the input is split into six tetrahedra along its main
+// diagonal; the one containing the input is picked by ordering the three
+// fractional weights, through a table indexed by the comparison bits
+// (f0 >= f1) | (f1 >= f2) << 1 | (f0 >= f2) << 2 since the order changes
+// from pixel to pixel. Keys 3 and 4 cannot occur. Both variants compute
+//   out = ((256 - wa) p0 + (wa - wb) p1 + (wb - wc) p2 + wc p3 + 128) >> 8
+static const uint8_t TETRAHEDRON[8][3] = {
+    {2, 1, 0}, {2, 0, 1}, {1, 2, 0}, {0, 1, 2}, {0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {0, 1, 2},
+};
+
+struct Tetrahedron {
+    const uint8_t* p0;
+    const uint8_t* p1;
+    const uint8_t* p2;
+    const uint8_t* p3;
+    int wa, wb, wc; // Fractions in decreasing order
+};
+
+static inline void locate(const uint8_t* table, const LutAxes& axes, const uint8_t* rgb, Tetrahedron& t) {
+    uint32_t e[3] = {axes.entry[0][rgb[0]], axes.entry[1][rgb[1]], axes.entry[2][rgb[2]]};
+    int f[3] = {static_cast<int>(e[0] & AXIS_WEIGHT_MASK), static_cast<int>(e[1] & AXIS_WEIGHT_MASK),
+                static_cast<int>(e[2] & AXIS_WEIGHT_MASK)};
+    const uint8_t* order = TETRAHEDRON[(f[0] >= f[1]) | (f[1] >= f[2]) << 1 | (f[0] >= f[2]) << 2];
+    t.p0 = table + (e[0] >> AXIS_WEIGHT_BITS) + (e[1] >> AXIS_WEIGHT_BITS) + (e[2] >> AXIS_WEIGHT_BITS);
+    t.p1 = t.p0 + axes.step[order[0]];
+    t.p2 = t.p1 + axes.step[order[1]];
+    t.p3 = t.p0 + axes.step[0] + axes.step[1] + axes.step[2];
+    t.wa = f[order[0]];
+    t.wb = f[order[1]];
+    t.wc = f[order[2]];
+}
+
+static void color_lut_scalar(const uint8_t* table, const LutAxes& axes, uint8_t* rgb, size_t n) {
+    Tetrahedron t;
+    for (size_t i = 0; i < n; ++i, rgb += 3) {
+        locate(table, axes, rgb, t);
+        for (int c = 0; c < 3; ++c) {
+            int v = (256 - t.wa) * t.p0[c] + (t.wa - t.wb) * t.p1[c] + (t.wb - t.wc) * t.p2[c] + t.wc * t.p3[c];
+            rgb[c] = static_cast<uint8_t>((v + 128) >> 8);
+        }
+    }
+}
+
+#if defined(SUPERCAMERA_X86)
+
+static inline __m128i load_u32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return _mm_cvtsi32_si128(static_cast<int>(v));
+}
+
+// All three channels of a pixel at once: the four vertices are interleaved
+// in pairs so that two pmaddwd apply the four weights
+__attribute__((target("sse2")))
+static void color_lut_sse2(const uint8_t* table, const LutAxes& axes, uint8_t* rgb, size_t n) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(128);
+    Tetrahedron t;
+    for (size_t i = 0; i < n; ++i, rgb += 3) {
+        locate(table, axes, rgb, t);
+        __m128i v01 = _mm_unpacklo_epi8(_mm_unpacklo_epi8(load_u32(t.p0), load_u32(t.p1)), zero);
+        __m128i v23 = _mm_unpacklo_epi8(_mm_unpacklo_epi8(load_u32(t.p2), load_u32(t.p3)), zero);
+        __m128i w01 = _mm_set1_epi32(static_cast<int>((static_cast<uint32_t>(t.wa - t.wb) << 16) | (256 - t.wa)));
+        __m128i w23 = _mm_set1_epi32(static_cast<int>((static_cast<uint32_t>(t.wc) << 16) | (t.wb - t.wc)));
+        __m128i v = _mm_add_epi32(_mm_madd_epi16(v01, w01), _mm_madd_epi16(v23, w23));
+        v = _mm_srai_epi32(_mm_add_epi32(v, round), 8);
+        v = _mm_packs_epi32(v, v);
+        uint32_t out = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(v, v)));
+        rgb[0] = static_cast<uint8_t>(out);
+        rgb[1] = static_cast<uint8_t>(out >> 8);
+        rgb[2] = static_cast<uint8_t>(out >> 16);
+    }
+}
+
+// Eight 16-bit channels times their gains, rounded and clamped to 0..255:
+// the 32-bit products saturate to 32767 in the pack, which packus clamps
+__attribute__((target("sse2")))
+static inline __m128i scale_channels_sse2(__m128i v, __m128i gain) {
+    const __m128i round = _mm_set1_epi32(128);
+    __m128i lo = _mm_mullo_epi16(v, gain), hi = _mm_mulhi_epu16(v, gain);
+    __m128i a = _mm_srli_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo, hi), round), 8);
+    __m128i b = _mm_srli_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo, hi), round), 8);
+    return _mm_packs_epi32(a, b);
+}
+
+// Eight pixels whose gains g0..g7 are the 16-bit lanes of `gains`: the gains
+// are spread to match the 24 interleaved channels, [g0 g0 g0 g1 g1 g1 g2 g2]
+// and so on, with word shuffles
+__attribute__((target("sse2")))
+static inline void scale_pixels_sse2(__m128i gains, uint8_t* rgb) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i low = _mm_unpacklo_epi64(gains, gains), high = _mm_unpackhi_epi64(gains, gains);
+    __m128i g0 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(low, _MM_SHUFFLE(1, 0, 0, 0)), _MM_SHUFFLE(2, 2, 1, 1));
+    __m128i g1 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(gains, _MM_SHUFFLE(3, 3, 3, 2)), _MM_SHUFFLE(1, 0, 0, 0));
+    __m128i g2 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(high, _MM_SHUFFLE(2, 2, 1, 1)), _MM_SHUFFLE(3, 3, 3, 2));
+    __m128i v01 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb));
+    __m128i v2 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(rgb + 16));
+    __m128i out01 = _mm_packus_epi16(scale_channels_sse2(_mm_unpacklo_epi8(v01, zero), g0),
+                                     scale_channels_sse2(_mm_unpackhi_epi8(v01, zero), g1));
+    __m128i out2 = scale_channels_sse2(_mm_unpacklo_epi8(v2, zero), g2);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(rgb), out01);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(rgb + 16), _mm_packus_epi16(out2, out2));
+}
+
+// The gains need one table lookup each, so only the scaling is vectorized
+__attribute__((target("sse2")))
+static void gain_sse2(const uint8_t* mapped, const uint8_t* luma, const uint32_t* recip, uint8_t* rgb, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8, rgb += 24) {
+        short g[8];
+        for (int j = 0; j < 8; ++j) {
+            g[j] = static_cast<short>((mapped[i + j] * recip[luma[i + j]] + 128) >> 8);
+        }
+        scale_pixels_sse2(_mm_setr_epi16(g[0], g[1], g[2], g[3], g[4], g[5], g[6], g[7]), rgb);
+    }
+    gain_scalar(mapped + i, luma + i, recip, rgb, n - i);
+}
+
+__attribute__((target("sse2")))
+static void blend_sse2(const uint8_t* quads, const uint32_t* wx, int wy, uint8_t* out, size_t n) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i wy_pair = _mm_set1_epi32(static_cast<int>((static_cast<uint32_t>(wy) << 16) | (WEIGHT_ONE - wy)));
+    const __m128i round = _mm_set1_epi32(8192);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i q0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(quads + i * 4));
+        __m128i q1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(quads + i * 4 + 16));
+        __m128i w0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(wx + i));
+        __m128i w1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(wx + i + 4));
+        // [a b c d] x [l r l r] -> [top bottom] per pixel, two pixels per madd
+        __m128i tb0 = _mm_madd_epi16(_mm_unpacklo_epi8(q0, zero), _mm_unpacklo_epi32(w0, w0));
+        __m128i tb1 = _mm_madd_epi16(_mm_unpackhi_epi8(q0, zero), _mm_unpackhi_epi32(w0, w0));
+        __m128i tb2 = _mm_madd_epi16(_mm_unpacklo_epi8(q1, zero), _mm_unpacklo_epi32(w1, w1));
+        __m128i tb3 = _mm_madd_epi16(_mm_unpackhi_epi8(q1, zero), _mm_unpackhi_epi32(w1, w1));
+        // Top and bottom fit in 16 bits, so they pair up again for the vertical pass
+        __m128i lo = _mm_madd_epi16(_mm_packs_epi32(tb0, tb1), wy_pair);
+        __m128i hi = _mm_madd_epi16(_mm_packs_epi32(tb2, tb3), wy_pair);
+        lo = _mm_srai_epi32(_mm_add_epi32(lo, round), 14);
+        hi = _mm_srai_epi32(_mm_add_epi32(hi, round), 14);
+        __m128i v = _mm_packs_epi32(lo, hi);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(v, v));
+    }
+    blend_scalar(quads + i * 4, wx + i, wy, out + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void blend_avx2(const uint8_t* quads, const uint32_t* wx, int wy, uint8_t* out, size_t n) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i wy_pair = _mm256_set1_epi32(static_cast<int>((static_cast<uint32_t>(wy) << 16) | (WEIGHT_ONE - wy)));
+    const __m256i round = _mm256_set1_epi32(8192);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        // Pixels 0-3 and 8-11 in q0's lanes, 4-7 and 12-15 in q1's, so that
+        // the per-lane packs below come out in order
+        __m256i q0 = _mm256_loadu2_m128i(reinterpret_cast<const __m128i*>(quads + i * 4 + 32),
+                                         reinterpret_cast<const __m128i*>(quads + i * 4));
+        __m256i q1 = _mm256_loadu2_m128i(reinterpret_cast<const __m128i*>(quads + i * 4 + 48),
+                                         reinterpret_cast<const __m128i*>(quads + i * 4 + 16));
+        __m256i w0 = _mm256_loadu2_m128i(reinterpret_cast<const __m128i*>(wx + i + 8),
+                                         reinterpret_cast<const __m128i*>(wx + i));
+        __m256i w1 = _mm256_loadu2_m128i(reinterpret_cast<const __m128i*>(wx + i + 12),
+                                         reinterpret_cast<const __m128i*>(wx + i + 4));
+        __m256i tb0 = _mm256_madd_epi16(_mm256_unpacklo_epi8(q0, zero), _mm256_unpacklo_epi32(w0, w0));
+        __m256i tb1 = _mm256_madd_epi16(_mm256_unpackhi_epi8(q0, zero), _mm256_unpackhi_epi32(w0, w0));
+        __m256i tb2 = _mm256_madd_epi16(_mm256_unpacklo_epi8(q1, zero), _mm256_unpacklo_epi32(w1, w1));
+        __m256i tb3 = _mm256_madd_epi16(_mm256_unpackhi_epi8(q1, zero), _mm256_unpackhi_epi32(w1, w1));
+        __m256i lo = _mm256_madd_epi16(_mm256_packs_epi32(tb0, tb1), wy_pair);
+        __m256i hi = _mm256_madd_epi16(_mm256_packs_epi32(tb2, tb3), wy_pair);
+        lo = _mm256_srai_epi32(_mm256_add_epi32(lo, round), 14);
+        hi = _mm256_srai_epi32(_mm256_add_epi32(hi, round), 14);
+        __m256i v = _mm256_packs_epi32(lo, hi);
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm256_castsi256_si128(packed));
+    }
+    _mm256_zeroupper();
+    blend_sse2(quads + i * 4, wx + i, wy, out + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i scale_channels_avx2(__m256i v, __m256i gain) {
+    const __m256i round = _mm256_set1_epi32(128);
+    __m256i lo = _mm256_mullo_epi16(v, gain), hi = _mm256_mulhi_epu16(v, gain);
+    __m256i a = _mm256_srli_epi32(_mm256_add_epi32(_mm256_unpacklo_epi16(lo, hi), round), 8);
+    __m256i b = _mm256_srli_epi32(_mm256_add_epi32(_mm256_unpackhi_epi16(lo, hi), round), 8);
+    return _mm256_packs_epi32(a, b);
+}
+
+// Sixteen pixels at a time, eight per lane, so the gains spread with the
+// same in-lane word shuffles as in scale_pixels_sse2(). The reciprocals are
+// gathered.
+__attribute__((target("avx2")))
+static void gain_avx2(const uint8_t* mapped, const uint8_t* luma, const uint32_t* recip, uint8_t* rgb, size_t n) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i round = _mm256_set1_epi32(128);
+    const int* table = reinterpret_cast<const int*>(recip);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16, rgb += 48) {
+        __m256i l0 = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(luma + i)));
+        __m256i l1 = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(luma + i + 8)));
+        __m256i m0 = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(mapped + i)));
+        __m256i m1 = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(mapped + i + 8)));
+        __m256i gain0 = _mm256_mullo_epi32(m0, _mm256_i32gather_epi32(table, l0, 4));
+        __m256i gain1 = _mm256_mullo_epi32(m1, _mm256_i32gather_epi32(table, l1, 4));
+        gain0 = _mm256_srli_epi32(_mm256_add_epi32(gain0, round), 8);
+        gain1 = _mm256_srli_epi32(_mm256_add_epi32(gain1, round), 8);
+        __m256i gains = _mm256_permute4x64_epi64(_mm256_packus_epi32(gain0, gain1), 0xD8);
+        __m256i low = _mm256_unpacklo_epi64(gains, gains), high = _mm256_unpackhi_epi64(gains, gains);
+        __m256i g0 = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(low, _MM_SHUFFLE(1, 0, 0, 0)), _MM_SHUFFLE(2, 2, 1, 1));
+        __m256i g1 = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(gains, _MM_SHUFFLE(3, 3, 3, 2)), _MM_SHUFFLE(1, 0, 0, 0));
+        __m256i g2 = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(high, _MM_SHUFFLE(2, 2, 1, 1)), _MM_SHUFFLE(3, 3, 3, 2));
+
+        __m256i v01 = _mm256_loadu2_m128i(reinterpret_cast<const __m128i*>(rgb + 24), reinterpret_cast<const __m128i*>(rgb));
+        __m256i v2 = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(rgb + 16))),
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(rgb + 40)), 1);
+        __m256i out01 = _mm256_packus_epi16(scale_channels_avx2(_mm256_unpacklo_epi8(v01, zero), g0),
+                                            scale_channels_avx2(_mm256_unpackhi_epi8(v01, zero), g1));
+        __m256i out2 = scale_channels_avx2(_mm256_unpacklo_epi8(v2, zero), g2);
+        out2 = _mm256_packus_epi16(out2, out2);
+        _mm256_storeu2_m128i(reinterpret_cast<__m128i*>(rgb + 24), reinterpret_cast<__m128i*>(rgb), out01);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(rgb + 16), _mm256_castsi256_si128(out2));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(rgb + 40), _mm256_extracti128_si256(out2, 1));
+    }
+    _mm256_zeroupper();
+    gain_sse2(mapped + i, luma + i, recip, rgb, n - i);
+}
+
+// Channel c of eight interleaved three-channel pixels, zero-extended to
+// 32-bit lanes: pixels 0-3 from p and 4-7 from p + 12. Reads 28 bytes.
+__attribute__((target("avx2")))
+static inline __m256i load_channel_avx2(const uint8_t* p, int c) {
+    const __m256i take = _mm256_setr_epi8(c, -1, -1, -1, 3 + c, -1, -1, -1, 6 + c, -1, -1, -1, 9 + c, -1, -1, -1,
+                                          c, -1, -1, -1, 3 + c, -1, -1, -1, 6 + c, -1, -1, -1, 9 + c, -1, -1, -1);
+    __m256i v = _mm256_loadu2_m128i(reinterpret_cast<const __m128i*>(p + 12), reinterpret_cast<const __m128i*>(p));
+    return _mm256_shuffle_epi8(v, take);
+}
+
+// Eight pixels at a time as (R, G) and (B, 1) word pairs, one pmaddwd each
+__attribute__((target("avx2")))
+static void luma_avx2(const uint8_t* rgb, uint8_t* luma, size_t n) {
+    const __m256i take_rg = _mm256_setr_epi8(0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1,
+                                             0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1);
+    const __m256i one_high = _mm256_set1_epi32(1 << 16);
+    const __m256i rg_weights = _mm256_set1_epi32(150 << 16 | 77);
+    const __m256i b_weights = _mm256_set1_epi32(128 << 16 | 29);
+    size_t i = 0;
+    // The loads read four bytes past the eighth pixel
+    for (; i + 10 <= n; i += 8, rgb += 24) {
+        __m256i v = _mm256_loadu2_m128i(reinterpret_cast<const __m128i*>(rgb + 12), reinterpret_cast<const __m128i*>(rgb));
+        __m256i y = _mm256_add_epi32(_mm256_madd_epi16(_mm256_shuffle_epi8(v, take_rg), rg_weights),
+                                     _mm256_madd_epi16(_mm256_or_si256(load_channel_avx2(rgb, 2), one_high), b_weights));
+        y = _mm256_srli_epi32(y, 8);
+        y = _mm256_packus_epi32(y, y);
+        y = _mm256_packus_epi16(y, y);
+        __m128i out = _mm_unpacklo_epi32(_mm256_castsi256_si128(y), _mm256_extracti128_si256(y, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(luma + i), out);
+    }
+    _mm256_zeroupper();
+    luma_scalar(rgb, luma + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void quads_avx2(const uint8_t* table, const uint16_t* first, const uint8_t* luma, size_t step, uint8_t* out,
+                       size_t n) {
+    const int* entries = reinterpret_cast<const int*>(table);
+    size_t i = 0;
+    // With step 3 the loads read four bytes past the eighth pixel
+    for (; i + (step == 1 ? 8 : 10) <= n; i += 8) {
+        __m256i v = step == 1 ? _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(luma + i)))
+                              : load_channel_avx2(luma + i * 3, 0);
+        __m256i tile = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(first + i)));
+        __m256i quad = _mm256_i32gather_epi32(entries, _mm256_add_epi32(_mm256_slli_epi32(tile, 8), v), 4);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * 4), quad);
+    }
+    _mm256_zeroupper();
+    quads_scalar(table, first + i, luma + i * step, step, out + i * 4, n - i);
+}
+
+// 24 channels at a time, gathered from the three curves as one table of
+// 768 entries; the offsets pick each channel's curve
+__attribute__((target("avx2")))
+static void curves_avx2(const uint32_t (*curves)[256], int channels, uint8_t* p, size_t n) {
+    bool rgb = channels == 3;
+    const __m256i offset0 = rgb ? _mm256_setr_epi32(0, 256, 512, 0, 256, 512, 0, 256) : _mm256_setzero_si256();
+    const __m256i offset1 = rgb ? _mm256_setr_epi32(512, 0, 256, 512, 0, 256, 512, 0) : _mm256_setzero_si256();
+    const __m256i offset2 = rgb ? _mm256_setr_epi32(256, 512, 0, 256, 512, 0, 256, 512) : _mm256_setzero_si256();
+    const int* table = reinterpret_cast<const int*>(curves[0]);
+    size_t count = n * channels, i = 0;
+    for (; i + 24 <= count; i += 24, p += 24) {
+        __m256i a = _mm256_i32gather_epi32(table, _mm256_add_epi32(
+            _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))), offset0), 4);
+        __m256i b = _mm256_i32gather_epi32(table, _mm256_add_epi32(
+            _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + 8))), offset1), 4);
+        __m256i c = _mm256_i32gather_epi32(table, _mm256_add_epi32(
+            _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + 16))), offset2), 4);
+        __m256i ab = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8);
+        __m256i cc = _mm256_permute4x64_epi64(_mm256_packus_epi32(c, c), 0xD8);
+        __m256i out = _mm256_permute4x64_epi64(_mm256_packus_epi16(ab, cc), 0xD8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm256_castsi256_si128(out));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(p + 16), _mm256_extracti128_si256(out, 1));
+    }
+    _mm256_zeroupper();
+    curves_scalar(curves, channels, p, (count - i) / channels);
+}
+
+// Eight pixels at a time. The axis entries and the four vertices are
+// gathered, and the tetrahedron is chosen with compares instead of the
+// table: the second vertex steps along the axis of the largest weight and
+// the third is the far corner less a step along the axis of the smallest.
+// Ties between weights cannot change the result, because the vertex whose
+// choice they decide gets weight 0. The vertex channels are paired the same
+// way as in the SSE2 variant, one pmaddwd per pair of vertices.
+__attribute__((target("avx2")))
+static inline __m256i channel_pair(__m256i low, __m256i high) {
+    return _mm256_blend_epi16(low, _mm256_slli_epi32(high, 16), 0xAA);
+}
+
+__attribute__((target("avx2")))
+static void color_lut_avx2(const uint8_t* table, const LutAxes& axes, uint8_t* rgb, size_t n) {
+    // The three result bytes of each 32-bit lane back together, per 128-bit lane
+    const __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                          0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m256i weight_mask = _mm256_set1_epi32(static_cast<int>(AXIS_WEIGHT_MASK));
+    const __m256i low_bytes = _mm256_set1_epi32(0x00FF00FF);
+    const __m256i full = _mm256_set1_epi32(256);
+    const __m256i round = _mm256_set1_epi32(128);
+    const __m256i step0 = _mm256_set1_epi32(static_cast<int>(axes.step[0]));
+    const __m256i step1 = _mm256_set1_epi32(static_cast<int>(axes.step[1]));
+    const __m256i step2 = _mm256_set1_epi32(static_cast<int>(axes.step[2]));
+    const __m256i diagonal = _mm256_set1_epi32(static_cast<int>(axes.step[0] + axes.step[1] + axes.step[2]));
+    const int* vertices = reinterpret_cast<const int*>(table);
+    size_t i = 0;
+    // The loads read four bytes past the eighth pixel
+    for (; i + 10 <= n; i += 8, rgb += 24) {
+        __m256i e0 = _mm256_i32gather_epi32(reinterpret_cast<const int*>(axes.entry[0]), load_channel_avx2(rgb, 0), 4);
+        __m256i e1 = _mm256_i32gather_epi32(reinterpret_cast<const int*>(axes.entry[1]), load_channel_avx2(rgb, 1), 4);
+        __m256i e2 = _mm256_i32gather_epi32(reinterpret_cast<const int*>(axes.entry[2]), load_channel_avx2(rgb, 2), 4);
+        __m256i f0 = _mm256_and_si256(e0, weight_mask);
+        __m256i f1 = _mm256_and_si256(e1, weight_mask);
+        __m256i f2 = _mm256_and_si256(e2, weight_mask);
+        __m256i wa = _mm256_max_epi32(_mm256_max_epi32(f0, f1), f2);
+        __m256i wc = _mm256_min_epi32(_mm256_min_epi32(f0, f1), f2);
+        __m256i wb = _mm256_sub_epi32(_mm256_add_epi32(_mm256_add_epi32(f0, f1), f2), _mm256_add_epi32(wa, wc));
+
+        __m256i largest = _mm256_blendv_epi8(
+            step0, _mm256_blendv_epi8(step1, step2, _mm256_cmpgt_epi32(f2, f1)),
+            _mm256_or_si256(_mm256_cmpgt_epi32(f1, f0), _mm256_cmpgt_epi32(f2, f0)));
+        __m256i smallest = _mm256_blendv_epi8(
+            step0, _mm256_blendv_epi8(step1, step2, _mm256_cmpgt_epi32(f1, f2)),
+            _mm256_or_si256(_mm256_cmpgt_epi32(f0, f1), _mm256_cmpgt_epi32(f0, f2)));
+        __m256i o0 = _mm256_add_epi32(_mm256_add_epi32(_mm256_srli_epi32(e0, AXIS_WEIGHT_BITS),
+                                                       _mm256_srli_epi32(e1, AXIS_WEIGHT_BITS)),
+                                      _mm256_srli_epi32(e2, AXIS_WEIGHT_BITS));
+        __m256i o3 = _mm256_add_epi32(o0, diagonal);
+        __m256i p0 = _mm256_i32gather_epi32(vertices, o0, 1);
+        __m256i p1 = _mm256_i32gather_epi32(vertices, _mm256_add_epi32(o0, largest), 1);
+        __m256i p2 = _mm256_i32gather_epi32(vertices, _mm256_sub_epi32(o3, smallest), 1);
+        __m256i p3 = _mm256_i32gather_epi32(vertices, o3, 1);
+
+        // (p0, p1) and (p2, p3) per channel in 16-bit pairs, against weight pairs
+        __m256i w01 = channel_pair(_mm256_sub_epi32(full, wa), _mm256_sub_epi32(wa, wb));
+        __m256i w23 = channel_pair(_mm256_sub_epi32(wb, wc), wc);
+        __m256i rb0 = _mm256_and_si256(p0, low_bytes), rb1 = _mm256_and_si256(p1, low_bytes);
+        __m256i rb2 = _mm256_and_si256(p2, low_bytes), rb3 = _mm256_and_si256(p3, low_bytes);
+        __m256i r = _mm256_add_epi32(_mm256_madd_epi16(channel_pair(rb0, rb1), w01),
+                                     _mm256_madd_epi16(channel_pair(rb2, rb3), w23));
+        __m256i g = _mm256_add_epi32(_mm256_madd_epi16(channel_pair(_mm256_srli_epi16(p0, 8), _mm256_srli_epi16(p1, 8)), w01),
+                                     _mm256_madd_epi16(channel_pair(_mm256_srli_epi16(p2, 8), _mm256_srli_epi16(p3, 8)), w23));
+        __m256i b = _mm256_add_epi32(_mm256_madd_epi16(channel_pair(_mm256_srli_epi32(rb0, 16), _mm256_srli_epi32(rb1, 16)), w01),
+                                     _mm256_madd_epi16(channel_pair(_mm256_srli_epi32(rb2, 16), _mm256_srli_epi32(rb3, 16)), w23));
+        r = _mm256_srli_epi32(_mm256_add_epi32(r, round), 8);
+        g = _mm256_srli_epi32(_mm256_add_epi32(g, round), 8);
+        b = _mm256_srli_epi32(_mm256_add_epi32(b, round), 8);
+        __m256i out = _mm256_shuffle_epi8(
+            _mm256_or_si256(r, _mm256_or_si256(_mm256_slli_epi32(g, 8), _mm256_slli_epi32(b, 16))), pack);
+        // The first store's four spare bytes are overwritten by the second
+        __m128i high = _mm256_extracti128_si256(out, 1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rgb), _mm256_castsi256_si128(out));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(rgb + 12), high);
+        uint32_t last = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(high, 8)));
+        std::memcpy(rgb + 20, &last, 4);
+    }
+    _mm256_zeroupper();
+    color_lut_sse2(table, axes, rgb, n - i);
+}
+
+#endif // SUPERCAMERA_X86
+
+static const EnhanceKernels& enhance_kernels() {
+    static const KernelVariant<EnhanceKernels> variants[] = {
+        {CpuLevel::Scalar, {blend_scalar, gain_scalar, luma_scalar, quads_scalar, curves_scalar, color_lut_scalar}},
+#if defined(SUPERCAMERA_X86)
+        {CpuLevel::SSE2, {blend_sse2, gain_sse2, luma_scalar, quads_scalar, curves_scalar, color_lut_sse2}},
+        {CpuLevel::AVX2, {blend_avx2, gain_avx2, luma_avx2, quads_avx2, curves_avx2, color_lut_avx2}},
+#endif
+    };
+    static const EnhanceKernels bound = select_kernels(variants);
+    return bound;
+}
+
+// --- Tables ---
+
+// 65536 / v, rounded, for turning the equalized luma into a gain (v = 0 as 1)
+struct Reciprocals {
+    uint32_t value[256];
+    Reciprocals() {
+        for (uint32_t v = 0; v < 256; ++v) {
+            uint32_t d = std::max(v, 1u);
+            value[v] = (65536 + d / 2) / d;
+        }
+    }
+};
+
+static const uint32_t* reciprocals() {
+    static const Reciprocals table;
+    return table.value;
+}
+
+// Counts p[0], p[step], ... p[(n - 1) * step] into four partial histograms,
+// so that runs of one value do not serialize on a single counter
+static void count_values(const uint8_t* p, size_t step, size_t n, uint32_t (*hist)[256]) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4, p += 4 * step) {
+        ++hist[0][p[0]];
+        ++hist[1][p[step]];
+        ++hist[2][p[2 * step]];
+        ++hist[3][p[3 * step]];
+    }
+    for (; i < n; ++i, p += step) {
+        ++hist[0][*p];
+    }
+}
+
+// Clips the histogram at clip_limit times the mean bin, spreads the excess
+// evenly over all bins and turns the cumulative counts into a 0..255 mapping
+static void build_tile_lut(uint32_t* hist, uint32_t total, double clip_limit, uint8_t* lut) {
+    if (clip_limit > 0) {
+        uint32_t clip = std::max(1u, static_cast<uint32_t>(clip_limit * total / 256));
+        uint32_t excess = 0;
+        for (int v = 0; v < 256; ++v) {
+            if (hist[v] > clip) {
+                excess += hist[v] - clip;
+                hist[v] = clip;
+            }
+        }
+        uint32_t each = excess / 256, rest = excess % 256;
+        for (int v = 0; v < 256; ++v) {
+            hist[v] += each;
+        }
+        if (rest > 0) {
+            uint32_t step = std::max(1u, 256 / rest);
+            for (uint32_t v = 0; v < 256 && rest > 0; v += step, --rest) {
+                ++hist[v];
+            }
+        }
+    }
+    uint64_t sum = 0;
+    for (int v = 0; v < 256; ++v) {
+        sum += hist[v];
+        lut[v] = static_cast<uint8_t>(std::min<uint64_t>(255, (sum * 255 + total / 2) / total));
+    }
+}
+
+// Tiles split [0, size) evenly; between the centres of neighbouring tiles a
+// pixel blends their mappings linearly, outside the outermost centres it
+// uses the nearest tile alone (weight 0)
+static void build_axis(int size, int tiles, std::vector<int>& start, std::vector<uint16_t>& first,
+                       std::vector<uint16_t>& weight) {
+    start.resize(tiles + 1);
+    for (int t = 0; t <= tiles; ++t) {
+        start[t] = static_cast<int>(static_cast<int64_t>(size) * t / tiles);
+    }
+    first.resize(size);
+    weight.resize(size);
+    int t = 0;
+    for (int p = 0; p < size; ++p) {
+        while (t + 1 < tiles && p >= (start[t + 1] + start[t + 2] - 1) / 2.0) {
+            ++t;
+        }
+        double c0 = (start[t] + start[t + 1] - 1) / 2.0;
+        first[p] = static_cast<uint16_t>(t);
+        if (p <= c0 || t + 1 == tiles) {
+            weight[p] = 0;
+        } else {
+            double c1 = (start[t + 1] + start[t + 2] - 1) / 2.0;
+            weight[p] = static_cast<uint16_t>(std::lround((p - c0) / (c1 - c0) * WEIGHT_ONE));
+        }
+    }
+}
+
+// --- Enhancer ---
+
+Enhancer::Enhancer(const EnhanceConfig& config)
+    : config_(config), width_(0), height_(0), channels_(0), has_curves_(false), lut_size_(0),
+      pool_(std::max(1u, config.threads)) {
+    config_.tiles_x = std::max(1, config_.tiles_x);
+    config_.tiles_y = std::max(1, config_.tiles_y);
+    clear_curves();
+}
+
+bool Enhancer::set_curve(int channel, const uint8_t curve[256]) {
+    if (channel < 0 || channel > 2) {
+        return false;
+    }
+    std::copy(curve, curve + 256, curves_[channel]);
+    has_curves_ = true;
+    compose_color_lut();
+    return true;
+}
+
+void Enhancer::clear_curves() {
+    for (int c = 0; c < 3; ++c) {
+        for (int v = 0; v < 256; ++v) {
+            curves_[c][v] = static_cast<uint32_t>(v);
+        }
+    }
+    has_curves_ = false;
+    compose_color_lut();
+}
+
+bool Enhancer::set_color_lut(int size, const std::vector<uint8_t>& table) {
+    if (size < 2 || size > 65 || table.size() != static_cast<size_t>(size) * size * size * 3) {
+        return false;
+    }
+    // Padded to 4 bytes per entry for single loads in the SIMD kernel
+    color_lut_.assign(table.size() / 3 * 4, 0);
+    for (size_t i = 0, j = 0; i < table.size(); i += 3, j += 4) {
+        std::memcpy(&color_lut_[j], &table[i], 3);
+    }
+    lut_size_ = size;
+    compose_color_lut();
+    return true;
+}
+
+void Enhancer::clear_color_lut() {
+    color_lut_.clear();
+    lut_size_ = 0;
+}
+
+void Enhancer::compose_color_lut() {
+    if (lut_size_ == 0) {
+        return;
+    }
+    uint32_t stride = 4;
+    for (int c = 0; c < 3; ++c, stride *= lut_size_) {
+        for (int v = 0; v < 256; ++v) {
+            int pos = (static_cast<int>(curves_[c][v]) * (lut_size_ - 1) * 256 + 127) / 255;
+            int index = pos >> 8, weight = pos & 255;
+            if (index >= lut_size_ - 1) {
+                index = lut_size_ - 2;
+                weight = 256;
+            }
+            lut_axis_[c][v] = static_cast<uint32_t>(index) * stride << AXIS_WEIGHT_BITS | static_cast<uint32_t>(weight);
+        }
+    }
+}
+
+void Enhancer::prepare(int width, int height, int channels) {
+    width_ = width;
+    height_ = height;
+    channels_ = channels;
+    build_axis(width, std::min(config_.tiles_x, width), cols_.start, cols_.first, cols_.weight);
+    build_axis(height, std::min(config_.tiles_y, height), rows_.start, rows_.first, rows_.weight);
+    col_weights_.resize(width);
+    for (int x = 0; x < width; ++x) {
+        col_weights_[x] = (static_cast<uint32_t>(cols_.weight[x]) << 16) | (WEIGHT_ONE - cols_.weight[x]);
+    }
+    bool rgb = channels == 3 && config_.color_space == EnhanceConfig::RGB;
+    luma_.resize(rgb ? static_cast<size_t>(width) * height : 0);
+    size_t tiles = (cols_.start.size() - 1) * (rows_.start.size() - 1);
+    tile_lut_.resize(tiles * 256);
+    tile_quads_.resize(tiles * 256 * 4);
+    scratch_.resize(static_cast<size_t>(pool_.threads()) * width * 5);
+}
+
+bool Enhancer::apply(Image& image) {
+    if ((image.channels != 1 && image.channels != 3) || image.width <= 0 || image.height <= 0 ||
+        image.pixels.size() < static_cast<size_t>(image.width) * image.height * image.channels) {
+        return false;
+    }
+    bool color_lut = lut_size_ > 0 && image.channels == 3;
+    if (!config_.clahe && !has_curves_ && !color_lut) {
+        return true;
+    }
+    if (image.width != width_ || image.height != height_ || image.channels != channels_) {
+        prepare(image.width, image.height, image.channels);
+    }
+
+    if (config_.clahe) {
+        int tiles_y = static_cast<int>(rows_.start.size()) - 1;
+        pool_.run(std::min<unsigned>(pool_.threads(), tiles_y), [&](unsigned band, unsigned bands) {
+            equalize_tiles(image, tiles_y * band / bands, tiles_y * (band + 1) / bands);
+        });
+        build_quads();
+    }
+    pool_.run(pool_.threads(), [&](unsigned band, unsigned bands) {
+        enhance_rows(image, height_ * band / bands, height_ * (band + 1) / bands,
+                     &scratch_[static_cast<size_t>(band) * width_ * 5]);
+    });
+    return true;
+}
+
+void Enhancer::equalize_tiles(const Image& image, int ty0, int ty1) {
+    const EnhanceKernels& k = enhance_kernels();
+    int tiles_x = static_cast<int>(cols_.start.size()) - 1;
+    bool rgb = !luma_.empty();
+    int channels = channels_;
+    uint32_t hist[4][256];
+
+    for (int ty = ty0; ty < ty1; ++ty) {
+        int y0 = rows_.start[ty], y1 = rows_.start[ty + 1];
+        for (int tx = 0; tx < tiles_x; ++tx) {
+            int x0 = cols_.start[tx], x1 = cols_.start[tx + 1];
+            std::memset(hist, 0, sizeof(hist));
+            for (int y = y0; y < y1; ++y) {
+                const uint8_t* p = &image.pixels[(static_cast<size_t>(y) * width_ + x0) * channels];
+                if (rgb) {
+                    // Luma is kept for the gain in enhance_rows()
+                    uint8_t* luma = &luma_[static_cast<size_t>(y) * width_ + x0];
+                    k.luma(p, luma, x1 - x0);
+                    count_values(luma, 1, x1 - x0, hist);
+                } else {
+                    count_values(p, channels, x1 - x0, hist);
+                }
+            }
+            for (int v = 0; v < 256; ++v) {
+                hist[0][v] += hist[1][v] + hist[2][v] + hist[3][v];
+            }
+            build_tile_lut(hist[0], static_cast<uint32_t>((x1 - x0) * (y1 - y0)), config_.clip_limit,
+                           &tile_lut_[(static_cast<size_t>(ty) * tiles_x + tx) * 256]);
+        }
+    }
+}
+
+// Interleaves each tile's mapping with those of its right, lower and lower
+// right neighbours (itself past the last column or row, where the weight
+// is 0), so one load fetches everything a pixel blends
+void Enhancer::build_quads() {
+    int tiles_x = static_cast<int>(cols_.start.size()) - 1;
+    int tiles_y = static_cast<int>(rows_.start.size()) - 1;
+    for (int ty = 0; ty < tiles_y; ++ty) {
+        int below = std::min(ty + 1, tiles_y - 1);
+        for (int tx = 0; tx < tiles_x; ++tx) {
+            int right = std::min(tx + 1, tiles_x - 1);
+            const uint8_t* a = &tile_lut_[(static_cast<size_t>(ty) * tiles_x + tx) * 256];
+            const uint8_t* b = &tile_lut_[(static_cast<size_t>(ty) * tiles_x + right) * 256];
+            const uint8_t* c = &tile_lut_[(static_cast<size_t>(below) * tiles_x + tx) * 256];
+            const uint8_t* d = &tile_lut_[(static_cast<size_t>(below) * tiles_x + right) * 256];
+            uint8_t* q = &tile_quads_[(static_cast<size_t>(ty) * tiles_x + tx) * 256 * 4];
+            for (int v = 0; v < 256; ++v, q += 4) {
+                q[0] = a[v];
+                q[1] = b[v];
+                q[2] = c[v];
+                q[3] = d[v];
+            }
+        }
+    }
+}
+
+void Enhancer::enhance_rows(Image& image, int y0, int y1, uint8_t* scratch) {
+    const EnhanceKernels& k = enhance_kernels();
+    int tiles_x = static_cast<int>(cols_.start.size()) - 1;
+    int channels = channels_;
+    bool rgb = !luma_.empty();
+    bool color_lut = lut_size_ > 0 && channels == 3;
+    const uint32_t* recip = reciprocals();
+    uint8_t* quads = scratch;
+    uint8_t* mapped = quads + static_cast<size_t>(width_) * 4;
+
+    for (int y = y0; y < y1; ++y) {
+        uint8_t* row = &image.pixels[static_cast<size_t>(y) * width_ * channels];
+
+        if (config_.clahe) {
+            const uint8_t* table = &tile_quads_[static_cast<size_t>(rows_.first[y]) * tiles_x * 256 * 4];
+            const uint8_t* luma = rgb ? &luma_[static_cast<size_t>(y) * width_] : row;
+            k.quads(table, cols_.first.data(), luma, rgb ? 1 : channels, quads, width_);
+            k.blend(quads, col_weights_.data(), rows_.weight[y], mapped, width_);
+
+            if (rgb) {
+                k.gain(mapped, luma, recip, row, width_);
+            } else {
+                for (int x = 0; x < width_; ++x) {
+                    row[x * channels] = mapped[x];
+                }
+            }
+        }
+
+        if (color_lut) {
+            // Includes the curves
+            LutAxes axes = {lut_axis_, {4, 4 * static_cast<uint32_t>(lut_size_),
+                                        4 * static_cast<uint32_t>(lut_size_ * lut_size_)}};
+            k.color_lut(color_lut_.data(), axes, row, width_);
+        } else if (has_curves_) {
+            k.curves(curves_, channels, row, width_);
+        }
+    }
+}
+
+} // namespace supercamera
@@ -0,0 +1,345 @@
+#include "supercamera/frame_assembler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "supercamera/cpu_dispatch.h"
+#include "supercamera/probes.h"
+
+CAMERA_PROBE_SEMAPHORE(packet_header);
+CAMERA_PROBE_SEMAPHORE(frame_start);
+CAMERA_PROBE_SEMAPHORE(frame_end);
+CAMERA_PROBE_SEMAPHORE(frame_skipped);
+CAMERA_PROBE_SEMAPHORE(frame_damaged);
+
+namespace supercamera {
+
+static const uint8_t PACKET_MAGIC[3] = {0xAA, 0xBB, 0x07};
+static const size_t MAX_SPARE_BUFFERS = 4;
+
+// Index of the first "FF <second>" pair in p[0..n), or n if none. A trailing
+// 0xFF is reported through trailing_ff so the caller can match across chunks.
+static size_t find_marker(const uint8_t* p, size_t n, uint8_t second, bool& trailing_ff) {
+    size_t i = kernels().find_marker(p, n, second);
+    trailing_ff = (i == n && n > 0 && p[n - 1] == 0xFF);
+    return i;
+}
+
+FrameAssembler::FrameAssembler(size_t max_frame_size) : max_frame_size_(max_frame_size), next_frame_id_(0), check_packet_sizes_(false) {
+    spare_.reserve(MAX_SPARE_BUFFERS);
+    reset();
+}
+
+void FrameAssembler::reset() {
+    state_ = SEEK_HEADER;
+    magic_matched_ = 0;
+    header_remaining_ = 0;
+    header_offset_ = 0;
+    packet_payload_ = 0;
+    full_packet_payload_ = 0;
+    last_packet_payload_ = 0;
+    eoi_in_packet_ = false;
+    in_frame_ = false;
+    skipping_ = false;
+    skipped_size_ = 0;
+    prev_ff_ = false;
+    frame_.clear();
+    ready_.clear();
+    stats_ = Stats();
+    soi_count_ = 0;
+    next_due_ = std::chrono::steady_clock::time_point();
+    last_kept_ = std::chrono::steady_clock::time_point();
+    last_kept_size_ = 0;
+}
+
+void FrameAssembler::set_decimation(const Decimation& decimation) {
+    decimation_ = decimation;
+    if (decimation_.every_nth == 0) {
+        decimation_.every_nth = 1;
+    }
+    soi_count_ = 0;
+    next_due_ = std::chrono::steady_clock::time_point();
+}
+
+// Called at SOI: whether the frame starting here should be assembled at all
+bool FrameAssembler::admit_frame() {
+    if (soi_count_++ % decimation_.every_nth != 0) {
+        return false;
+    }
+    if (decimation_.max_fps > 0) {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now < next_due_) {
+            return false;
+        }
+        // Advance by whole intervals so the kept rate converges on max_fps
+        // without drifting, but don't bank credit across a stalled stream
+        std::chrono::steady_clock::duration interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / decimation_.max_fps));
+        next_due_ += interval;
+        if (next_due_ < now) {
+            next_due_ = now + interval;
+        }
+    }
+    return true;
+}
+
+void FrameAssembler::push(const uint8_t* data, size_t length) {
+    uint64_t base = stats_.bytes_in;
+    stats_.bytes_in += length;
+
+    size_t i = 0;
+    while (i < length) {
+        if (state_ == HEADER) {
+            size_t n = std::min(header_remaining_, length - i);
+            header_remaining_ -= n;
+            i += n;
+            if (header_remaining_ == 0) {
+                state_ = PAYLOAD;
+            }
+            continue;
+        }
+
+        if (magic_matched_ > 0) {
+            if (data[i] == PACKET_MAGIC[magic_matched_]) {
+                ++i;
+                if (++magic_matched_ == sizeof(PACKET_MAGIC)) {
+                    begin_header();
+                }
+            } else {
+                // False alarm: the held bytes were payload; re-examine data[i]
+                if (state_ == PAYLOAD) {
+                    on_payload(PACKET_MAGIC, magic_matched_);
+                }
+                magic_matched_ = 0;
+            }
+            continue;
+        }
+
+        size_t end = i + kernels().find_byte(data + i, length - i, PACKET_MAGIC[0]);
+        if (state_ == PAYLOAD && end > i) {
+            on_payload(data + i, end - i);
+        }
+        if (end == length) {
+            break;
+        }
+        header_offset_ = base + end;
+        magic_matched_ = 1;
+        i = end + 1;
+    }
+}
+
+void FrameAssembler::finish() {
+    if (magic_matched_ > 0 && state_ == PAYLOAD) {
+        on_payload(PACKET_MAGIC, magic_matched_);
+    }
+    magic_matched_ = 0;
+}
+
+void FrameAssembler::begin_header() {
+    CAMERA_PROBE2(packet_header, header_offset_, packet_payload_);
+    // Every packet but a frame's last is full. A short one lost bytes, and a
+    // long one swallowed the next header; either way the frame is damaged.
+    if (check_packet_sizes_ && stats_.packets > 0 && !eoi_in_packet_) {
+        if (in_frame_ && full_packet_payload_ > 0 && packet_payload_ != full_packet_payload_) {
+            ++stats_.packet_gaps;
+            drop_damaged_frame();
+        }
+        // The full size is learned once two packets in a row agree
+        if (packet_payload_ == last_packet_payload_) {
+            full_packet_payload_ = packet_payload_;
+        }
+        last_packet_payload_ = packet_payload_;
+    }
+    ++stats_.packets;
+    packet_payload_ = 0;
+    eoi_in_packet_ = false;
+    magic_matched_ = 0;
+    header_remaining_ = PACKET_HEADER_SIZE - sizeof(PACKET_MAGIC);
+    state_ = HEADER;
+}
+
+void FrameAssembler::on_payload(const uint8_t* p, size_t n) {
+    stats_.payload_bytes += n;
+    packet_payload_ += n;
+
+    while (n > 0) {
+        bool trailing_ff;
+        if (!in_frame_) {
+            size_t consumed; // Bytes up to and including the D8 of SOI
+            if (prev_ff_ && p[0] == 0xD8) {
+                consumed = 1;
+            } else {
+                size_t soi = find_marker(p, n, 0xD8, trailing_ff);
+                if (soi == n) {
+                    stats_.discarded_bytes += n;
+                    prev_ff_ = trailing_ff;
+                    return;
+                }
+                stats_.discarded_bytes += soi;
+                consumed = soi + 2;
+            }
+            skipping_ = !admit_frame();
+            if (skipping_) {
+                skipped_size_ = 2;
+            } else {
+                frame_.push_back(0xFF);
+                frame_.push_back(0xD8);
+            }
+            in_frame_ = true;
+            prev_ff_ = false;
+            CAMERA_PROBE2(frame_start, next_frame_id_, stats_.payload_bytes - n + consumed - 2);
+            p += consumed;
+            n -= consumed;
+            continue;
+        }
+
+        size_t take;
+        bool done = false;
+        size_t soi = n; // An SOI before the EOI: the EOI was lost
+        if (prev_ff_ && p[0] == 0xD9) {
+            take = 1;
+            done = true;
+        } else if (prev_ff_ && p[0] == 0xD8) {
+            soi = 0;
+        } else {
+            size_t eoi = find_marker(p, n, 0xD9, trailing_ff);
+            done = (eoi < n);
+            take = done ? eoi + 2 : n;
+            bool unused;
+            size_t limit = done ? eoi : n;
+            soi = find_marker(p, limit, 0xD8, unused);
+            if (soi == limit) {
+                soi = n;
+            }
+        }
+        if (soi < n) {
+            // Drop the frame and start over on the new SOI (whose FF may have
+            // ended the previous chunk)
+            bool split = soi == 0 && prev_ff_;
+            ++stats_.resyncs;
+            if (skipping_) {
+                skipped_size_ += soi;
+            } else {
+                stats_.discarded_bytes += soi;
+            }
+            drop_damaged_frame();
+            prev_ff_ = split;
+            p += soi;
+            n -= soi;
+            continue;
+        }
+        prev_ff_ = !done && p[take - 1] == 0xFF;
+        eoi_in_packet_ = eoi_in_packet_ || done;
+
+        if (skipping_) {
+            skipped_size_ += take;
+            if (done) {
+                skip_frame(skipped_size_);
+            } else if (skipped_size_ > max_frame_size_) {
+                // Same runaway guard as below; the bytes were never kept
+                ++stats_.oversized_frames;
+                stats_.discarded_bytes += skipped_size_;
+                in_frame_ = false;
+                skipping_ = false;
+                prev_ff_ = false;
+            }
+        } else if (frame_.size() + take > max_frame_size_) {
+            // Runaway frame (lost EOI); drop it and look for the next SOI
+            ++stats_.oversized_frames;
+            stats_.discarded_bytes += frame_.size() + take;
+            frame_.clear();
+            in_frame_ = false;
+            prev_ff_ = false;
+        } else {
+            frame_.insert(frame_.end(), p, p + take);
+            if (done) {
+                complete_frame();
+            }
+        }
+        p += take;
+        n -= take;
+    }
+}
+
+void FrameAssembler::skip_frame(size_t frame_bytes) {
+    (void) frame_bytes; // Only reported to the probe
+    CAMERA_PROBE2(frame_skipped, next_frame_id_, frame_bytes);
+    ++next_frame_id_;
+    in_frame_ = false;
+    skipping_ = false;
+    prev_ff_ = false;
+    ++stats_.skipped_frames;
+}
+
+void FrameAssembler::drop_damaged_frame() {
+    if (skipping_) {
+        // Never going to be kept anyway
+        skip_frame(skipped_size_);
+        return;
+    }
+    CAMERA_PROBE2(frame_damaged, next_frame_id_, frame_.size());
+    ++stats_.damaged_frames;
+    stats_.discarded_bytes += frame_.size();
+    ++next_frame_id_;
+    frame_.clear();
+    in_frame_ = false;
+    prev_ff_ = false;
+}
+
+void FrameAssembler::complete_frame() {
+    if (decimation_.change_threshold > 0 && last_kept_size_ > 0) {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        double change = std::fabs(double(frame_.size()) - double(last_kept_size_)) / double(last_kept_size_);
+        bool heartbeat = decimation_.max_unchanged_ms > 0 &&
+                         now - last_kept_ >= std::chrono::milliseconds(decimation_.max_unchanged_ms);
+        if (change <= decimation_.change_threshold && !heartbeat) {
+            size_t size = frame_.size();
+            frame_.clear();
+            skip_frame(size);
+            return;
+        }
+    }
+    if (decimation_.change_threshold > 0) {
+        last_kept_size_ = frame_.size();
+        last_kept_ = std::chrono::steady_clock::now();
+    }
+
+    CAMERA_PROBE2(frame_end, next_frame_id_, frame_.size());
+    ready_.push_back(AssembledFrame());
+    AssembledFrame& frame = ready_.back();
+    frame.id = next_frame_id_++;
+    frame.data.swap(frame_);
+    if (!spare_.empty()) {
+        frame_.swap(spare_.back());
+        spare_.pop_back();
+    }
+    frame_.clear();
+    in_frame_ = false;
+    prev_ff_ = false;
+    ++stats_.frames;
+}
+
+bool FrameAssembler::pop_frame(AssembledFrame& frame) {
+    if (ready_.empty()) {
+        return false;
+    }
+    frame.id = ready_.front().id;
+    frame.data.swap(ready_.front().data);
+    std::vector<uint8_t>& returned = ready_.front().data;
+    if (returned.capacity() > 0 && spare_.size() < MAX_SPARE_BUFFERS) {
+        spare_.push_back(std::vector<uint8_t>());
+        spare_.back().swap(returned);
+    }
+    ready_.pop_front();
+    return true;
+}
+
+// Replace all occurrences of FF 24 with FF 00 to handle non-standard marker within scan data
+// This is kept as a precaution, as FF 24 might still appear within the actual JPEG data
+void unstuff_jpeg(std::vector<uint8_t>& clean_jpeg_data) {
+    if (!clean_jpeg_data.empty()) {
+        kernels().unstuff(clean_jpeg_data.data(), clean_jpeg_data.size());
+    }
+}
+
+} // namespace supercamera
@@ -0,0 +1,61 @@
+#include "supercamera/frame_source.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace supercamera {
+
+bool take_frame(FrameAssembler& assembler, Frame& frame) {
+    // The frame's old buffer goes back to the assembler for reuse
+    AssembledFrame assembled;
+    assembled.data.swap(frame.jpeg);
+    if (!assembler.pop_frame(assembled)) {
+        frame.jpeg.swap(assembled.data);
+        return false;
+    }
+    frame.id = assembled.id;
+    frame.timestamp = std::chrono::steady_clock::now();
+    frame.jpeg.swap(assembled.data);
+    unstuff_jpeg(frame.jpeg);
+    return true;
+}
+
+RawFileSource::RawFileSource(const std::string& path, size_t chunk_size)
+    : path_(path), chunk_size_(chunk_size), pos_(0), finished_(false) {
+}
+
+bool RawFileSource::open() {
+    std::ifstream raw_file(path_, std::ios::binary);
+    if (!raw_file.is_open()) {
+        std::cerr << "Could not open raw data file: " << path_ << std::endl;
+        return false;
+    }
+
+    // Read the entire raw file into memory
+    data_.assign((std::istreambuf_iterator<char>(raw_file)), std::istreambuf_iterator<char>());
+    pos_ = 0;
+    finished_ = false;
+    assembler_.reset();
+    return true;
+}
+
+bool RawFileSource::next_frame(Frame& frame) {
+    while (!take_frame(assembler_, frame)) {
+        if (pos_ >= data_.size()) {
+            if (finished_) {
+                return false;
+            }
+            assembler_.finish();
+            finished_ = true;
+            continue;
+        }
+        size_t n = std::min(chunk_size_, data_.size() - pos_);
+        assembler_.push(&data_[pos_], n);
+        pos_ += n;
+    }
+    return true;
+}
+
+} // namespace supercamera
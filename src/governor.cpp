@@ -0,0 +1,99 @@
+#include "supercamera/governor.h"
+
+#include <algorithm>
+
+#include "supercamera/log.h"
+
+namespace supercamera {
+
+static const double EWMA_ALPHA = 0.1;
+static const unsigned MAX_RESTORE_BACKOFF = 16; // restore_wait never exceeds restore_frames * this
+
+static const QualityLevel LEVELS[] = {
+    {"full",      1, DecodeOptions::Quality, 1},
+    {"full-fast", 1, DecodeOptions::Fast,    1},
+    {"half",      2, DecodeOptions::Fast,    2},
+    {"quarter",   4, DecodeOptions::Fast,    4},
+};
+static const size_t NUM_LEVELS = sizeof(LEVELS) / sizeof(LEVELS[0]);
+
+size_t QualityGovernor::level_count() {
+    return NUM_LEVELS;
+}
+
+const QualityLevel& QualityGovernor::level_at(size_t index) {
+    return LEVELS[std::min(index, NUM_LEVELS - 1)];
+}
+
+QualityGovernor::QualityGovernor(const GovernorConfig& config)
+    : config_(config),
+      level_(0),
+      ewma_ms_(0),
+      ewma_valid_(false),
+      frames_at_level_(0),
+      low_load_frames_(0),
+      restore_wait_(config.restore_frames),
+      just_restored_(false),
+      analysis_counter_(0) {
+}
+
+const QualityLevel& QualityGovernor::level() const {
+    return LEVELS[level_];
+}
+
+bool QualityGovernor::analysis_due() {
+    return analysis_counter_++ % LEVELS[level_].analysis_interval == 0;
+}
+
+bool QualityGovernor::observe(uint64_t frame_id, double latency_ms, size_t queue_depth) {
+    // The average restarts at every change so it only reflects the current level
+    ewma_ms_ = ewma_valid_ ? ewma_ms_ + EWMA_ALPHA * (latency_ms - ewma_ms_) : latency_ms;
+    ewma_valid_ = true;
+    ++frames_at_level_;
+
+    if (frames_at_level_ < config_.hold_frames) {
+        return false;
+    }
+
+    bool overloaded = queue_depth >= config_.queue_high || ewma_ms_ > config_.degrade_load * config_.frame_budget_ms;
+    if (overloaded) {
+        low_load_frames_ = 0;
+        if (level_ + 1 < NUM_LEVELS) {
+            if (just_restored_) {
+                restore_wait_ = std::min(restore_wait_ * 2, config_.restore_frames * MAX_RESTORE_BACKOFF);
+                just_restored_ = false;
+            }
+            change_level(level_ + 1, frame_id, queue_depth);
+            return true;
+        }
+        return false;
+    }
+
+    // A level that held through a full restore period has proven sustainable
+    if (just_restored_ && frames_at_level_ >= config_.restore_frames) {
+        just_restored_ = false;
+        restore_wait_ = config_.restore_frames;
+    }
+
+    bool low = queue_depth == 0 && ewma_ms_ < config_.restore_load * config_.frame_budget_ms;
+    low_load_frames_ = low ? low_load_frames_ + 1 : 0;
+    if (level_ > 0 && low_load_frames_ >= restore_wait_) {
+        change_level(level_ - 1, frame_id, queue_depth);
+        just_restored_ = true;
+        return true;
+    }
+    return false;
+}
+
+void QualityGovernor::change_level(size_t level, uint64_t frame_id, size_t queue_depth) {
+    log::write(log::Level::Info, "governor", frame_id, static_cast<int>(level),
+               "%s %s -> %s: latency %.1f ms of %.1f ms budget, queue %zu, next restore after %u frames",
+               level > level_ ? "Degrading" : "Restoring", LEVELS[level_].name, LEVELS[level].name, ewma_ms_,
+               config_.frame_budget_ms, queue_depth, restore_wait_);
+    level_ = level;
+    ewma_valid_ = false;
+    frames_at_level_ = 0;
+    low_load_frames_ = 0;
+}
+
+} // namespace supercamera
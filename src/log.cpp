@@ -0,0 +1,267 @@
+#include "supercamera/log.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstring>
+#include <thread>
+
+namespace supercamera {
+namespace log {
+
+static const size_t RING_SIZE       = 1024;  // Records, power of two
+static const size_t TEXT_SIZE       = 200;
+static const size_t RATE_SLOTS      = 64;    // Distinct message types tracked
+static const unsigned DEFAULT_RATE  = 20;
+static const int IDLE_SLEEP_MS      = 5;
+
+struct Record {
+    Level level;
+    const char* type;
+    uint64_t frame_id;
+    int code;
+    char text[TEXT_SIZE];
+};
+
+// Bounded multi-producer ring after Dmitry Vyukov's MPMC queue; each cell's
+// sequence number tells producers and the consumer whose turn it is.
+struct Cell {
+    std::atomic<size_t> seq;
+    Record record;
+};
+
+struct RateSlot {
+    std::atomic<const char*> type;
+    std::atomic<int64_t> window;
+    std::atomic<unsigned> count;
+    std::atomic<unsigned> suppressed;
+};
+
+class Logger {
+public:
+    Logger()
+        : enqueue_pos_(0), dequeue_pos_(0), dropped_(0), rate_(DEFAULT_RATE), min_level_(Level::Debug), out_(stderr),
+          stop_(false) {
+        for (size_t i = 0; i < RING_SIZE; ++i) {
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < RATE_SLOTS; ++i) {
+            rate_slots_[i].type.store(nullptr, std::memory_order_relaxed);
+            rate_slots_[i].window.store(0, std::memory_order_relaxed);
+            rate_slots_[i].count.store(0, std::memory_order_relaxed);
+            rate_slots_[i].suppressed.store(0, std::memory_order_relaxed);
+        }
+        writer_ = std::thread(&Logger::run, this);
+    }
+
+    ~Logger() {
+        stop_.store(true);
+        writer_.join();
+    }
+
+    bool admit(const char* type) {
+        unsigned limit = rate_.load(std::memory_order_relaxed);
+        if (limit == 0) {
+            return true;
+        }
+        RateSlot* slot = find_slot(type);
+        if (!slot) {
+            return true;
+        }
+        roll_window(*slot, current_second());
+        if (slot->count.fetch_add(1, std::memory_order_relaxed) < limit) {
+            return true;
+        }
+        slot->suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    void push(const Record& record) {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells_[pos & (RING_SIZE - 1)];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->record = record;
+        cell->seq.store(pos + 1, std::memory_order_release);
+    }
+
+    void flush() {
+        size_t target = enqueue_pos_.load(std::memory_order_acquire);
+        while (dequeue_pos_.load(std::memory_order_acquire) < target) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::fflush(out_.load());
+    }
+
+    std::atomic<uint64_t>& dropped() { return dropped_; }
+    std::atomic<unsigned>& rate() { return rate_; }
+    std::atomic<Level>& min_level() { return min_level_; }
+    std::atomic<std::FILE*>& out() { return out_; }
+
+private:
+    static int64_t current_second() {
+        return std::chrono::duration_cast<std::chrono::seconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Starts a new window if `now` is past the slot's, reporting what the old
+    // one suppressed. Producers and the writer thread race for it; whoever
+    // moves the window reports.
+    void roll_window(RateSlot& slot, int64_t now) {
+        int64_t window = slot.window.load(std::memory_order_relaxed);
+        if (window == now || !slot.window.compare_exchange_strong(window, now)) {
+            return;
+        }
+        slot.count.store(0, std::memory_order_relaxed);
+        unsigned suppressed = slot.suppressed.exchange(0);
+        if (suppressed > 0) {
+            Record summary;
+            summary.level = Level::Warning;
+            summary.type = slot.type.load(std::memory_order_relaxed);
+            summary.frame_id = NO_FRAME;
+            summary.code = 0;
+            std::snprintf(summary.text, TEXT_SIZE, "%u similar messages suppressed", suppressed);
+            push(summary);
+        }
+    }
+
+    // Reports suppressions for types that went quiet, which no producer
+    // would otherwise get round to
+    void sweep_windows() {
+        int64_t now = current_second();
+        for (size_t i = 0; i < RATE_SLOTS; ++i) {
+            RateSlot& slot = rate_slots_[i];
+            if (slot.suppressed.load(std::memory_order_relaxed) > 0) {
+                roll_window(slot, now);
+            }
+        }
+    }
+
+    RateSlot* find_slot(const char* type) {
+        size_t start = (reinterpret_cast<uintptr_t>(type) >> 3) % RATE_SLOTS;
+        for (size_t i = 0; i < RATE_SLOTS; ++i) {
+            RateSlot& slot = rate_slots_[(start + i) % RATE_SLOTS];
+            const char* current = slot.type.load(std::memory_order_acquire);
+            if (current == type) {
+                return &slot;
+            }
+            if (current == nullptr) {
+                const char* expected = nullptr;
+                if (slot.type.compare_exchange_strong(expected, type) || expected == type) {
+                    return &slot;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    bool pop(Record& record) {
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        Cell& cell = cells_[pos & (RING_SIZE - 1)];
+        if (cell.seq.load(std::memory_order_acquire) != pos + 1) {
+            return false;
+        }
+        record = cell.record;
+        cell.seq.store(pos + RING_SIZE, std::memory_order_release);
+        dequeue_pos_.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    void run() {
+        static const char* level_names[] = {"Debug", "Info", "Warning", "Error"};
+        Record record;
+        while (true) {
+            sweep_windows();
+            bool wrote = false;
+            std::FILE* out = out_.load();
+            while (pop(record)) {
+                std::fprintf(out, "%s [%s]", level_names[static_cast<int>(record.level)], record.type);
+                if (record.frame_id != NO_FRAME) {
+                    std::fprintf(out, " frame=%llu", static_cast<unsigned long long>(record.frame_id));
+                }
+                if (record.code != 0) {
+                    std::fprintf(out, " code=%d", record.code);
+                }
+                std::fprintf(out, ": %s\n", record.text);
+                wrote = true;
+            }
+            if (wrote) {
+                std::fflush(out);
+            } else if (stop_.load()) {
+                return;
+            } else {
+                std::this_thread::sleep_for(std::chrono::milliseconds(IDLE_SLEEP_MS));
+            }
+        }
+    }
+
+    Cell cells_[RING_SIZE];
+    RateSlot rate_slots_[RATE_SLOTS];
+    std::atomic<size_t> enqueue_pos_;
+    std::atomic<size_t> dequeue_pos_;
+    std::atomic<uint64_t> dropped_;
+    std::atomic<unsigned> rate_;
+    std::atomic<Level> min_level_;
+    std::atomic<std::FILE*> out_;
+    std::atomic<bool> stop_;
+    std::thread writer_;
+};
+
+static Logger& logger() {
+    static Logger instance;
+    return instance;
+}
+
+void write(Level level, const char* type, uint64_t frame_id, int code, const char* format, ...) {
+    Logger& l = logger();
+    if (level < l.min_level().load(std::memory_order_relaxed) || !l.admit(type)) {
+        return;
+    }
+    Record record;
+    record.level = level;
+    record.type = type;
+    record.frame_id = frame_id;
+    record.code = code;
+    va_list args;
+    va_start(args, format);
+    std::vsnprintf(record.text, TEXT_SIZE, format, args);
+    va_end(args);
+    l.push(record);
+}
+
+void set_rate_limit(unsigned per_second) {
+    logger().rate().store(per_second);
+}
+
+void set_min_level(Level level) {
+    logger().min_level().store(level);
+}
+
+void set_output(std::FILE* out) {
+    logger().flush();
+    logger().out().store(out ? out : stderr);
+}
+
+void flush() {
+    logger().flush();
+}
+
+uint64_t dropped() {
+    return logger().dropped().load();
+}
+
+} // namespace log
+} // namespace supercamera
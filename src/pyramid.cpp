@@ -0,0 +1,192 @@
+#include "supercamera/pyramid.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "simd.h"
+
+namespace supercamera {
+
+// --- Kernels ---
+// Each output sample is the rounded mean of its 2x2 source samples,
+//   out = (tl + tr + bl + br + 2) >> 2
+// computed exactly in 16-bit lanes, so all levels produce identical bytes.
+
+struct PyramidKernels {
+    // `width` output pixels from two source rows of 2 * width pixels
+    void (*halve_gray)(const uint8_t* top, const uint8_t* bottom, int width, uint8_t* out);
+    void (*halve_rgb)(const uint8_t* top, const uint8_t* bottom, int width, uint8_t* out);
+};
+
+static void halve_scalar(const uint8_t* top, const uint8_t* bottom, int width, int channels, uint8_t* out) {
+    for (int x = 0; x < width; ++x, top += 2 * channels, bottom += 2 * channels) {
+        for (int c = 0; c < channels; ++c) {
+            *out++ = static_cast<uint8_t>((top[c] + top[channels + c] + bottom[c] + bottom[channels + c] + 2) >> 2);
+        }
+    }
+}
+
+static void halve_gray_scalar(const uint8_t* top, const uint8_t* bottom, int width, uint8_t* out) {
+    halve_scalar(top, bottom, width, 1, out);
+}
+
+static void halve_rgb_scalar(const uint8_t* top, const uint8_t* bottom, int width, uint8_t* out) {
+    halve_scalar(top, bottom, width, 3, out);
+}
+
+#if defined(SUPERCAMERA_X86)
+
+// 16 source bytes of each row -> 8 outputs in 16-bit lanes: even and odd
+// bytes are split by mask and shift, so neighbours add up lane by lane
+__attribute__((target("sse2")))
+static inline __m128i halve8_sse2(const uint8_t* top, const uint8_t* bottom) {
+    const __m128i low = _mm_set1_epi16(0x00FF);
+    __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(top));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom));
+    __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(t, low), _mm_srli_epi16(t, 8)),
+                                _mm_add_epi16(_mm_and_si128(b, low), _mm_srli_epi16(b, 8)));
+    return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+}
+
+__attribute__((target("sse2")))
+static void halve_gray_sse2(const uint8_t* top, const uint8_t* bottom, int width, uint8_t* out) {
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i lo = halve8_sse2(top + 2 * x, bottom + 2 * x);
+        __m128i hi = halve8_sse2(top + 2 * x + 16, bottom + 2 * x + 16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_packus_epi16(lo, hi));
+    }
+    halve_gray_scalar(top + 2 * x, bottom + 2 * x, width - x, out + x);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i halve16_avx2(const uint8_t* top, const uint8_t* bottom) {
+    const __m256i low = _mm256_set1_epi16(0x00FF);
+    __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(top));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bottom));
+    __m256i sum = _mm256_add_epi16(_mm256_add_epi16(_mm256_and_si256(t, low), _mm256_srli_epi16(t, 8)),
+                                   _mm256_add_epi16(_mm256_and_si256(b, low), _mm256_srli_epi16(b, 8)));
+    return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(2)), 2);
+}
+
+__attribute__((target("avx2")))
+static void halve_gray_avx2(const uint8_t* top, const uint8_t* bottom, int width, uint8_t* out) {
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i lo = halve16_avx2(top + 2 * x, bottom + 2 * x);
+        __m256i hi = halve16_avx2(top + 2 * x + 32, bottom + 2 * x + 32);
+        // The pack interleaves 128-bit lanes; put the quarters back in order
+        __m256i packed = _mm256_packus_epi16(lo, hi);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+    _mm256_zeroupper();
+    halve_gray_sse2(top + 2 * x, bottom + 2 * x, width - x, out + x);
+}
+
+// Three-channel pixels need a byte shuffle to pair each sample with its
+// right neighbour, which SSE2 lacks; pshufb comes with the AVX2 level. Per
+// step, 24 source bytes of each row (8 pixels) are split into the left and
+// right pixel of each pair, giving 12 output bytes.
+__attribute__((target("avx2")))
+static inline void split_pairs_rgb(const uint8_t* src, __m128i& left, __m128i& right) {
+    const char z = static_cast<char>(0x80);
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    __m128i b = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + 16));
+    left = _mm_or_si128(_mm_shuffle_epi8(a, _mm_setr_epi8(0, 1, 2, 6, 7, 8, 12, 13, 14, z, z, z, z, z, z, z)),
+                        _mm_shuffle_epi8(b, _mm_setr_epi8(z, z, z, z, z, z, z, z, z, 2, 3, 4, z, z, z, z)));
+    right = _mm_or_si128(_mm_shuffle_epi8(a, _mm_setr_epi8(3, 4, 5, 9, 10, 11, 15, z, z, z, z, z, z, z, z, z)),
+                         _mm_shuffle_epi8(b, _mm_setr_epi8(z, z, z, z, z, z, z, 0, 1, 5, 6, 7, z, z, z, z)));
+}
+
+__attribute__((target("avx2")))
+static void halve_rgb_avx2(const uint8_t* top, const uint8_t* bottom, int width, uint8_t* out) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i tl, tr, bl, br;
+        split_pairs_rgb(top + 6 * x, tl, tr);
+        split_pairs_rgb(bottom + 6 * x, bl, br);
+        __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(tl, zero), _mm_unpacklo_epi8(tr, zero)),
+                                   _mm_add_epi16(_mm_unpacklo_epi8(bl, zero), _mm_unpacklo_epi8(br, zero)));
+        __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(tl, zero), _mm_unpackhi_epi8(tr, zero)),
+                                   _mm_add_epi16(_mm_unpackhi_epi8(bl, zero), _mm_unpackhi_epi8(br, zero)));
+        __m128i v = _mm_packus_epi16(_mm_srli_epi16(_mm_add_epi16(lo, two), 2),
+                                     _mm_srli_epi16(_mm_add_epi16(hi, two), 2));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 3 * x), v);
+        uint32_t last = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(v, 8)));
+        std::memcpy(out + 3 * x + 8, &last, 4);
+    }
+    halve_rgb_scalar(top + 6 * x, bottom + 6 * x, width - x, out + 3 * x);
+}
+
+#endif // SUPERCAMERA_X86
+
+static const PyramidKernels& pyramid_kernels() {
+    static const KernelVariant<PyramidKernels> variants[] = {
+        {CpuLevel::Scalar, {halve_gray_scalar, halve_rgb_scalar}},
+#if defined(SUPERCAMERA_X86)
+        {CpuLevel::SSE2, {halve_gray_sse2, halve_rgb_scalar}},
+        {CpuLevel::AVX2, {halve_gray_avx2, halve_rgb_avx2}},
+#endif
+    };
+    static const PyramidKernels bound = select_kernels(variants);
+    return bound;
+}
+
+// --- Pyramid ---
+
+void Pyramid::layout(int width, int height, int channel_count, int count) {
+    channels = channel_count;
+    levels.clear();
+    size_t offset = 0;
+    while (static_cast<int>(levels.size()) < count && width > 0 && height > 0) {
+        Level level;
+        level.width = width;
+        level.height = height;
+        level.offset = offset;
+        levels.push_back(level);
+        offset += static_cast<size_t>(width) * height * channels;
+        width /= 2;
+        height /= 2;
+    }
+    pixels.resize(offset);
+}
+
+void Pyramid::halve_row(size_t level, int y) {
+    const uint8_t* top = data(level) + 2 * y * stride(level);
+    const uint8_t* bottom = top + stride(level);
+    uint8_t* out = data(level + 1) + y * stride(level + 1);
+    int width = levels[level + 1].width;
+    const PyramidKernels& k = pyramid_kernels();
+    if (channels == 1) {
+        k.halve_gray(top, bottom, width, out);
+    } else if (channels == 3) {
+        k.halve_rgb(top, bottom, width, out);
+    } else {
+        halve_scalar(top, bottom, width, channels, out);
+    }
+}
+
+void Pyramid::build() {
+    for (size_t level = 0; level + 1 < levels.size(); ++level) {
+        for (int y = 0; y < levels[level + 1].height; ++y) {
+            halve_row(level, y);
+        }
+    }
+}
+
+bool Pyramid::copy_level(size_t level, Image& out) const {
+    if (level >= levels.size()) {
+        return false;
+    }
+    out.width = levels[level].width;
+    out.height = levels[level].height;
+    out.channels = channels;
+    out.pixels.assign(data(level), data(level) + stride(level) * out.height);
+    out.valid_rows = std::min(out.height, valid_rows >> level);
+    out.stats.source = ImageStats::None;
+    return true;
+}
+
+} // namespace supercamera
@@ -0,0 +1,196 @@
+#include "supercamera/sharpness.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+#include <jpeglib.h>
+#include <setjmp.h>
+
+#include "supercamera/cpu_dispatch.h"
+#include "supercamera/decoder.h"
+#include "supercamera/log.h"
+
+namespace supercamera {
+
+double laplacian_variance(const Image& image) {
+    if (image.width < 3 || image.height < 3 || (image.channels != 1 && image.channels != 3)) {
+        return 0.0;
+    }
+    size_t width = static_cast<size_t>(image.width);
+    const Kernels& k = kernels();
+    int64_t sum = 0, sum_sq = 0;
+
+    if (image.channels == 1) {
+        const uint8_t* p = image.pixels.data();
+        for (int y = 1; y + 1 < image.height; ++y) {
+            k.laplacian_row(p + (y - 1) * width, p + y * width, p + (y + 1) * width, width, &sum, &sum_sq);
+        }
+    } else {
+        // Rolling window of three luma rows
+        std::vector<uint8_t> luma(3 * width);
+        for (int y = 0; y < image.height; ++y) {
+            const uint8_t* rgb = &image.pixels[y * width * 3];
+            uint8_t* out = &luma[(y % 3) * width];
+            for (size_t x = 0; x < width; ++x, rgb += 3) {
+                out[x] = static_cast<uint8_t>((rgb[0] * 77 + rgb[1] * 150 + rgb[2] * 29) >> 8);
+            }
+            if (y >= 2) {
+                k.laplacian_row(&luma[((y - 2) % 3) * width], &luma[((y - 1) % 3) * width], out, width, &sum, &sum_sq);
+            }
+        }
+    }
+
+    double count = static_cast<double>(width - 2) * (image.height - 2);
+    double mean = sum / count;
+    return sum_sq / count - mean * mean;
+}
+
+// --- DCT-domain metric ---
+
+namespace {
+
+struct CoefficientReader {
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    jmp_buf jpeg_jmp_buf;
+
+    CoefficientReader() {
+        cinfo.err = jpeg_std_error(&jerr);
+        jerr.error_exit = [](j_common_ptr cinfo) {
+            (*cinfo->err->output_message)(cinfo);
+            longjmp(static_cast<CoefficientReader*>(cinfo->client_data)->jpeg_jmp_buf, 1);
+        };
+        jerr.output_message = [](j_common_ptr cinfo) {
+            char buffer[JMSG_LENGTH_MAX];
+            (*cinfo->err->format_message)(cinfo, buffer);
+            log::write(log::Level::Warning, "libjpeg", log::NO_FRAME, cinfo->err->msg_code, "%s", buffer);
+        };
+        cinfo.client_data = static_cast<void*>(this);
+        jpeg_create_decompress(&cinfo);
+    }
+
+    ~CoefficientReader() {
+        jpeg_destroy_decompress(&cinfo);
+    }
+
+    bool energy(const uint8_t* jpeg, size_t size, double& energy) {
+        if (setjmp(jpeg_jmp_buf)) {
+            jpeg_abort_decompress(&cinfo);
+            return false;
+        }
+        jpeg_mem_src(&cinfo, const_cast<unsigned char*>(jpeg), static_cast<unsigned long>(size));
+        (void) jpeg_read_header(&cinfo, TRUE);
+        jvirt_barray_ptr* coefficients = jpeg_read_coefficients(&cinfo);
+
+        // Component 0 is luma. Coefficients and quantizers are in natural
+        // order; u + v < 2 (DC and the two lowest AC terms) mostly carries
+        // shading, not focus, and is skipped.
+        jpeg_component_info* comp = &cinfo.comp_info[0];
+        const UINT16* quant = comp->quant_table->quantval;
+        double total = 0;
+        for (JDIMENSION row = 0; row < comp->height_in_blocks; ++row) {
+            JBLOCKARRAY blocks = (*cinfo.mem->access_virt_barray)(
+                reinterpret_cast<j_common_ptr>(&cinfo), coefficients[0], row, 1, FALSE);
+            for (JDIMENSION col = 0; col < comp->width_in_blocks; ++col) {
+                const JCOEF* block = blocks[0][col];
+                int64_t block_energy = 0;
+                for (int i = 2; i < DCTSIZE2; ++i) {
+                    if (i / DCTSIZE + i % DCTSIZE >= 2) {
+                        int64_t v = static_cast<int64_t>(block[i]) * quant[i];
+                        block_energy += v * v;
+                    }
+                }
+                total += block_energy;
+            }
+        }
+        energy = total / (static_cast<double>(comp->height_in_blocks) * comp->width_in_blocks);
+        (void) jpeg_finish_decompress(&cinfo);
+        return true;
+    }
+};
+
+} // namespace
+
+bool dct_energy(const uint8_t* jpeg, size_t size, double& energy) {
+    CoefficientReader reader;
+    return reader.energy(jpeg, size, energy);
+}
+
+// --- Bursts ---
+
+std::vector<BurstScore> rank_by_sharpness(const std::vector<Frame>& frames, FocusMetric metric, unsigned threads) {
+    std::vector<BurstScore> scores(frames.size());
+    if (frames.empty()) {
+        return scores;
+    }
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = static_cast<unsigned>(std::min<size_t>(threads, frames.size()));
+
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        // Per-thread state: libjpeg objects are not shareable
+        CoefficientReader reader;
+        Decoder decoder;
+        DecodeOptions gray;
+        gray.format = DecodeOptions::Gray;
+        decoder.set_options(gray);
+        Image image;
+
+        for (size_t i = next++; i < frames.size(); i = next++) {
+            const Frame& frame = frames[i];
+            BurstScore& score = scores[i];
+            score.index = i;
+            score.frame_id = frame.id;
+            if (metric == FocusMetric::DctEnergy) {
+                double energy;
+                if (reader.energy(frame.jpeg.data(), frame.jpeg.size(), energy)) {
+                    score.score = energy;
+                }
+            } else if (decoder.decode(frame, image)) {
+                score.score = laplacian_variance(image);
+            }
+            if (score.score < 0) {
+                log::write(log::Level::Warning, "burst", frame.id, 0, "Could not score frame, ranking it last.");
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) {
+        pool.push_back(std::thread(worker));
+    }
+    worker();
+    for (size_t t = 0; t < pool.size(); ++t) {
+        pool[t].join();
+    }
+
+    std::stable_sort(scores.begin(), scores.end(),
+                     [](const BurstScore& a, const BurstScore& b) { return a.score > b.score; });
+    return scores;
+}
+
+bool capture_best(FrameSource& source, const BurstConfig& config, std::vector<Frame>& best) {
+    std::vector<Frame> burst;
+    burst.reserve(config.frames);
+    Frame frame;
+    while (burst.size() < config.frames && source.next_frame(frame)) {
+        burst.push_back(std::move(frame));
+        frame = Frame();
+    }
+    best.clear();
+    if (burst.empty()) {
+        return false;
+    }
+
+    std::vector<BurstScore> ranked = rank_by_sharpness(burst, config.metric, config.threads);
+    for (size_t i = 0; i < ranked.size() && i < config.keep; ++i) {
+        best.push_back(std::move(burst[ranked[i].index]));
+    }
+    return true;
+}
+
+} // namespace supercamera
@@ -0,0 +1,46 @@
+#ifndef SUPERCAMERA_SIMD_H
+#define SUPERCAMERA_SIMD_H
+
+// Internal to the library: shared by the translation units that carry SIMD
+// kernels. Each unit writes its variants under SUPERCAMERA_X86 with
+// __attribute__((target(...))), lists one complete kernel table per level
+// it has code for, and binds it with select_kernels().
+//
+// AVX2 variants end with _mm256_zeroupper() before any scalar or SSE tail:
+// non-VEX SSE code stalls while the upper halves of the ymm registers are
+// dirty.
+
+#include <cstddef>
+
+#include "supercamera/cpu_dispatch.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SUPERCAMERA_X86 1
+#include <immintrin.h>
+#endif
+
+namespace supercamera {
+
+template <typename Table>
+struct KernelVariant {
+    CpuLevel level;
+    Table table;
+};
+
+// The table of the highest listed level not above active_cpu_level().
+// `variants` is ordered by level and starts with the scalar table. Callers
+// keep the result in a function-local static, so a module binds once, like
+// kernels().
+template <typename Table, size_t N>
+Table select_kernels(const KernelVariant<Table> (&variants)[N]) {
+    CpuLevel level = active_cpu_level();
+    Table table = variants[0].table;
+    for (size_t i = 1; i < N && variants[i].level <= level; ++i) {
+        table = variants[i].table;
+    }
+    return table;
+}
+
+} // namespace supercamera
+
+#endif // SUPERCAMERA_SIMD_H
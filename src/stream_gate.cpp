@@ -0,0 +1,133 @@
+#include "supercamera/stream_gate.h"
+
+#include <vector>
+
+#include "supercamera/log.h"
+
+namespace supercamera {
+
+static const int ERROR_BACKOFF_MS = 100;
+
+StreamGate::StreamGate(FrameSource& source, unsigned idle_timeout_ms)
+    : source_(source),
+      idle_timeout_ms_(idle_timeout_ms),
+      next_id_(1),
+      idle_since_(std::chrono::steady_clock::now()),
+      shutdown_(false),
+      streaming_(false) {
+    thread_ = std::thread(&StreamGate::run, this);
+}
+
+StreamGate::~StreamGate() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shutdown_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+uint64_t StreamGate::subscribe(FrameCallback callback) {
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        id = next_id_++;
+        subscribers_[id] = callback;
+    }
+    cv_.notify_one();
+    return id;
+}
+
+void StreamGate::unsubscribe(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (subscribers_.erase(id) && subscribers_.empty()) {
+        idle_since_ = std::chrono::steady_clock::now();
+    }
+}
+
+StreamGate::Stats StreamGate::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void StreamGate::run() {
+    Frame frame;
+    std::vector<FrameCallback> callbacks;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (!streaming_) {
+                cv_.wait(lock, [this]() { return shutdown_ || !subscribers_.empty(); });
+            }
+            if (shutdown_) {
+                break;
+            }
+            bool idle = subscribers_.empty();
+            if (idle && std::chrono::steady_clock::now() - idle_since_ >= std::chrono::milliseconds(idle_timeout_ms_)) {
+                lock.unlock();
+                source_.stop();
+                streaming_ = false;
+                lock.lock();
+                ++stats_.stops;
+                continue;
+            }
+            if (!streaming_) {
+                lock.unlock();
+                bool started = source_.start();
+                lock.lock();
+                if (!started) {
+                    ++stats_.errors;
+                    lock.unlock();
+                    std::this_thread::sleep_for(std::chrono::milliseconds(ERROR_BACKOFF_MS));
+                    continue;
+                }
+                streaming_ = true;
+                ++stats_.starts;
+            }
+        }
+
+        if (!source_.next_frame(frame)) {
+            // The source recovers from most errors on its own; only a sticky
+            // one needs the start path above to re-arm it
+            bool restart = source_.needs_restart();
+            if (restart) {
+                log::write(log::Level::Warning, "gate", log::NO_FRAME, 0, "Frame source failed, restarting the stream.");
+                source_.stop();
+                streaming_ = false;
+            }
+            std::unique_lock<std::mutex> lock(mutex_);
+            ++stats_.errors;
+            if (restart) {
+                ++stats_.stops;
+            }
+            cv_.wait_for(lock, std::chrono::milliseconds(ERROR_BACKOFF_MS), [this]() { return shutdown_; });
+            continue;
+        }
+
+        callbacks.clear();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& entry : subscribers_) {
+                callbacks.push_back(entry.second);
+            }
+            if (callbacks.empty()) {
+                ++stats_.frames_discarded;
+            } else {
+                stats_.frames_delivered += callbacks.size();
+            }
+        }
+        for (auto& callback : callbacks) {
+            callback(frame);
+        }
+    }
+
+    if (streaming_) {
+        source_.stop();
+        streaming_ = false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.stops;
+    }
+}
+
+} // namespace supercamera
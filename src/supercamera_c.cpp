@@ -0,0 +1,206 @@
+#include "supercamera/supercamera_c.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "supercamera/camera.h"
+#include "supercamera/decoder.h"
+#include "supercamera/frame_source.h"
+
+using namespace supercamera;
+
+static const int DEFAULT_POOL_SIZE = 4;
+
+namespace {
+
+struct PoolSlot {
+    sc_frame view;
+    Frame frame;
+    Image image;
+    std::atomic<bool> in_use;
+
+    PoolSlot() : in_use(false) {}
+};
+
+} // namespace
+
+struct sc_camera {
+    std::unique_ptr<Camera> camera;          // Set when opened with sc_open()
+    std::unique_ptr<RawFileSource> replay;   // Set when opened with sc_open_raw_file()
+    FrameSource* source;
+    Decoder decoder;
+    std::vector<std::unique_ptr<PoolSlot> > pool;
+    bool started;
+
+    sc_camera() : source(nullptr), started(false) {}
+
+    PoolSlot* acquire_slot() {
+        for (size_t i = 0; i < pool.size(); ++i) {
+            bool expected = false;
+            if (pool[i]->in_use.compare_exchange_strong(expected, true)) {
+                return pool[i].get();
+            }
+        }
+        return nullptr;
+    }
+};
+
+static void init_pool(sc_camera* handle, int pool_size) {
+    int n = pool_size > 0 ? pool_size : DEFAULT_POOL_SIZE;
+    for (int i = 0; i < n; ++i) {
+        handle->pool.push_back(std::unique_ptr<PoolSlot>(new PoolSlot));
+    }
+}
+
+extern "C" {
+
+int sc_abi_version(void) {
+    return SC_ABI_VERSION;
+}
+
+const char* sc_status_string(int status) {
+    switch (status) {
+        case SC_OK:                 return "ok";
+        case SC_ERR_INVALID:        return "invalid argument";
+        case SC_ERR_NO_DEVICE:      return "camera not found";
+        case SC_ERR_IO:             return "transfer failed";
+        case SC_ERR_END_OF_STREAM:  return "end of stream";
+        case SC_ERR_POOL_EXHAUSTED: return "all frames in use";
+        case SC_ERR_DECODE:         return "decode failed";
+        case SC_ERR_INTERNAL:       return "internal error";
+    }
+    return "unknown status";
+}
+
+int sc_open(sc_camera** camera, int pool_size) {
+    if (!camera) {
+        return SC_ERR_INVALID;
+    }
+    try {
+        std::unique_ptr<sc_camera> handle(new sc_camera);
+        handle->camera.reset(new Camera);
+        if (!handle->camera->open()) {
+            return SC_ERR_NO_DEVICE;
+        }
+        handle->source = handle->camera.get();
+        init_pool(handle.get(), pool_size);
+        *camera = handle.release();
+        return SC_OK;
+    } catch (...) {
+        return SC_ERR_INTERNAL;
+    }
+}
+
+int sc_open_raw_file(sc_camera** camera, const char* path, int pool_size) {
+    if (!camera || !path) {
+        return SC_ERR_INVALID;
+    }
+    try {
+        std::unique_ptr<sc_camera> handle(new sc_camera);
+        handle->replay.reset(new RawFileSource(path));
+        if (!handle->replay->open()) {
+            return SC_ERR_IO;
+        }
+        handle->source = handle->replay.get();
+        init_pool(handle.get(), pool_size);
+        *camera = handle.release();
+        return SC_OK;
+    } catch (...) {
+        return SC_ERR_INTERNAL;
+    }
+}
+
+int sc_start(sc_camera* camera) {
+    if (!camera) {
+        return SC_ERR_INVALID;
+    }
+    try {
+        if (camera->camera && !camera->camera->start()) {
+            return SC_ERR_IO;
+        }
+        camera->started = true;
+        return SC_OK;
+    } catch (...) {
+        return SC_ERR_INTERNAL;
+    }
+}
+
+int sc_next_frame(sc_camera* camera, int format, const sc_frame** frame) {
+    if (!camera || !frame || !camera->started || (format != SC_FORMAT_JPEG && format != SC_FORMAT_RGB24)) {
+        return SC_ERR_INVALID;
+    }
+    PoolSlot* slot = camera->acquire_slot();
+    if (!slot) {
+        return SC_ERR_POOL_EXHAUSTED;
+    }
+
+    try {
+        if (!camera->source->next_frame(slot->frame)) {
+            slot->in_use.store(false);
+            return camera->replay ? SC_ERR_END_OF_STREAM : SC_ERR_IO;
+        }
+
+        sc_frame& view = slot->view;
+        view.id = slot->frame.id;
+        view.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                slot->frame.timestamp.time_since_epoch()).count();
+        view.format = format;
+        if (format == SC_FORMAT_RGB24) {
+            if (!camera->decoder.decode(slot->frame, slot->image)) {
+                slot->in_use.store(false);
+                return SC_ERR_DECODE;
+            }
+            view.width = slot->image.width;
+            view.height = slot->image.height;
+            view.channels = slot->image.channels;
+            view.stride = static_cast<size_t>(slot->image.width) * slot->image.channels;
+            view.data = slot->image.pixels.data();
+            view.size = slot->image.pixels.size();
+        } else {
+            view.width = view.height = view.channels = 0;
+            view.stride = 0;
+            view.data = slot->frame.jpeg.data();
+            view.size = slot->frame.jpeg.size();
+        }
+        *frame = &view;
+        return SC_OK;
+    } catch (...) {
+        slot->in_use.store(false);
+        return SC_ERR_INTERNAL;
+    }
+}
+
+void sc_release_frame(sc_camera* camera, const sc_frame* frame) {
+    if (!camera || !frame) {
+        return;
+    }
+    for (size_t i = 0; i < camera->pool.size(); ++i) {
+        if (&camera->pool[i]->view == frame) {
+            camera->pool[i]->in_use.store(false);
+            return;
+        }
+    }
+}
+
+int sc_stop(sc_camera* camera) {
+    if (!camera) {
+        return SC_ERR_INVALID;
+    }
+    try {
+        if (camera->camera) {
+            camera->camera->stop();
+        }
+        camera->started = false;
+        return SC_OK;
+    } catch (...) {
+        return SC_ERR_INTERNAL;
+    }
+}
+
+void sc_close(sc_camera* camera) {
+    delete camera;
+}
+
+} // extern "C"
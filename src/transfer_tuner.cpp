@@ -0,0 +1,152 @@
+#include "supercamera/transfer_tuner.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include <sys/stat.h>
+
+#include "supercamera/log.h"
+
+namespace supercamera {
+
+static size_t buffer_bytes(const TransferSettings& settings) {
+    return static_cast<size_t>(settings.transfer_size) * settings.transfers_in_flight;
+}
+
+bool valid_transfer_settings(const TransferSettings& settings) {
+    return settings.transfer_size > 0 && settings.transfer_size <= MAX_TRANSFER_SIZE &&
+           settings.transfer_size % TRANSFER_PACKET_SIZE == 0 && settings.transfers_in_flight > 0 &&
+           settings.transfers_in_flight <= MAX_TRANSFERS_IN_FLIGHT && settings.transfer_timeout_ms > 0;
+}
+
+bool pick_transfer_settings(const std::vector<TransferTrial>& trials, const TunerConfig& config,
+                            TransferSettings& best) {
+    double best_throughput = 0;
+    for (const TransferTrial& trial : trials) {
+        if (trial.ok) {
+            best_throughput = std::max(best_throughput, trial.bytes_per_s);
+        }
+    }
+    if (best_throughput <= 0) {
+        return false;
+    }
+
+    // Keep up first, then meet the latency target if anything can
+    std::vector<const TransferTrial*> qualified;
+    double lowest_latency = 0;
+    for (const TransferTrial& trial : trials) {
+        if (trial.ok && trial.bytes_per_s >= config.throughput_share * best_throughput) {
+            if (qualified.empty() || trial.latency_ms < lowest_latency) {
+                lowest_latency = trial.latency_ms;
+            }
+            qualified.push_back(&trial);
+        }
+    }
+    double latency_limit = std::max(config.target_latency_ms, lowest_latency);
+    double lowest_cpu = 0;
+    bool any = false;
+    for (const TransferTrial* trial : qualified) {
+        if (trial->latency_ms <= latency_limit && (!any || trial->cpu_pct < lowest_cpu)) {
+            lowest_cpu = trial->cpu_pct;
+            any = true;
+        }
+    }
+
+    const TransferTrial* chosen = nullptr;
+    for (const TransferTrial* trial : qualified) {
+        if (trial->latency_ms > latency_limit || trial->cpu_pct > lowest_cpu + config.cpu_tolerance_pct) {
+            continue;
+        }
+        if (!chosen || buffer_bytes(trial->settings) < buffer_bytes(chosen->settings) ||
+            (buffer_bytes(trial->settings) == buffer_bytes(chosen->settings) &&
+             trial->latency_ms < chosen->latency_ms)) {
+            chosen = trial;
+        }
+    }
+
+    best = chosen->settings;
+    double timeout_ms = 4 * chosen->max_latency_ms;
+    best.transfer_timeout_ms = static_cast<unsigned>(
+        std::min<double>(config.max_timeout_ms, std::max<double>(config.min_timeout_ms, timeout_ms)));
+    return true;
+}
+
+// --- Persistence ---
+
+bool load_transfer_settings(const std::string& path, const std::string& device, TransferSettings& settings) {
+    std::ifstream in(path.c_str());
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string name;
+        if (!(fields >> name) || name != device) {
+            continue;
+        }
+        TransferSettings loaded;
+        if (!(fields >> loaded.transfer_size >> loaded.transfers_in_flight >> loaded.transfer_timeout_ms) ||
+            !valid_transfer_settings(loaded)) {
+            log::write(log::Level::Warning, "autotune", log::NO_FRAME, 0,
+                       "Ignoring invalid tuned settings for %s in %s: \"%s\"", device.c_str(), path.c_str(),
+                       line.c_str());
+            return false;
+        }
+        settings = loaded;
+        return true;
+    }
+    return false;
+}
+
+// Creates the directories leading up to `path`; existing ones are fine
+static void make_parent_dirs(const std::string& path) {
+    for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+        mkdir(path.substr(0, slash).c_str(), 0755);
+    }
+}
+
+bool save_transfer_settings(const std::string& path, const std::string& device, const TransferSettings& settings) {
+    // Keep the other devices' lines; write a copy and rename it over the
+    // original, so a crash never leaves a half-written file behind
+    std::vector<std::string> lines;
+    std::ifstream in(path.c_str());
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string name;
+        if (fields >> name && name != device) {
+            lines.push_back(line);
+        }
+    }
+    in.close();
+
+    std::ostringstream entry;
+    entry << device << ' ' << settings.transfer_size << ' ' << settings.transfers_in_flight << ' '
+          << settings.transfer_timeout_ms;
+    lines.push_back(entry.str());
+
+    make_parent_dirs(path);
+    std::string temp = path + ".tmp";
+    std::ofstream out(temp.c_str(), std::ios::trunc);
+    for (const std::string& kept : lines) {
+        out << kept << '\n';
+    }
+    out.close();
+    if (!out || std::rename(temp.c_str(), path.c_str()) != 0) {
+        std::remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::string default_tuning_path() {
+    const char* cache = std::getenv("XDG_CACHE_HOME");
+    if (cache && *cache) {
+        return std::string(cache) + "/supercamera/transfers";
+    }
+    const char* home = std::getenv("HOME");
+    return std::string(home ? home : ".") + "/.cache/supercamera/transfers";
+}
+
+} // namespace supercamera
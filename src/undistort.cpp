@@ -0,0 +1,165 @@
+#include "supercamera/undistort.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "simd.h"
+
+namespace supercamera {
+
+static const uint32_t INVALID = 0xFFFFFFFFu;
+static const int WEIGHT_ONE = 128; // 7-bit weights keep the vertical pass in 16 bits
+
+// --- Interpolation ---
+// Both variants compute, per channel,
+//   v = top * (128 - wy) + bottom * wy      (left and right column)
+//   out = (v_left * (128 - wx) + v_right * wx + 8192) >> 14
+// so they produce identical bytes.
+
+static inline void remap_pixel(const uint8_t* p, size_t stride, int wx, int wy, uint8_t* out) {
+    const uint8_t* q = p + stride;
+    for (int c = 0; c < 3; ++c) {
+        int left = p[c] * (WEIGHT_ONE - wy) + q[c] * wy;
+        int right = p[3 + c] * (WEIGHT_ONE - wy) + q[3 + c] * wy;
+        out[c] = static_cast<uint8_t>((left * (WEIGHT_ONE - wx) + right * wx + 8192) >> 14);
+    }
+}
+
+// The row functions are templated on Undistorter's private Tap type
+template <typename TapT>
+struct UndistortKernels {
+    // n output pixels from taps[0..n); src_size bounds the reads
+    void (*remap_row)(const uint8_t* src, size_t src_size, size_t stride, const TapT* taps, int n, uint8_t* out);
+};
+
+template <typename TapT>
+static void remap_row_scalar_t(const uint8_t* src, size_t, size_t stride, const TapT* taps, int n, uint8_t* out) {
+    for (int x = 0; x < n; ++x, out += 3) {
+        const TapT& t = taps[x];
+        if (t.offset == INVALID) {
+            out[0] = out[1] = out[2] = 0;
+        } else {
+            remap_pixel(src + t.offset, stride, t.wx, t.wy, out);
+        }
+    }
+}
+
+#if defined(SUPERCAMERA_X86)
+
+// One pixel per iteration: the 2x2 neighbourhood is two 8-byte loads, the
+// vertical blend runs on all six channels in 16-bit lanes, and pmaddwd does
+// the horizontal blend after pairing each channel with its right neighbour.
+// Loads read two bytes past the right-hand pixel, so pixels whose bottom row
+// ends within 8 bytes of the buffer end fall back to the scalar path.
+template <typename TapT>
+__attribute__((target("sse2")))
+static void remap_row_sse2_t(const uint8_t* src, size_t src_size, size_t stride, const TapT* taps, int n, uint8_t* out) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(8192);
+    for (int x = 0; x < n; ++x, out += 3) {
+        const TapT& t = taps[x];
+        if (t.offset == INVALID) {
+            out[0] = out[1] = out[2] = 0;
+            continue;
+        }
+        if (t.offset + stride + 8 > src_size) {
+            remap_pixel(src + t.offset, stride, t.wx, t.wy, out);
+            continue;
+        }
+        __m128i top = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + t.offset)), zero);
+        __m128i bottom = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + t.offset + stride)), zero);
+        __m128i v = _mm_add_epi16(_mm_mullo_epi16(top, _mm_set1_epi16(static_cast<short>(WEIGHT_ONE - t.wy))),
+                                  _mm_mullo_epi16(bottom, _mm_set1_epi16(static_cast<short>(t.wy))));
+        // [L_r L_g L_b R_r R_g R_b ..] -> [L_r R_r L_g R_g L_b R_b ..]
+        __m128i pairs = _mm_unpacklo_epi16(v, _mm_srli_si128(v, 6));
+        __m128i w = _mm_set1_epi32(static_cast<int>((static_cast<uint32_t>(t.wx) << 16) | (WEIGHT_ONE - t.wx)));
+        __m128i h = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(pairs, w), round), 14);
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(h, h), zero);
+        uint32_t rgb = static_cast<uint32_t>(_mm_cvtsi128_si32(packed));
+        out[0] = static_cast<uint8_t>(rgb);
+        out[1] = static_cast<uint8_t>(rgb >> 8);
+        out[2] = static_cast<uint8_t>(rgb >> 16);
+    }
+}
+
+#endif // SUPERCAMERA_X86
+
+// --- Remap table ---
+
+void Undistorter::build_map(const LensModel& model) {
+    map_.resize(static_cast<size_t>(width_) * height_);
+    size_t stride = static_cast<size_t>(width_) * 3;
+    double fx = model.fx * model.zoom, fy = model.fy * model.zoom;
+
+    for (int v = 0; v < height_; ++v) {
+        for (int u = 0; u < width_; ++u) {
+            // Ideal (undistorted) normalized coordinates of the output pixel,
+            // pushed through the distortion model to find where it was imaged
+            double x = (u - model.cx) / fx, y = (v - model.cy) / fy;
+            double r2 = x * x + y * y;
+            double radial = 1 + r2 * (model.k1 + r2 * (model.k2 + r2 * model.k3));
+            double xd = x * radial + 2 * model.p1 * x * y + model.p2 * (r2 + 2 * x * x);
+            double yd = y * radial + model.p1 * (r2 + 2 * y * y) + 2 * model.p2 * x * y;
+            double sx = model.fx * xd + model.cx, sy = model.fy * yd + model.cy;
+
+            Tap& tap = map_[static_cast<size_t>(v) * width_ + u];
+            tap.pad = 0;
+            if (!(sx >= 0 && sy >= 0 && sx <= width_ - 1 && sy <= height_ - 1)) {
+                tap.offset = INVALID;
+                tap.wx = tap.wy = 0;
+                continue;
+            }
+            // The right/bottom neighbour must exist, so the last column/row
+            // is sampled from one step back with full weight
+            int x0 = std::min(static_cast<int>(sx), width_ - 2);
+            int y0 = std::min(static_cast<int>(sy), height_ - 2);
+            tap.offset = static_cast<uint32_t>(y0 * stride + x0 * 3);
+            tap.wx = static_cast<uint8_t>(std::lround((sx - x0) * WEIGHT_ONE));
+            tap.wy = static_cast<uint8_t>(std::lround((sy - y0) * WEIGHT_ONE));
+        }
+    }
+}
+
+// --- Bands ---
+
+Undistorter::Undistorter(const LensModel& model, int width, int height, unsigned threads)
+    : width_(width), height_(height), pool_(std::max(1u, std::min(threads, static_cast<unsigned>(std::max(height, 1))))) {
+    if (width_ >= 2 && height_ >= 2) {
+        build_map(model);
+    }
+}
+
+bool Undistorter::apply(const Image& source, Image& out) {
+    if (source.channels != 3 || source.width != width_ || source.height != height_ || map_.empty()) {
+        return false;
+    }
+    out.width = width_;
+    out.height = height_;
+    out.channels = 3;
+    out.pixels.resize(source.pixels.size());
+
+    pool_.run(pool_.threads(), [&](unsigned band, unsigned bands) {
+        remap_rows(source, out, height_ * band / bands, height_ * (band + 1) / bands);
+    });
+    return true;
+}
+
+void Undistorter::remap_rows(const Image& source, Image& out, int y0, int y1) const {
+    const uint8_t* src = source.pixels.data();
+    size_t size = source.pixels.size();
+    size_t stride = static_cast<size_t>(width_) * 3;
+    static const KernelVariant<UndistortKernels<Tap> > variants[] = {
+        {CpuLevel::Scalar, {remap_row_scalar_t<Tap>}},
+#if defined(SUPERCAMERA_X86)
+        {CpuLevel::SSE2, {remap_row_sse2_t<Tap>}},
+#endif
+    };
+    static const UndistortKernels<Tap> k = select_kernels(variants);
+
+    for (int y = y0; y < y1; ++y) {
+        k.remap_row(src, size, stride, &map_[static_cast<size_t>(y) * width_], width_, &out.pixels[y * stride]);
+    }
+}
+
+} // namespace supercamera
@@ -0,0 +1,336 @@
+// Compares two `camera_bench <passes> <file.json>` results and exits
+// non-zero when a stage got significantly slower. Each benchmark's per-pass
+// samples are compared with a one-sided Mann-Whitney U test; a stage counts
+// as a regression when the slowdown is significant at `alpha` and its median
+// grew by more than `max_regression_pct`.
+//
+//   camera_bench_compare baseline.json candidate.json [max_regression_pct] [alpha]
+//
+// Exit status: 0 no regression, 1 regression found, 2 usage or input error.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <map>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+
+// --- Minimal JSON reader (just enough for the benchmark output format) ---
+
+struct JsonValue {
+    enum Type { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT } type = NUL;
+    double number = 0;
+    std::string str;
+    std::vector<JsonValue> items;
+    std::map<std::string, JsonValue> members;
+
+    const JsonValue* get(const std::string& key) const {
+        auto it = members.find(key);
+        return it == members.end() ? nullptr : &it->second;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text) : s_(text), pos_(0) {}
+
+    bool parse(JsonValue& out) {
+        if (!value(out)) {
+            return false;
+        }
+        skip_ws();
+        return pos_ == s_.size();
+    }
+
+private:
+    void skip_ws() {
+        while (pos_ < s_.size() && std::isspace(static_cast<unsigned char>(s_[pos_]))) {
+            ++pos_;
+        }
+    }
+
+    bool literal(const char* word) {
+        size_t n = std::char_traits<char>::length(word);
+        if (s_.compare(pos_, n, word) != 0) {
+            return false;
+        }
+        pos_ += n;
+        return true;
+    }
+
+    bool string(std::string& out) {
+        if (s_[pos_] != '"') {
+            return false;
+        }
+        ++pos_;
+        while (pos_ < s_.size() && s_[pos_] != '"') {
+            if (s_[pos_] == '\\' && pos_ + 1 < s_.size()) {
+                ++pos_;
+            }
+            out.push_back(s_[pos_++]);
+        }
+        if (pos_ >= s_.size()) {
+            return false;
+        }
+        ++pos_;
+        return true;
+    }
+
+    bool value(JsonValue& out) {
+        skip_ws();
+        if (pos_ >= s_.size()) {
+            return false;
+        }
+        char c = s_[pos_];
+        if (c == '{') {
+            out.type = JsonValue::OBJECT;
+            ++pos_;
+            skip_ws();
+            if (pos_ < s_.size() && s_[pos_] == '}') {
+                ++pos_;
+                return true;
+            }
+            while (true) {
+                skip_ws();
+                std::string key;
+                if (pos_ >= s_.size() || !string(key)) {
+                    return false;
+                }
+                skip_ws();
+                if (pos_ >= s_.size() || s_[pos_++] != ':') {
+                    return false;
+                }
+                if (!value(out.members[key])) {
+                    return false;
+                }
+                skip_ws();
+                if (pos_ < s_.size() && s_[pos_] == ',') {
+                    ++pos_;
+                    continue;
+                }
+                return pos_ < s_.size() && s_[pos_++] == '}';
+            }
+        }
+        if (c == '[') {
+            out.type = JsonValue::ARRAY;
+            ++pos_;
+            skip_ws();
+            if (pos_ < s_.size() && s_[pos_] == ']') {
+                ++pos_;
+                return true;
+            }
+            while (true) {
+                out.items.push_back(JsonValue());
+                if (!value(out.items.back())) {
+                    return false;
+                }
+                skip_ws();
+                if (pos_ < s_.size() && s_[pos_] == ',') {
+                    ++pos_;
+                    continue;
+                }
+                return pos_ < s_.size() && s_[pos_++] == ']';
+            }
+        }
+        if (c == '"') {
+            out.type = JsonValue::STRING;
+            return string(out.str);
+        }
+        if (literal("true") || literal("false")) {
+            out.type = JsonValue::BOOL;
+            out.number = (s_[pos_ - 1] == 'e' && s_[pos_ - 2] == 'u') ? 1 : 0;
+            return true;
+        }
+        if (literal("null")) {
+            return true;
+        }
+        const char* begin = s_.c_str() + pos_;
+        char* end = nullptr;
+        out.number = std::strtod(begin, &end);
+        if (end == begin) {
+            return false;
+        }
+        out.type = JsonValue::NUMBER;
+        pos_ += end - begin;
+        return true;
+    }
+
+    const std::string& s_;
+    size_t pos_;
+};
+
+// Benchmark name -> per-pass samples
+static bool load_results(const char* path, std::map<std::string, std::vector<double> >& results) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Could not open benchmark results: " << path << std::endl;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string text = buffer.str();
+
+    JsonValue root;
+    if (!JsonParser(text).parse(root) || root.type != JsonValue::OBJECT) {
+        std::cerr << "Error: " << path << " is not valid JSON." << std::endl;
+        return false;
+    }
+    const JsonValue* benchmarks = root.get("benchmarks");
+    if (!benchmarks || benchmarks->type != JsonValue::ARRAY) {
+        std::cerr << "Error: " << path << " has no \"benchmarks\" array." << std::endl;
+        return false;
+    }
+    for (const JsonValue& b : benchmarks->items) {
+        const JsonValue* name = b.get("name");
+        const JsonValue* samples = b.get("samples");
+        if (!name || name->type != JsonValue::STRING || !samples || samples->type != JsonValue::ARRAY) {
+            continue;
+        }
+        std::vector<double>& out = results[name->str];
+        for (const JsonValue& v : samples->items) {
+            if (v.type == JsonValue::NUMBER) {
+                out.push_back(v.number);
+            }
+        }
+    }
+    return true;
+}
+
+// --- Statistics ---
+
+static double median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    size_t n = v.size();
+    return (n % 2) ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+// P(U >= u) for the Mann-Whitney statistic of m against n samples without
+// ties, from the exact permutation distribution.
+static double exact_upper_tail(int m, int n, double u) {
+    // counts[i][j][k]: orderings of i and j samples whose U equals k
+    int max_u = m * n;
+    std::vector<std::vector<std::vector<double> > > counts(
+        m + 1, std::vector<std::vector<double> >(n + 1, std::vector<double>(max_u + 1, 0.0)));
+    for (int i = 0; i <= m; ++i) {
+        for (int j = 0; j <= n; ++j) {
+            if (i == 0 || j == 0) {
+                counts[i][j][0] = 1.0;
+                continue;
+            }
+            for (int k = 0; k <= i * j; ++k) {
+                double c = counts[i][j - 1][k];
+                if (k - j >= 0) {
+                    c += counts[i - 1][j][k - j];
+                }
+                counts[i][j][k] = c;
+            }
+        }
+    }
+    double total = 0, tail = 0;
+    for (int k = 0; k <= max_u; ++k) {
+        total += counts[m][n][k];
+        if (k >= u - 1e-9) {
+            tail += counts[m][n][k];
+        }
+    }
+    return tail / total;
+}
+
+// One-sided p-value for "candidate samples tend to be larger than baseline"
+static double mann_whitney_p(const std::vector<double>& baseline, const std::vector<double>& candidate) {
+    size_t n1 = baseline.size(), n2 = candidate.size();
+    std::vector<std::pair<double, int> > all;
+    for (double v : baseline) all.push_back(std::make_pair(v, 0));
+    for (double v : candidate) all.push_back(std::make_pair(v, 1));
+    std::sort(all.begin(), all.end());
+
+    // Average ranks over ties, accumulating the tie correction term
+    double rank_sum = 0, tie_term = 0;
+    bool ties = false;
+    for (size_t i = 0; i < all.size();) {
+        size_t j = i;
+        while (j < all.size() && all[j].first == all[i].first) {
+            ++j;
+        }
+        double avg_rank = 0.5 * (i + 1 + j);
+        for (size_t k = i; k < j; ++k) {
+            if (all[k].second == 1) {
+                rank_sum += avg_rank;
+            }
+        }
+        double t = static_cast<double>(j - i);
+        if (t > 1) {
+            ties = true;
+            tie_term += t * t * t - t;
+        }
+        i = j;
+    }
+    double u = rank_sum - n2 * (n2 + 1) / 2.0;
+
+    if (!ties && n1 + n2 <= 40) {
+        return exact_upper_tail(static_cast<int>(n2), static_cast<int>(n1), u);
+    }
+    double n = static_cast<double>(n1 + n2);
+    double mean = n1 * n2 / 2.0;
+    double var = n1 * n2 / 12.0 * ((n + 1) - tie_term / (n * (n - 1)));
+    if (var <= 0) {
+        return 1.0;
+    }
+    double z = (u - mean - 0.5) / std::sqrt(var); // Continuity correction
+    return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <baseline.json> <candidate.json> [max_regression_pct] [alpha]" << std::endl;
+        return 2;
+    }
+    double max_regression_pct = (argc > 3) ? std::atof(argv[3]) : 5.0;
+    double alpha = (argc > 4) ? std::atof(argv[4]) : 0.05;
+
+    std::map<std::string, std::vector<double> > baseline, candidate;
+    if (!load_results(argv[1], baseline) || !load_results(argv[2], candidate)) {
+        return 2;
+    }
+
+    std::cout << std::left << std::setw(12) << "benchmark" << std::right << std::setw(16) << "baseline_us"
+              << std::setw(16) << "candidate_us" << std::setw(10) << "change" << std::setw(10) << "p" << "  verdict" << std::endl;
+
+    int regressions = 0;
+    for (const auto& entry : baseline) {
+        auto it = candidate.find(entry.first);
+        if (it == candidate.end() || entry.second.empty() || it->second.empty()) {
+            std::cout << std::left << std::setw(12) << entry.first << "  missing from candidate, skipped" << std::endl;
+            continue;
+        }
+        double base_median = median(entry.second);
+        double cand_median = median(it->second);
+        double change_pct = base_median > 0 ? (cand_median / base_median - 1.0) * 100.0 : 0.0;
+        double p = mann_whitney_p(entry.second, it->second);
+        bool regressed = p < alpha && change_pct > max_regression_pct;
+        regressions += regressed ? 1 : 0;
+
+        std::cout << std::left << std::setw(12) << entry.first << std::right << std::fixed
+                  << std::setprecision(1) << std::setw(16) << base_median / 1000.0 << std::setw(16) << cand_median / 1000.0
+                  << std::showpos << std::setw(9) << change_pct << "%" << std::noshowpos
+                  << std::setprecision(4) << std::setw(10) << p << "  " << (regressed ? "REGRESSION" : "ok") << std::endl;
+    }
+    for (const auto& entry : candidate) {
+        if (baseline.find(entry.first) == baseline.end()) {
+            std::cout << std::left << std::setw(12) << entry.first << "  new, not compared" << std::endl;
+        }
+    }
+
+    if (regressions > 0) {
+        std::cerr << regressions << " benchmark(s) regressed by more than " << max_regression_pct
+                  << "% (alpha " << alpha << ")." << std::endl;
+        return 1;
+    }
+    return 0;
+}
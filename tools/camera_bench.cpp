@@ -0,0 +1,1768 @@
+// camera_bench: in-memory benchmark, soak test and synthetic corpus for the
+// supercamera pipeline. None of the modes need the camera attached.
+//
+//   camera_bench [passes] [results.json]
+//   camera_bench --soak [seconds] [speed] [max_growth_pct]
+//   camera_bench --saturate [seconds] [speed] [hog_threads]
+//   camera_bench --convert [iterations]
+//   camera_bench --undistort [iterations] [threads]
+//   camera_bench --enhance [iterations] [threads]
+//   camera_bench --denoise [iterations] [threads]
+//   camera_bench --stats [iterations]
+//   camera_bench --pyramid [iterations]
+//   camera_bench --resilient [damaged_pct]
+//   camera_bench --packet-loss [loss_pct] [passes]
+//   camera_bench --zero-copy [passes] [transfer_size]
+//   camera_bench --tuner-check
+//   camera_bench --synthesize [frames]
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <iterator>
+#include <random>
+
+#include <malloc.h>
+#include <unistd.h>
+
+#include <jpeglib.h>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#include "perf_counters.h"
+#include "supercamera/convert.h"
+#include "supercamera/cpu_dispatch.h"
+#include "supercamera/decoder.h"
+#include "supercamera/frame_assembler.h"
+#include "supercamera/governor.h"
+#include "supercamera/log.h"
+#include "supercamera/transfer_tuner.h"
+#include "supercamera/undistort.h"
+#include "supercamera/enhance.h"
+#include "supercamera/denoise.h"
+
+using supercamera::AssembledFrame;
+using supercamera::Decoder;
+using supercamera::FrameAssembler;
+using supercamera::GovernorConfig;
+using supercamera::QualityGovernor;
+using supercamera::Image;
+using supercamera::unstuff_jpeg;
+
+const char* RAW_FILENAME        = "image_data.raw";
+const int MAX_PACKET_SIZE       = 512; // Bulk transfer size of the live camera
+const int EXPECTED_IMAGE_WIDTH  = 640;
+const int EXPECTED_IMAGE_HEIGHT = 480;
+
+bool write_synthetic_capture(int frames);
+bool run_benchmark(int iterations, const char* json_path);
+bool run_soak(double duration_s, double speed, double max_growth_pct);
+bool run_saturate(double duration_s, double speed, int hog_threads);
+bool run_convert_bench(int iterations);
+bool run_undistort_bench(int iterations, int threads);
+bool run_enhance_bench(int iterations, int threads);
+bool run_denoise_bench(int iterations, int threads);
+bool run_stats_bench(int iterations);
+bool run_pyramid_bench(int iterations);
+bool run_resilient_bench(double damaged_pct);
+bool run_packet_loss_bench(double loss_pct, int passes);
+bool run_zero_copy_bench(int passes, int transfer_size);
+bool run_tuner_check();
+
+int main(int argc, char **argv) {
+    if (argc > 1 && std::string(argv[1]) == "--synthesize") {
+        int frames = (argc > 2) ? std::atoi(argv[2]) : 30;
+        return (frames > 0 && write_synthetic_capture(frames)) ? 0 : 1;
+    } else if (argc > 1 && std::string(argv[1]) == "--soak") {
+        double duration_s = (argc > 2) ? std::atof(argv[2]) : 3600.0;
+        double speed = (argc > 3) ? std::atof(argv[3]) : 1.0;
+        double max_growth_pct = (argc > 4) ? std::atof(argv[4]) : 10.0;
+        if (duration_s <= 0 || speed <= 0 || max_growth_pct < 0) {
+            std::cerr << "Usage: " << argv[0] << " --soak [seconds] [speed] [max_growth_pct]" << std::endl;
+            return 1;
+        }
+        return run_soak(duration_s, speed, max_growth_pct) ? 0 : 1;
+    } else if (argc > 1 && std::string(argv[1]) == "--saturate") {
+        double duration_s = (argc > 2) ? std::atof(argv[2]) : 10.0;
+        double speed = (argc > 3) ? std::atof(argv[3]) : 20.0;
+        int hog_threads = (argc > 4) ? std::atoi(argv[4]) : 0;
+        if (duration_s <= 0 || speed <= 0 || hog_threads < 0) {
+            std::cerr << "Usage: " << argv[0] << " --saturate [seconds] [speed] [hog_threads]" << std::endl;
+            return 1;
+        }
+        return run_saturate(duration_s, speed, hog_threads) ? 0 : 1;
+    } else if (argc > 1 && std::string(argv[1]) == "--convert") {
+        int iterations = (argc > 2) ? std::atoi(argv[2]) : 200;
+        if (iterations <= 0) {
+            std::cerr << "Usage: " << argv[0] << " --convert [iterations]" << std::endl;
+            return 1;
+        }
+        return run_convert_bench(iterations) ? 0 : 1;
+    } else if (argc > 1 && std::string(argv[1]) == "--undistort") {
+        int iterations = (argc > 2) ? std::atoi(argv[2]) : 300;
+        int threads = (argc > 3) ? std::atoi(argv[3]) : 1;
+        if (iterations <= 0 || threads <= 0) {
+            std::cerr << "Usage: " << argv[0] << " --undistort [iterations] [threads]" << std::endl;
+            return 1;
+        }
+        return run_undistort_bench(iterations, threads) ? 0 : 1;
+    } else if (argc > 1 && std::string(argv[1]) == "--enhance") {
+        int iterations = (argc > 2) ? std::atoi(argv[2]) : 300;
+        int threads = (argc > 3) ? std::atoi(argv[3]) : 1;
+        if (iterations <= 0 || threads <= 0) {
+            std::cerr << "Usage: " << argv[0] << " --enhance [iterations] [threads]" << std::endl;
+            return 1;
+        }
+        return run_enhance_bench(iterations, threads) ? 0 : 1;
+    } else if (argc > 1 && std::string(argv[1]) == "--denoise") {
+        int iterations = (argc > 2) ? std::atoi(argv[2]) : 300;
+        int threads = (argc > 3) ? std::atoi(argv[3]) : 1;
+        if (iterations <= 0 || threads <= 0) {
+            std::cerr << "Usage: " << argv[0] << " --denoise [iterations] [threads]" << std::endl;
+            return 1;
+        }
+        return run_denoise_bench(iterations, threads) ? 0 : 1;
+    } else if (argc > 1 && std::string(argv[1]) == "--stats") {
+        int iterations = (argc > 2) ? std::atoi(argv[2]) : 100;
+        if (iterations <= 0) {
+            std::cerr << "Usage: " << argv[0] << " --stats [iterations]" << std::endl;
+            return 1;
+        }
+        return run_stats_bench(iterations) ? 0 : 1;
+    } else if (argc > 1 && std::string(argv[1]) == "--pyramid") {
+        int iterations = (argc > 2) ? std::atoi(argv[2]) : 100;
+        if (iterations <= 0) {
+            std::cerr << "Usage: " << argv[0] << " --pyramid [iterations]" << std::endl;
+            return 1;
+        }
+        return run_pyramid_bench(iterations) ? 0 : 1;
+    } else if (argc > 1 && std::string(argv[1]) == "--resilient") {
+        double damaged_pct = (argc > 2) ? std::atof(argv[2]) : 20.0;
+        if (damaged_pct < 0 || damaged_pct > 100) {
+            std::cerr << "Usage: " << argv[0] << " --resilient [damaged_pct]" << std::endl;
+            return 1;
+        }
+        return run_resilient_bench(damaged_pct) ? 0 : 1;
+    } else if (argc > 1 && std::string(argv[1]) == "--packet-loss") {
+        double loss_pct = (argc > 2) ? std::atof(argv[2]) : 0.5;
+        int passes = (argc > 3) ? std::atoi(argv[3]) : 20;
+        if (loss_pct < 0 || loss_pct > 100 || passes <= 0) {
+            std::cerr << "Usage: " << argv[0] << " --packet-loss [loss_pct] [passes]" << std::endl;
+            return 1;
+        }
+        return run_packet_loss_bench(loss_pct, passes) ? 0 : 1;
+    } else if (argc > 1 && std::string(argv[1]) == "--zero-copy") {
+        int passes = (argc > 2) ? std::atoi(argv[2]) : 200;
+        int transfer_size = (argc > 3) ? std::atoi(argv[3]) : MAX_PACKET_SIZE;
+        if (passes <= 0 || transfer_size <= 0) {
+            std::cerr << "Usage: " << argv[0] << " --zero-copy [passes] [transfer_size]" << std::endl;
+            return 1;
+        }
+        return run_zero_copy_bench(passes, transfer_size) ? 0 : 1;
+    } else if (argc > 1 && std::string(argv[1]) == "--tuner-check") {
+        return run_tuner_check() ? 0 : 1;
+    }
+
+    int iterations = (argc > 1) ? std::atoi(argv[1]) : 10;
+    const char* json_path = (argc > 2) ? argv[2] : nullptr;
+    if (iterations <= 0) {
+        std::cerr << "Usage: " << argv[0] << " [passes] [results.json]" << std::endl;
+        return 1;
+    }
+    return run_benchmark(iterations, json_path) ? 0 : 1;
+}
+
+static bool read_raw_file(std::vector<uint8_t>& raw_data) {
+    std::ifstream raw_file(RAW_FILENAME, std::ios::binary);
+    if (!raw_file.is_open()) {
+        std::cerr << "Could not open raw data file: " << RAW_FILENAME << std::endl;
+        return false;
+    }
+
+    // Read the entire raw file into memory
+    raw_data.assign((std::istreambuf_iterator<char>(raw_file)), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// --- Synthetic corpus ---
+// Builds a deterministic stand-in for a camera capture so the benchmark, the
+// soak test and bench_compare give comparable numbers on any Linux machine:
+// textured 640x480 JPEG frames with the camera's FF 24 stuffing, split into
+// MAX_PACKET_SIZE transfers that each start with a 12-byte vendor header.
+
+const int SYNTHETIC_JPEG_QUALITY = 85;
+
+static bool encode_synthetic_frame(int index, std::vector<uint8_t>& jpeg) {
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+
+    unsigned char* mem = nullptr;
+    unsigned long mem_size = 0;
+    jpeg_mem_dest(&cinfo, &mem, &mem_size);
+
+    cinfo.image_width = EXPECTED_IMAGE_WIDTH;
+    cinfo.image_height = EXPECTED_IMAGE_HEIGHT;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, SYNTHETIC_JPEG_QUALITY, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+
+    // Moving gradients plus LCG noise: enough texture for realistic entropy decode cost
+    uint32_t seed = 0x9E3779B9u * (index + 1);
+    std::vector<uint8_t> row(EXPECTED_IMAGE_WIDTH * 3);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        int y = cinfo.next_scanline;
+        for (int x = 0; x < EXPECTED_IMAGE_WIDTH; ++x) {
+            seed = seed * 1664525u + 1013904223u;
+            int noise = static_cast<int>(seed >> 28);
+            row[x * 3 + 0] = static_cast<uint8_t>((x + index * 4) + noise);
+            row[x * 3 + 1] = static_cast<uint8_t>(((x * y) >> 6) + noise);
+            row[x * 3 + 2] = static_cast<uint8_t>(((x ^ y) + index * 2) + noise);
+        }
+        JSAMPROW row_pointer = row.data();
+        (void) jpeg_write_scanlines(&cinfo, &row_pointer, 1);
+    }
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    jpeg.assign(mem, mem + mem_size);
+    free(mem);
+
+    // Re-apply the camera's FF 24 stuffing to the entropy-coded data after SOS
+    const uint8_t sos_marker[] = {0xFF, 0xDA};
+    auto sos = std::search(jpeg.begin(), jpeg.end(), sos_marker, sos_marker + 2);
+    for (size_t i = std::distance(jpeg.begin(), sos) + 2; i + 1 < jpeg.size(); ++i) {
+        if (jpeg[i] == 0xFF && jpeg[i+1] == 0x00) {
+            jpeg[i+1] = 0x24;
+        }
+    }
+    return true;
+}
+
+bool write_synthetic_capture(int frames) {
+    std::ofstream outfile(RAW_FILENAME, std::ios::binary);
+    if (!outfile.is_open()) {
+        std::cerr << "Error opening output file: " << RAW_FILENAME << std::endl;
+        return false;
+    }
+
+    const uint8_t packet_header[FrameAssembler::PACKET_HEADER_SIZE] = {0xAA, 0xBB, 0x07};
+    const size_t payload_per_packet = MAX_PACKET_SIZE - sizeof(packet_header);
+    long long total_bytes = 0;
+    std::vector<uint8_t> jpeg;
+
+    for (int f = 0; f < frames; ++f) {
+        encode_synthetic_frame(f, jpeg);
+        for (size_t pos = 0; pos < jpeg.size(); pos += payload_per_packet) {
+            size_t n = std::min(payload_per_packet, jpeg.size() - pos);
+            outfile.write(reinterpret_cast<const char*>(packet_header), sizeof(packet_header));
+            outfile.write(reinterpret_cast<const char*>(&jpeg[pos]), n);
+            total_bytes += sizeof(packet_header) + n;
+        }
+    }
+
+    outfile.close();
+    std::cout << "Synthetic capture of " << frames << " frames saved to \"" << RAW_FILENAME << "\" ("
+              << total_bytes << " bytes)." << std::endl;
+    return true;
+}
+
+// --- Benchmark ---
+// Replays RAW_FILENAME through every conversion stage in memory and reports
+// per-frame wall time plus hardware counters, so decode regressions can be
+// attributed to cache misses, branch mispredicts or plain instruction count.
+
+struct StageStats {
+    const char* name;
+    double total_ns;
+    PerfCounts counts;
+    std::vector<double> pass_ns_per_frame; // One sample per pass, for bench_compare
+};
+
+static void png_to_vector(void* context, void* data, int size) {
+    std::vector<uint8_t>* out = static_cast<std::vector<uint8_t>*>(context);
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    out->insert(out->end(), bytes, bytes + size);
+}
+
+static void add_counts(PerfCounts& total, const PerfCounts& sample) {
+    total.cycles += sample.cycles;
+    total.instructions += sample.instructions;
+    total.cache_misses += sample.cache_misses;
+    total.branch_misses += sample.branch_misses;
+}
+
+static void write_benchmark_json(std::ostream& out, const StageStats* stages, int num_stages,
+                                 long long total_frames, int width, int height, const PerfCounters& perf) {
+    out << std::fixed << std::setprecision(1);
+    out << "{\n  \"context\": {\"source\": \"" << RAW_FILENAME << "\", \"frames\": " << total_frames
+        << ", \"width\": " << width << ", \"height\": " << height
+        << ", \"perf_counters\": " << (perf.available() ? "true" : "false")
+        << ", \"cpu_level\": \"" << supercamera::cpu_level_name(supercamera::bound_cpu_level()) << "\"},\n";
+    out << "  \"benchmarks\": [\n";
+    for (int s = 0; s < num_stages; ++s) {
+        const StageStats& st = stages[s];
+        double n = static_cast<double>(total_frames);
+        out << "    {\"name\": \"" << st.name << "\", \"unit\": \"ns_per_frame\", \"mean\": " << st.total_ns / n;
+        if (perf.available()) {
+            out << ", \"cycles\": " << st.counts.cycles / n << ", \"instructions\": " << st.counts.instructions / n
+                << ", \"cache_misses\": " << st.counts.cache_misses / n
+                << ", \"branch_misses\": " << st.counts.branch_misses / n;
+        }
+        out << ", \"samples\": [";
+        for (size_t i = 0; i < st.pass_ns_per_frame.size(); ++i) {
+            out << (i ? ", " : "") << st.pass_ns_per_frame[i];
+        }
+        out << "]}" << (s + 1 < num_stages ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+bool run_benchmark(int iterations, const char* json_path) {
+    std::vector<uint8_t> raw_data;
+    if (!read_raw_file(raw_data)) {
+        return false;
+    }
+
+    enum { DEFRAME, UNSTUFF, DECODE, ENCODE, NUM_STAGES };
+    StageStats stages[NUM_STAGES] = {
+        {"deframe", 0, PerfCounts(), std::vector<double>()},
+        {"unstuff", 0, PerfCounts(), std::vector<double>()},
+        {"decode",  0, PerfCounts(), std::vector<double>()},
+        {"encode",  0, PerfCounts(), std::vector<double>()},
+    };
+
+    PerfCounters perf;
+    if (!perf.available()) {
+        std::cerr << "Warning: hardware performance counters unavailable, reporting wall time only." << std::endl;
+    }
+
+    FrameAssembler assembler;
+    AssembledFrame frame;
+    Decoder decoder;
+    Image image;
+    std::vector<uint8_t> png;
+    long long total_frames = 0;
+
+    for (int i = 0; i < iterations; ++i) {
+        double pass_ns[NUM_STAGES] = {0, 0, 0, 0};
+        assembler.reset();
+        // Counters run just outside the clock reads, so neither timing
+        // includes the enable/disable ioctls
+        perf.start();
+        auto t0 = std::chrono::steady_clock::now();
+        assembler.push(raw_data.data(), raw_data.size());
+        assembler.finish();
+        auto t1 = std::chrono::steady_clock::now();
+        add_counts(stages[DEFRAME].counts, perf.stop());
+        pass_ns[DEFRAME] = std::chrono::duration<double, std::nano>(t1 - t0).count();
+        size_t pass_frames = assembler.frames_ready();
+
+        if (assembler.frames_ready() == 0) {
+            std::cerr << "Error: No complete JPEG frame found in \"" << RAW_FILENAME << "\"." << std::endl;
+            return false;
+        }
+
+        while (assembler.pop_frame(frame)) {
+            perf.start();
+            auto unstuff_begin = std::chrono::steady_clock::now();
+            unstuff_jpeg(frame.data);
+            auto unstuff_end = std::chrono::steady_clock::now();
+            add_counts(stages[UNSTUFF].counts, perf.stop());
+
+            perf.start();
+            auto decode_begin = std::chrono::steady_clock::now();
+            bool ok = decoder.decode(frame.data.data(), frame.data.size(), image, frame.id);
+            auto decode_end = std::chrono::steady_clock::now();
+            add_counts(stages[DECODE].counts, perf.stop());
+            if (!ok) {
+                return false;
+            }
+
+            png.clear();
+            perf.start();
+            auto encode_begin = std::chrono::steady_clock::now();
+            stbi_write_png_to_func(png_to_vector, &png, image.width, image.height, image.channels,
+                                   image.pixels.data(), image.width * image.channels);
+            auto encode_end = std::chrono::steady_clock::now();
+            add_counts(stages[ENCODE].counts, perf.stop());
+
+            pass_ns[UNSTUFF] += std::chrono::duration<double, std::nano>(unstuff_end - unstuff_begin).count();
+            pass_ns[DECODE]  += std::chrono::duration<double, std::nano>(decode_end - decode_begin).count();
+            pass_ns[ENCODE]  += std::chrono::duration<double, std::nano>(encode_end - encode_begin).count();
+        }
+
+        total_frames += pass_frames;
+        for (int s = 0; s < NUM_STAGES; ++s) {
+            stages[s].total_ns += pass_ns[s];
+            stages[s].pass_ns_per_frame.push_back(pass_ns[s] / pass_frames);
+        }
+    }
+
+    std::cout << "Benchmark: " << iterations << " passes, " << total_frames << " frames of " << image.width << "x" << image.height
+              << " from \"" << RAW_FILENAME << "\" (per-frame averages, "
+              << supercamera::cpu_level_name(supercamera::bound_cpu_level()) << " kernels)" << std::endl;
+    std::cout << std::left << std::setw(10) << "stage" << std::right << std::setw(14) << "time_us";
+    if (perf.available()) {
+        std::cout << std::setw(14) << "cycles" << std::setw(14) << "instructions" << std::setw(8) << "ipc"
+                  << std::setw(14) << "cache_miss" << std::setw(14) << "branch_miss";
+    }
+    std::cout << std::endl;
+
+    for (int s = 0; s < NUM_STAGES; ++s) {
+        const StageStats& st = stages[s];
+        double n = static_cast<double>(total_frames);
+        std::cout << std::left << std::setw(10) << st.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(14) << st.total_ns / n / 1000.0;
+        if (perf.available()) {
+            double ipc = st.counts.cycles ? static_cast<double>(st.counts.instructions) / st.counts.cycles : 0.0;
+            std::cout << std::setw(14) << (perf.has(PerfCounters::CYCLES) ? st.counts.cycles / n : 0.0)
+                      << std::setw(14) << (perf.has(PerfCounters::INSTRUCTIONS) ? st.counts.instructions / n : 0.0)
+                      << std::setw(8) << std::setprecision(2) << ipc << std::setprecision(1)
+                      << std::setw(14) << (perf.has(PerfCounters::CACHE_MISSES) ? st.counts.cache_misses / n : 0.0)
+                      << std::setw(14) << (perf.has(PerfCounters::BRANCH_MISSES) ? st.counts.branch_misses / n : 0.0);
+        }
+        std::cout << std::endl;
+    }
+
+    if (json_path) {
+        std::ofstream json(json_path);
+        if (!json.is_open()) {
+            std::cerr << "Error opening benchmark output file: " << json_path << std::endl;
+            return false;
+        }
+        write_benchmark_json(json, stages, NUM_STAGES, total_frames, image.width, image.height, perf);
+        std::cout << "Benchmark results written to \"" << json_path << "\"." << std::endl;
+    }
+    return true;
+}
+
+// --- Soak test ---
+// Replays RAW_FILENAME in a loop, paced like a live camera at `speed` times
+// real time, through a transfer queue into the same deframe/unstuff/decode
+// path a capture would feed. RSS, heap in use, queue depth and frame latency
+// are sampled over time; the run fails if any of them drifts past the
+// allowed growth relative to the first sample.
+
+const double SOAK_CAMERA_FPS       = 30.0; // Nominal stream rate the replay is paced against
+const int    SOAK_SAMPLES          = 20;   // Samples taken over the soak duration
+const double SOAK_LATENCY_FLOOR_MS = 1.0;  // Latency drift below this is treated as noise
+
+struct SoakTransfer {
+    std::vector<uint8_t> data;
+    std::chrono::steady_clock::time_point arrival;
+};
+
+struct SoakSample {
+    double elapsed_s;
+    long rss_kb;
+    long heap_kb;
+    size_t queue_depth;
+    uint64_t frames;
+    size_t window_frames; // Frames decoded in this interval; without any, p50/p99 are meaningless
+    double p50_ms;
+    double p99_ms;
+};
+
+static long current_rss_kb() {
+    std::ifstream statm("/proc/self/statm");
+    long pages_total = 0, pages_resident = 0;
+    if (!(statm >> pages_total >> pages_resident)) {
+        return 0;
+    }
+    return pages_resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static long heap_in_use_kb() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return static_cast<long>(mallinfo2().uordblks / 1024);
+#elif defined(__GLIBC__)
+    return mallinfo().uordblks / 1024;
+#else
+    return 0;
+#endif
+}
+
+static double percentile_ms(std::vector<double>& samples, double p) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    size_t k = static_cast<size_t>(p * (samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+    return samples[k];
+}
+
+bool run_soak(double duration_s, double speed, double max_growth_pct) {
+    std::vector<uint8_t> raw_data;
+    if (!read_raw_file(raw_data)) {
+        return false;
+    }
+
+    // Pace the replay so frames arrive at SOAK_CAMERA_FPS * speed
+    FrameAssembler probe;
+    probe.push(raw_data.data(), raw_data.size());
+    probe.finish();
+    if (probe.stats().frames == 0) {
+        std::cerr << "Error: No complete JPEG frame found in \"" << RAW_FILENAME << "\"." << std::endl;
+        return false;
+    }
+    double bytes_per_second = static_cast<double>(raw_data.size()) / probe.stats().frames * SOAK_CAMERA_FPS * speed;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<SoakTransfer> queue;
+    std::vector<double> latencies_ms;
+    std::atomic<uint64_t> frames_decoded(0), decode_errors(0);
+    bool producer_done = false;
+
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                std::chrono::duration<double>(duration_s));
+
+    // Stands in for the capture loop: one MAX_PACKET_SIZE transfer at a time
+    std::thread producer([&]() {
+        size_t pos = 0;
+        double bytes_sent = 0;
+        while (std::chrono::steady_clock::now() < deadline) {
+            size_t n = std::min(static_cast<size_t>(MAX_PACKET_SIZE), raw_data.size() - pos);
+            SoakTransfer transfer;
+            transfer.data.assign(raw_data.begin() + pos, raw_data.begin() + pos + n);
+            transfer.arrival = std::chrono::steady_clock::now();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                queue.push_back(std::move(transfer));
+            }
+            cv.notify_one();
+
+            pos = (pos + n == raw_data.size()) ? 0 : pos + n;
+            bytes_sent += n;
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                      std::chrono::duration<double>(bytes_sent / bytes_per_second)));
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        producer_done = true;
+        cv.notify_one();
+    });
+
+    std::thread consumer([&]() {
+        FrameAssembler assembler;
+        AssembledFrame frame;
+        Decoder decoder;
+        Image image;
+        while (true) {
+            SoakTransfer transfer;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&]() { return !queue.empty() || producer_done; });
+                if (queue.empty()) {
+                    break;
+                }
+                transfer = std::move(queue.front());
+                queue.pop_front();
+            }
+            assembler.push(transfer.data.data(), transfer.data.size());
+            while (assembler.pop_frame(frame)) {
+                unstuff_jpeg(frame.data);
+                if (!decoder.decode(frame.data.data(), frame.data.size(), image, frame.id)) {
+                    ++decode_errors;
+                    continue;
+                }
+                double latency = std::chrono::duration<double, std::milli>(
+                                     std::chrono::steady_clock::now() - transfer.arrival).count();
+                ++frames_decoded;
+                std::lock_guard<std::mutex> lock(mutex);
+                latencies_ms.push_back(latency);
+            }
+        }
+    });
+
+    std::cout << "Soak: " << duration_s << " s at " << speed << "x (" << SOAK_CAMERA_FPS * speed
+              << " fps), allowed growth " << max_growth_pct << "%" << std::endl;
+    std::cout << std::setw(8) << "t_s" << std::setw(10) << "rss_kb" << std::setw(10) << "heap_kb"
+              << std::setw(8) << "queue" << std::setw(10) << "frames" << std::setw(10) << "p50_ms"
+              << std::setw(10) << "p99_ms" << std::endl;
+
+    std::vector<SoakSample> samples;
+    double interval_s = duration_s / SOAK_SAMPLES;
+    for (int i = 1; i <= SOAK_SAMPLES; ++i) {
+        std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                  std::chrono::duration<double>(interval_s * i)));
+        SoakSample sample;
+        std::vector<double> window;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            sample.queue_depth = queue.size();
+            window.swap(latencies_ms);
+        }
+        sample.elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        sample.rss_kb = current_rss_kb();
+        sample.heap_kb = heap_in_use_kb();
+        sample.frames = frames_decoded.load();
+        sample.window_frames = window.size();
+        sample.p50_ms = percentile_ms(window, 0.50);
+        sample.p99_ms = percentile_ms(window, 0.99);
+        samples.push_back(sample);
+
+        std::cout << std::fixed << std::setprecision(1) << std::setw(8) << sample.elapsed_s
+                  << std::setw(10) << sample.rss_kb << std::setw(10) << sample.heap_kb
+                  << std::setw(8) << sample.queue_depth << std::setw(10) << sample.frames << std::setprecision(2);
+        if (sample.window_frames > 0) {
+            std::cout << std::setw(10) << sample.p50_ms << std::setw(10) << sample.p99_ms << std::endl;
+        } else {
+            std::cout << std::setw(10) << "-" << std::setw(10) << "-" << std::endl;
+        }
+    }
+
+    producer.join();
+    consumer.join();
+
+    // The baseline is the first sample with decoded frames, when buffers have
+    // warmed up (before that, p50/p99 are unset and the heap is still
+    // growing). Latency is compared against the last such sample.
+    const SoakSample* first = nullptr;
+    const SoakSample* last_timed = nullptr;
+    for (const SoakSample& sample : samples) {
+        if (sample.window_frames > 0) {
+            first = first ? first : &sample;
+            last_timed = &sample;
+        }
+    }
+    const SoakSample& last = samples.back();
+    double factor = 1.0 + max_growth_pct / 100.0;
+    size_t max_queue = static_cast<size_t>(bytes_per_second / MAX_PACKET_SIZE); // One second of backlog
+    bool passed = true;
+
+    if (!first) {
+        std::cerr << "Soak failure: no frames decoded." << std::endl;
+        passed = false;
+    } else {
+        if (last.rss_kb > first->rss_kb * factor) {
+            std::cerr << "Soak failure: RSS grew from " << first->rss_kb << " kB to " << last.rss_kb << " kB." << std::endl;
+            passed = false;
+        }
+        if (last.heap_kb > first->heap_kb * factor) {
+            std::cerr << "Soak failure: heap in use grew from " << first->heap_kb << " kB to " << last.heap_kb << " kB." << std::endl;
+            passed = false;
+        }
+        if (last_timed->p99_ms > first->p99_ms * factor && last_timed->p99_ms - first->p99_ms > SOAK_LATENCY_FLOOR_MS) {
+            std::cerr << "Soak failure: p99 latency drifted from " << first->p99_ms << " ms to "
+                      << last_timed->p99_ms << " ms." << std::endl;
+            passed = false;
+        }
+    }
+    if (last.queue_depth > max_queue) {
+        std::cerr << "Soak failure: transfer queue backed up to " << last.queue_depth
+                  << " transfers (limit " << max_queue << ")." << std::endl;
+        passed = false;
+    }
+    // The replayed capture decodes cleanly, so any error is a fault
+    if (decode_errors.load() > 0) {
+        std::cerr << "Soak failure: " << decode_errors.load() << " frames failed to decode." << std::endl;
+        passed = false;
+    }
+
+    std::cout << "Soak " << (passed ? "passed" : "FAILED") << ": " << frames_decoded.load() << " frames decoded, "
+              << decode_errors.load() << " decode errors." << std::endl;
+    return passed;
+}
+
+
+// --- Saturation benchmark ---
+// Replays the capture far faster than the camera runs into a short frame
+// queue that drops its oldest frame when full, as a capture thread that
+// cannot block would. The same load is run once at fixed full quality and
+// once under the QualityGovernor, optionally with hog_threads spinning on
+// every other core; the governed run should drop far fewer frames and keep
+// latency bounded by trading decode scale and analysis frequency instead.
+
+const size_t SATURATE_QUEUE_FRAMES = 4; // Frames the capture side may buffer
+
+struct SaturateResult {
+    uint64_t offered = 0;
+    uint64_t processed = 0;
+    uint64_t dropped = 0;
+    uint64_t analyzed = 0;
+    double p50_ms = 0;
+    double p99_ms = 0;
+    std::vector<uint64_t> frames_per_level;
+};
+
+// Stand-in for per-frame analysis: a luma histogram, cost proportional to pixels
+static uint32_t luma_histogram(const Image& image, uint32_t* histogram) {
+    std::fill(histogram, histogram + 256, 0);
+    const uint8_t* p = image.pixels.data();
+    size_t pixels = static_cast<size_t>(image.width) * image.height;
+    for (size_t i = 0; i < pixels; ++i, p += image.channels) {
+        ++histogram[(p[0] * 77 + p[1] * 150 + p[2] * 29) >> 8];
+    }
+    return histogram[128];
+}
+
+static SaturateResult run_saturate_phase(const std::vector<std::vector<uint8_t>>& frames, double duration_s,
+                                         double fps, bool governed) {
+    struct QueuedFrame {
+        size_t index;
+        uint64_t id;
+        std::chrono::steady_clock::time_point arrival;
+    };
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<QueuedFrame> queue;
+    bool producer_done = false;
+    SaturateResult result;
+    result.frames_per_level.assign(QualityGovernor::level_count(), 0);
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([&]() {
+        for (uint64_t id = 0;; ++id) {
+            auto due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                   std::chrono::duration<double>(id / fps));
+            if (due - start >= std::chrono::duration<double>(duration_s)) {
+                break;
+            }
+            std::this_thread::sleep_until(due);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queue.size() == SATURATE_QUEUE_FRAMES) {
+                queue.pop_front();
+                ++result.dropped;
+            }
+            queue.push_back(QueuedFrame{static_cast<size_t>(id % frames.size()), id, std::chrono::steady_clock::now()});
+            ++result.offered;
+            cv.notify_one();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        producer_done = true;
+        cv.notify_one();
+    });
+
+    GovernorConfig config;
+    config.frame_budget_ms = 1000.0 / fps;
+    QualityGovernor governor(config);
+    Decoder decoder;
+    Image image;
+    std::vector<uint8_t> jpeg;
+    std::vector<double> latencies_ms;
+    uint32_t histogram[256];
+    uint32_t checksum = 0;
+
+    while (true) {
+        QueuedFrame item;
+        size_t depth;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() { return !queue.empty() || producer_done; });
+            if (queue.empty()) {
+                break;
+            }
+            item = queue.front();
+            queue.pop_front();
+            depth = queue.size();
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+        jpeg = frames[item.index];
+        unstuff_jpeg(jpeg);
+        supercamera::DecodeOptions options = decoder.options();
+        governor.level().apply(options);
+        decoder.set_options(options);
+        if (decoder.decode(jpeg.data(), jpeg.size(), image, item.id)) {
+            if (!governed || governor.analysis_due()) {
+                checksum += luma_histogram(image, histogram);
+                ++result.analyzed;
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        ++result.processed;
+        ++result.frames_per_level[governor.level_index()];
+        latencies_ms.push_back(std::chrono::duration<double, std::milli>(end - item.arrival).count());
+        if (governed) {
+            governor.observe(item.id, std::chrono::duration<double, std::milli>(end - begin).count(), depth);
+        }
+    }
+    producer.join();
+
+    result.p50_ms = percentile_ms(latencies_ms, 0.50);
+    result.p99_ms = percentile_ms(latencies_ms, 0.99);
+    if (checksum == 1) {
+        std::cout << ""; // Keeps the analysis from being optimized away
+    }
+    return result;
+}
+
+bool run_saturate(double duration_s, double speed, int hog_threads) {
+    std::vector<uint8_t> raw_data;
+    if (!read_raw_file(raw_data)) {
+        return false;
+    }
+    FrameAssembler assembler;
+    assembler.push(raw_data.data(), raw_data.size());
+    assembler.finish();
+    std::vector<std::vector<uint8_t>> frames;
+    AssembledFrame frame;
+    while (assembler.pop_frame(frame)) {
+        frames.push_back(frame.data);
+    }
+    if (frames.empty()) {
+        std::cerr << "Error: No complete JPEG frame found in \"" << RAW_FILENAME << "\"." << std::endl;
+        return false;
+    }
+
+    std::atomic<bool> hogging(true);
+    std::vector<std::thread> hogs;
+    for (int i = 0; i < hog_threads; ++i) {
+        hogs.push_back(std::thread([&hogging]() {
+            volatile uint64_t x = 0;
+            while (hogging.load(std::memory_order_relaxed)) {
+                x = x + 1;
+            }
+        }));
+    }
+
+    double fps = SOAK_CAMERA_FPS * speed;
+    std::cout << "Saturate: " << duration_s << " s per run at " << speed << "x (" << fps << " fps), "
+              << hog_threads << " hog threads, queue of " << SATURATE_QUEUE_FRAMES << " frames" << std::endl;
+
+    const char* names[2] = {"fixed", "governed"};
+    SaturateResult results[2];
+    for (int run = 0; run < 2; ++run) {
+        results[run] = run_saturate_phase(frames, duration_s, fps, run == 1);
+        supercamera::log::flush();
+    }
+    hogging = false;
+    for (size_t i = 0; i < hogs.size(); ++i) {
+        hogs[i].join();
+    }
+
+    std::cout << std::setw(10) << "run" << std::setw(10) << "offered" << std::setw(10) << "processed"
+              << std::setw(10) << "dropped" << std::setw(10) << "analyzed" << std::setw(10) << "p50_ms"
+              << std::setw(10) << "p99_ms" << "  frames per level" << std::endl;
+    for (int run = 0; run < 2; ++run) {
+        const SaturateResult& r = results[run];
+        std::cout << std::setw(10) << names[run] << std::setw(10) << r.offered << std::setw(10) << r.processed
+                  << std::setw(10) << r.dropped << std::setw(10) << r.analyzed << std::fixed << std::setprecision(2)
+                  << std::setw(10) << r.p50_ms << std::setw(10) << r.p99_ms << " ";
+        for (size_t level = 0; level < r.frames_per_level.size(); ++level) {
+            std::cout << " " << QualityGovernor::level_at(level).name << "=" << r.frames_per_level[level];
+        }
+        std::cout << std::endl;
+    }
+    return true;
+}
+
+// --- Post-decode conversion benchmark ---
+// Times PixelConverter against what consumers did before: a resize pass, a
+// rotate pass and a format conversion pass over full intermediate images.
+// The separate passes use the same fixed-point arithmetic, so both paths must
+// produce identical bytes; a mismatch fails the run. The YCbCr cases convert
+// a DecodeOptions::YCbCr decode of the same frame.
+
+using supercamera::ColorSpace;
+using supercamera::ConvertSpec;
+using supercamera::ConvertedImage;
+using supercamera::PixelConverter;
+using supercamera::PixelFormat;
+using supercamera::Rotation;
+
+static void resize_pass(const Image& src, int width, int height, Image& dst) {
+    struct Tap { int i0, i1, w; };
+    auto taps = [](int out_size, int src_size) {
+        std::vector<Tap> t(out_size);
+        double ratio = static_cast<double>(src_size) / out_size;
+        for (int i = 0; i < out_size; ++i) {
+            double pos = std::min(std::max((i + 0.5) * ratio - 0.5, 0.0), src_size - 1.0);
+            int i0 = static_cast<int>(pos);
+            int w = static_cast<int>(std::lround((pos - i0) * 256));
+            if (w == 256) {
+                ++i0;
+                w = 0;
+            }
+            t[i] = Tap{i0, std::min(i0 + 1, src_size - 1), w};
+        }
+        return t;
+    };
+    std::vector<Tap> tx = taps(width, src.width), ty = taps(height, src.height);
+    dst.width = width;
+    dst.height = height;
+    dst.channels = 3;
+    dst.pixels.resize(static_cast<size_t>(width) * height * 3);
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* r0 = &src.pixels[static_cast<size_t>(ty[y].i0) * src.width * 3];
+        const uint8_t* r1 = &src.pixels[static_cast<size_t>(ty[y].i1) * src.width * 3];
+        for (int x = 0; x < width; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                uint32_t top = r0[tx[x].i0 * 3 + c] * (256 - tx[x].w) + r0[tx[x].i1 * 3 + c] * tx[x].w;
+                uint32_t bottom = r1[tx[x].i0 * 3 + c] * (256 - tx[x].w) + r1[tx[x].i1 * 3 + c] * tx[x].w;
+                dst.pixels[(static_cast<size_t>(y) * width + x) * 3 + c] =
+                    static_cast<uint8_t>((top * (256 - ty[y].w) + bottom * ty[y].w + 32768) >> 16);
+            }
+        }
+    }
+}
+
+static void rotate_pass(const Image& src, Rotation rotation, Image& dst) {
+    bool sideways = rotation == Rotation::Cw90 || rotation == Rotation::Cw270;
+    dst.width = sideways ? src.height : src.width;
+    dst.height = sideways ? src.width : src.height;
+    dst.channels = 3;
+    dst.pixels.resize(src.pixels.size());
+    for (int y = 0; y < dst.height; ++y) {
+        for (int x = 0; x < dst.width; ++x) {
+            int sx = x, sy = y;
+            if (rotation == Rotation::Cw90) {
+                sx = y;
+                sy = src.height - 1 - x;
+            } else if (rotation == Rotation::Cw180) {
+                sx = src.width - 1 - x;
+                sy = src.height - 1 - y;
+            } else if (rotation == Rotation::Cw270) {
+                sx = src.width - 1 - y;
+                sy = x;
+            }
+            std::copy_n(&src.pixels[(static_cast<size_t>(sy) * src.width + sx) * 3], 3,
+                        &dst.pixels[(static_cast<size_t>(y) * dst.width + x) * 3]);
+        }
+    }
+}
+
+static void format_pass(const Image& src, ColorSpace input, PixelFormat format, ConvertedImage& dst) {
+    auto clamp = [](int v) { return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v)); };
+    bool yuv = format == PixelFormat::NV12 || format == PixelFormat::I420;
+    if (input == ColorSpace::YCbCr && !yuv) {
+        // JFIF to RGB first
+        Image rgb = src;
+        for (size_t i = 0; i < rgb.pixels.size(); i += 3) {
+            int y = src.pixels[i], cb = src.pixels[i + 1] - 128, cr = src.pixels[i + 2] - 128;
+            rgb.pixels[i] = clamp(y + ((359 * cr + 128) >> 8));
+            rgb.pixels[i + 1] = clamp(y + ((-88 * cb - 183 * cr + 128) >> 8));
+            rgb.pixels[i + 2] = clamp(y + ((454 * cb + 128) >> 8));
+        }
+        format_pass(rgb, ColorSpace::RGB, format, dst);
+        return;
+    }
+    size_t plane = static_cast<size_t>(src.width) * src.height;
+    dst.format = format;
+    dst.width = src.width;
+    dst.height = src.height;
+    dst.data.resize(supercamera::converted_size(format, src.width, src.height));
+    const uint8_t* p = src.pixels.data();
+    bool ycbcr = input == ColorSpace::YCbCr;
+    switch (format) {
+        case PixelFormat::RGB:
+            std::copy(src.pixels.begin(), src.pixels.end(), dst.data.begin());
+            break;
+        case PixelFormat::BGR:
+        case PixelFormat::RGBA:
+            for (size_t i = 0; i < plane; ++i) {
+                if (format == PixelFormat::BGR) {
+                    dst.data[i * 3] = p[i * 3 + 2];
+                    dst.data[i * 3 + 1] = p[i * 3 + 1];
+                    dst.data[i * 3 + 2] = p[i * 3];
+                } else {
+                    std::copy_n(p + i * 3, 3, &dst.data[i * 4]);
+                    dst.data[i * 4 + 3] = 255;
+                }
+            }
+            break;
+        case PixelFormat::NV12:
+        case PixelFormat::I420:
+            for (size_t i = 0; i < plane; ++i) {
+                dst.data[i] = ycbcr ? clamp(((220 * p[i * 3] + 128) >> 8) + 16)
+                                    : clamp(((66 * p[i * 3] + 129 * p[i * 3 + 1] + 25 * p[i * 3 + 2] + 128) >> 8) + 16);
+            }
+            for (int y = 0; y < src.height; y += 2) {
+                for (int x = 0; x < src.width; x += 2) {
+                    int sum[3] = {2, 2, 2};
+                    for (int c = 0; c < 3; ++c) {
+                        for (int d = 0; d < 4; ++d) {
+                            sum[c] += p[((static_cast<size_t>(y) + d / 2) * src.width + x + d % 2) * 3 + c];
+                        }
+                    }
+                    int r = sum[0] >> 2, g = sum[1] >> 2, b = sum[2] >> 2;
+                    size_t k = static_cast<size_t>(y / 2) * (src.width / 2) + x / 2;
+                    // Full-range chroma scales by 224/255 around 128
+                    uint8_t u = ycbcr ? clamp(((225 * g) >> 8) + 16) : clamp(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+                    uint8_t v = ycbcr ? clamp(((225 * b) >> 8) + 16) : clamp(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+                    if (format == PixelFormat::I420) {
+                        dst.data[plane + k] = u;
+                        dst.data[plane + plane / 4 + k] = v;
+                    } else {
+                        dst.data[plane + 2 * k] = u;
+                        dst.data[plane + 2 * k + 1] = v;
+                    }
+                }
+            }
+            break;
+        case PixelFormat::PlanarFloat: {
+            float* out = reinterpret_cast<float*>(dst.data.data());
+            for (size_t i = 0; i < plane; ++i) {
+                for (int c = 0; c < 3; ++c) {
+                    out[c * plane + i] = p[i * 3 + c] * (1.0f / 255.0f);
+                }
+            }
+            break;
+        }
+    }
+}
+
+bool run_convert_bench(int iterations) {
+    std::vector<uint8_t> raw_data;
+    if (!read_raw_file(raw_data)) {
+        return false;
+    }
+    FrameAssembler assembler;
+    assembler.push(raw_data.data(), raw_data.size());
+    assembler.finish();
+    AssembledFrame frame;
+    Decoder decoder;
+    Image image, ycbcr_image;
+    if (!assembler.pop_frame(frame) || (unstuff_jpeg(frame.data), !decoder.decode(frame.data.data(), frame.data.size(), image))) {
+        std::cerr << "Error: No decodable frame in \"" << RAW_FILENAME << "\"." << std::endl;
+        return false;
+    }
+    Decoder ycbcr_decoder;
+    supercamera::DecodeOptions options;
+    options.format = supercamera::DecodeOptions::YCbCr;
+    ycbcr_decoder.set_options(options);
+    auto d0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        decoder.decode(frame.data.data(), frame.data.size(), image);
+    }
+    auto d1 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        ycbcr_decoder.decode(frame.data.data(), frame.data.size(), ycbcr_image);
+    }
+    auto d2 = std::chrono::steady_clock::now();
+
+    struct Case {
+        const char* name;
+        PixelFormat format;
+        int width, height; // After rotation
+        Rotation rotation;
+        ColorSpace input;
+    };
+    const Case cases[] = {
+        {"bgr 640x480",              PixelFormat::BGR,         640, 480, Rotation::None,  ColorSpace::RGB},
+        {"rgba 320x240",             PixelFormat::RGBA,        320, 240, Rotation::None,  ColorSpace::RGB},
+        {"nv12 640x480",             PixelFormat::NV12,        640, 480, Rotation::None,  ColorSpace::RGB},
+        {"nv12 480x640 cw90",        PixelFormat::NV12,        480, 640, Rotation::Cw90,  ColorSpace::RGB},
+        {"i420 240x320 cw270",       PixelFormat::I420,        240, 320, Rotation::Cw270, ColorSpace::RGB},
+        {"float 224x224",            PixelFormat::PlanarFloat, 224, 224, Rotation::None,  ColorSpace::RGB},
+        {"float 224x224 cw180",      PixelFormat::PlanarFloat, 224, 224, Rotation::Cw180, ColorSpace::RGB},
+        {"ycbcr nv12 640x480",       PixelFormat::NV12,        640, 480, Rotation::None,  ColorSpace::YCbCr},
+        {"ycbcr i420 240x320 cw270", PixelFormat::I420,        240, 320, Rotation::Cw270, ColorSpace::YCbCr},
+        {"ycbcr bgr 640x480",        PixelFormat::BGR,         640, 480, Rotation::None,  ColorSpace::YCbCr},
+    };
+
+    std::cout << "Converting " << image.width << "x" << image.height << " RGB and YCbCr, " << iterations
+              << " iterations per case, kernels: " << supercamera::cpu_level_name(supercamera::bound_cpu_level())
+              << std::endl;
+    std::cout << std::fixed << std::setprecision(1) << "Decode: "
+              << std::chrono::duration<double, std::micro>(d1 - d0).count() / iterations << " us to RGB, "
+              << std::chrono::duration<double, std::micro>(d2 - d1).count() / iterations << " us to YCbCr"
+              << std::endl;
+    std::cout << std::left << std::setw(26) << "case" << std::right << std::setw(12) << "fused_us"
+              << std::setw(14) << "separate_us" << std::setw(10) << "speedup" << std::endl;
+
+    bool identical = true;
+    for (const Case& c : cases) {
+        const Image& source = c.input == ColorSpace::YCbCr ? ycbcr_image : image;
+        ConvertSpec spec;
+        spec.format = c.format;
+        spec.input = c.input;
+        spec.width = c.width;
+        spec.height = c.height;
+        spec.rotation = c.rotation;
+        PixelConverter converter(spec);
+        ConvertedImage fused, separate;
+        Image resized, rotated;
+        bool sideways = c.rotation == Rotation::Cw90 || c.rotation == Rotation::Cw270;
+
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            converter.convert(source, fused);
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            resize_pass(source, sideways ? c.height : c.width, sideways ? c.width : c.height, resized);
+            rotate_pass(resized, c.rotation, rotated);
+            format_pass(rotated, c.input, c.format, separate);
+        }
+        auto t2 = std::chrono::steady_clock::now();
+
+        double fused_us = std::chrono::duration<double, std::micro>(t1 - t0).count() / iterations;
+        double separate_us = std::chrono::duration<double, std::micro>(t2 - t1).count() / iterations;
+        bool same = fused.data == separate.data;
+        identical = identical && same;
+        std::cout << std::left << std::setw(26) << c.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(12) << fused_us << std::setw(14) << separate_us << std::setprecision(2)
+                  << std::setw(9) << separate_us / fused_us << "x" << (same ? "" : "  OUTPUT MISMATCH") << std::endl;
+    }
+    return identical;
+}
+
+// --- Undistortion benchmark ---
+// Applies a strong barrel correction (typical of the endoscope lens) to the
+// first frame and reports the per-frame wall time as a share of the frame
+// interval at the camera's 30 fps (with one thread, the share of a core).
+
+bool run_undistort_bench(int iterations, int threads) {
+    std::vector<uint8_t> raw_data;
+    if (!read_raw_file(raw_data)) {
+        return false;
+    }
+    FrameAssembler assembler;
+    assembler.push(raw_data.data(), raw_data.size());
+    assembler.finish();
+    AssembledFrame frame;
+    Decoder decoder;
+    Image image;
+    if (!assembler.pop_frame(frame) || (unstuff_jpeg(frame.data), !decoder.decode(frame.data.data(), frame.data.size(), image))) {
+        std::cerr << "Error: No decodable frame in \"" << RAW_FILENAME << "\"." << std::endl;
+        return false;
+    }
+
+    supercamera::LensModel lens;
+    lens.fx = lens.fy = 0.6 * image.width;
+    lens.cx = (image.width - 1) / 2.0;
+    lens.cy = (image.height - 1) / 2.0;
+    lens.k1 = -0.3;
+    lens.k2 = 0.08;
+
+    auto build_start = std::chrono::steady_clock::now();
+    supercamera::Undistorter undistorter(lens, image.width, image.height, static_cast<unsigned>(threads));
+    double build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - build_start).count();
+
+    Image out;
+    undistorter.apply(image, out); // Warm up
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        undistorter.apply(image, out);
+    }
+    double frame_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+    std::cout << std::fixed << std::setprecision(2) << "Undistort " << image.width << "x" << image.height << " with "
+              << threads << " thread(s), " << supercamera::cpu_level_name(supercamera::bound_cpu_level())
+              << " kernels: table " << build_ms << " ms once, " << frame_ms << " ms/frame ("
+              << std::setprecision(1) << frame_ms * SOAK_CAMERA_FPS / 10.0 << "% of the frame interval at "
+              << SOAK_CAMERA_FPS << " fps)" << std::endl;
+    return true;
+}
+
+// --- Enhancement benchmark ---
+// Times CLAHE alone and with a gamma curve plus a 17-point color LUT, on the
+// first frame decoded as RGB and as YCbCr (equalizing Y before conversion).
+
+static double time_enhance(supercamera::Enhancer& enhancer, const Image& source, int iterations) {
+    Image image = source;
+    enhancer.apply(image); // Warm up
+    double total_ms = 0;
+    for (int i = 0; i < iterations; ++i) {
+        image.pixels = source.pixels;
+        auto start = std::chrono::steady_clock::now();
+        enhancer.apply(image);
+        total_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    return total_ms / iterations;
+}
+
+bool run_enhance_bench(int iterations, int threads) {
+    std::vector<uint8_t> raw_data;
+    if (!read_raw_file(raw_data)) {
+        return false;
+    }
+    FrameAssembler assembler;
+    assembler.push(raw_data.data(), raw_data.size());
+    assembler.finish();
+    AssembledFrame frame;
+    if (!assembler.pop_frame(frame)) {
+        std::cerr << "Error: No frame in \"" << RAW_FILENAME << "\"." << std::endl;
+        return false;
+    }
+    unstuff_jpeg(frame.data);
+    Decoder decoder;
+    Image rgb, ycbcr;
+    supercamera::DecodeOptions options;
+    bool decoded = decoder.decode(frame.data.data(), frame.data.size(), rgb);
+    options.format = supercamera::DecodeOptions::YCbCr;
+    decoder.set_options(options);
+    if (!decoded || !decoder.decode(frame.data.data(), frame.data.size(), ycbcr)) {
+        std::cerr << "Error: Could not decode the first frame." << std::endl;
+        return false;
+    }
+
+    uint8_t gamma[256];
+    supercamera::make_gamma_curve(1.4, gamma);
+    const int lut_size = 17;
+    std::vector<uint8_t> warm(lut_size * lut_size * lut_size * 3);
+    for (int b = 0, i = 0; b < lut_size; ++b) {
+        for (int g = 0; g < lut_size; ++g) {
+            for (int r = 0; r < lut_size; ++r, i += 3) {
+                warm[i] = static_cast<uint8_t>(std::min(255, r * 255 / (lut_size - 1) + 12));
+                warm[i + 1] = static_cast<uint8_t>(g * 255 / (lut_size - 1));
+                warm[i + 2] = static_cast<uint8_t>(b * 235 / (lut_size - 1));
+            }
+        }
+    }
+
+    std::cout << "Enhance " << rgb.width << "x" << rgb.height << " with " << threads << " thread(s), "
+              << supercamera::cpu_level_name(supercamera::bound_cpu_level()) << " kernels (ms/frame):" << std::endl;
+    for (int pass = 0; pass < 4; ++pass) {
+        supercamera::EnhanceConfig config;
+        config.threads = static_cast<unsigned>(threads);
+        config.color_space = (pass & 1) ? supercamera::EnhanceConfig::YCbCr : supercamera::EnhanceConfig::RGB;
+        supercamera::Enhancer enhancer(config);
+        if (pass >= 2) {
+            for (int c = 0; c < 3; ++c) {
+                enhancer.set_curve(c, gamma);
+            }
+            enhancer.set_color_lut(lut_size, warm);
+        }
+        double frame_ms = time_enhance(enhancer, (pass & 1) ? ycbcr : rgb, iterations);
+        std::cout << "  " << std::left << std::setw(30)
+                  << std::string((pass & 1) ? "YCbCr" : "RGB") + (pass >= 2 ? " CLAHE + curves + 3D LUT" : " CLAHE")
+                  << std::right << std::fixed << std::setprecision(2) << std::setw(8) << frame_ms << std::endl;
+    }
+    return true;
+}
+
+// --- Temporal denoise benchmark ---
+// Runs the recursive filter over the capture's frames in order (looping if
+// there are fewer than the iteration count), so motion between real frames
+// sets the per-block weights. The copy of each input frame is not timed.
+
+const size_t DENOISE_BENCH_FRAMES = 30;
+
+bool run_denoise_bench(int iterations, int threads) {
+    std::vector<uint8_t> raw_data;
+    if (!read_raw_file(raw_data)) {
+        return false;
+    }
+    FrameAssembler assembler;
+    assembler.push(raw_data.data(), raw_data.size());
+    assembler.finish();
+    Decoder decoder;
+    std::vector<Image> frames;
+    AssembledFrame frame;
+    while (frames.size() < DENOISE_BENCH_FRAMES && assembler.pop_frame(frame)) {
+        unstuff_jpeg(frame.data);
+        Image image;
+        if (decoder.decode(frame.data.data(), frame.data.size(), image)) {
+            frames.push_back(image);
+        }
+    }
+    if (frames.empty()) {
+        std::cerr << "Error: No decodable frame in \"" << RAW_FILENAME << "\"." << std::endl;
+        return false;
+    }
+
+    supercamera::DenoiseConfig config;
+    config.threads = static_cast<unsigned>(threads);
+    supercamera::TemporalDenoiser denoiser(config);
+    Image image = frames[0];
+    denoiser.apply(image); // Seeds the state
+    double total_ms = 0, moving = 0;
+    for (int i = 0; i < iterations; ++i) {
+        image.pixels = frames[(i + 1) % frames.size()].pixels;
+        auto start = std::chrono::steady_clock::now();
+        denoiser.apply(image);
+        total_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        moving += denoiser.moving_fraction();
+    }
+
+    std::cout << std::fixed << std::setprecision(2) << "Denoise " << image.width << "x" << image.height << " over "
+              << frames.size() << " frame(s) with " << threads << " thread(s), "
+              << supercamera::cpu_level_name(supercamera::bound_cpu_level()) << " kernels: " << total_ms / iterations
+              << " ms/frame, " << std::setprecision(1) << 100.0 * moving / iterations << "% of blocks moving" << std::endl;
+    return true;
+}
+
+// --- Decode statistics benchmark ---
+// Compares statistics taken while decoding with a decode followed by a
+// separate pass over the image (what each analytic used to do), and with
+// the DC-only coarse statistics, on the capture's first frame.
+
+static void stats_pass(const Image& image, supercamera::ImageStats& stats) {
+    stats = supercamera::ImageStats();
+    stats.source = supercamera::ImageStats::Pixels;
+    stats.channels = image.channels;
+    size_t n = static_cast<size_t>(image.width) * image.height;
+    const uint8_t* p = image.pixels.data();
+    for (size_t i = 0; i < n; ++i, p += image.channels) {
+        for (int c = 0; c < image.channels; ++c) {
+            ++stats.histogram[c][p[c]];
+        }
+    }
+    stats.samples = n;
+}
+
+bool run_stats_bench(int iterations) {
+    std::vector<uint8_t> raw_data;
+    if (!read_raw_file(raw_data)) {
+        return false;
+    }
+    FrameAssembler assembler;
+    assembler.push(raw_data.data(), raw_data.size());
+    assembler.finish();
+    AssembledFrame frame;
+    if (!assembler.pop_frame(frame)) {
+        std::cerr << "Error: No frame in \"" << RAW_FILENAME << "\"." << std::endl;
+        return false;
+    }
+    unstuff_jpeg(frame.data);
+    const uint8_t* jpeg = frame.data.data();
+    size_t size = frame.data.size();
+
+    Decoder plain, with_stats;
+    supercamera::DecodeOptions options;
+    options.stats = true;
+    with_stats.set_options(options);
+    Image image;
+    supercamera::ImageStats separate, coarse;
+    if (!plain.decode(jpeg, size, image)) {
+        std::cerr << "Error: Could not decode the first frame." << std::endl;
+        return false;
+    }
+
+    auto time_ms = [&](const std::function<void()>& fn) {
+        fn(); // Warm up
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            fn();
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+    };
+    double decode_ms = time_ms([&]() { plain.decode(jpeg, size, image); });
+    double separate_ms = time_ms([&]() { plain.decode(jpeg, size, image); stats_pass(image, separate); });
+    double during_ms = time_ms([&]() { with_stats.decode(jpeg, size, image); });
+    double coarse_ms = time_ms([&]() { plain.coarse_stats(jpeg, size, coarse); });
+
+    const supercamera::ImageStats& s = image.stats;
+    std::cout << std::fixed << std::setprecision(2) << "Decode " << image.width << "x" << image.height
+              << " (ms/frame):" << std::endl
+              << "  decode only                 " << std::setw(7) << decode_ms << std::endl
+              << "  decode, then stats pass     " << std::setw(7) << separate_ms << std::endl
+              << "  stats during decode         " << std::setw(7) << during_ms << std::endl
+              << "  coarse stats (DC only)      " << std::setw(7) << coarse_ms << std::endl
+              << std::setprecision(1) << "Mean RGB: " << s.mean[0] << " " << s.mean[1] << " " << s.mean[2]
+              << " (coarse " << coarse.mean[0] << " " << coarse.mean[1] << " " << coarse.mean[2] << "), clipped "
+              << s.clipped_high[0] + s.clipped_high[1] + s.clipped_high[2] << " high / "
+              << s.clipped_low[0] + s.clipped_low[1] + s.clipped_low[2] << " low" << std::endl;
+    bool same = separate.samples == s.samples &&
+                std::equal(&separate.histogram[0][0], &separate.histogram[0][0] + 3 * 256, &s.histogram[0][0]);
+    if (!same) {
+        std::cerr << "Error: Histograms from the decode and the separate pass differ." << std::endl;
+    }
+    return same;
+}
+
+// --- Pyramid benchmark ---
+// Compares one decode into a four-level pyramid with decoding the frame once
+// per scale through the IDCT (1/1, 1/2, 1/4, 1/8), on the capture's first
+// frame, and checks the levels against a separate build() from level 0.
+
+bool run_pyramid_bench(int iterations) {
+    std::vector<uint8_t> raw_data;
+    if (!read_raw_file(raw_data)) {
+        return false;
+    }
+    FrameAssembler assembler;
+    assembler.push(raw_data.data(), raw_data.size());
+    assembler.finish();
+    AssembledFrame frame;
+    if (!assembler.pop_frame(frame)) {
+        std::cerr << "Error: No frame in \"" << RAW_FILENAME << "\"." << std::endl;
+        return false;
+    }
+    unstuff_jpeg(frame.data);
+    const uint8_t* jpeg = frame.data.data();
+    size_t size = frame.data.size();
+
+    const int levels = 4;
+    Decoder decoder;
+    Decoder scaled[levels];
+    for (int i = 0; i < levels; ++i) {
+        supercamera::DecodeOptions options;
+        options.scale_denom = 1u << i;
+        scaled[i].set_options(options);
+    }
+    Image images[levels];
+    supercamera::Pyramid pyramid;
+    if (!decoder.decode_pyramid(jpeg, size, pyramid, levels)) {
+        std::cerr << "Error: Could not decode the first frame." << std::endl;
+        return false;
+    }
+
+    auto time_ms = [&](const std::function<void()>& fn) {
+        fn(); // Warm up
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            fn();
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+    };
+    double decode_ms = time_ms([&]() { scaled[0].decode(jpeg, size, images[0]); });
+    double per_scale_ms = time_ms([&]() {
+        for (int i = 0; i < levels; ++i) {
+            scaled[i].decode(jpeg, size, images[i]);
+        }
+    });
+    double pyramid_ms = time_ms([&]() { decoder.decode_pyramid(jpeg, size, pyramid, levels); });
+
+    std::cout << std::fixed << std::setprecision(2) << "Pyramid";
+    for (size_t i = 0; i < pyramid.levels.size(); ++i) {
+        std::cout << (i ? ", " : " ") << pyramid.levels[i].width << "x" << pyramid.levels[i].height;
+    }
+    std::cout << " (ms/frame):" << std::endl
+              << "  full decode only            " << std::setw(7) << decode_ms << std::endl
+              << "  one decode per scale        " << std::setw(7) << per_scale_ms << std::endl
+              << "  pyramid from one decode     " << std::setw(7) << pyramid_ms << std::endl;
+
+    supercamera::Pyramid rebuilt = pyramid;
+    std::fill(rebuilt.pixels.begin() + rebuilt.levels[1].offset, rebuilt.pixels.end(), 0);
+    rebuilt.build();
+    if (rebuilt.pixels != pyramid.pixels) {
+        std::cerr << "Error: Levels halved during the decode differ from build()." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// --- Resilient decode benchmark ---
+// Damages a share of the capture's frames the way a marginal USB link does
+// (cut short at a random point, or one 512-byte packet lost from the middle)
+// and counts how many frames a strict and a resilient decoder deliver.
+
+bool run_resilient_bench(double damaged_pct) {
+    std::vector<uint8_t> raw_data;
+    if (!read_raw_file(raw_data)) {
+        return false;
+    }
+    FrameAssembler assembler;
+    assembler.push(raw_data.data(), raw_data.size());
+    assembler.finish();
+
+    Decoder strict, resilient;
+    supercamera::DecodeOptions options;
+    options.resilient = true;
+    resilient.set_options(options);
+    Image strict_image, resilient_image;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    uint64_t frames = 0, damaged = 0, strict_ok = 0, resilient_ok = 0, partial = 0;
+    double kept = 0;
+    AssembledFrame frame;
+    while (assembler.pop_frame(frame)) {
+        unstuff_jpeg(frame.data);
+        std::vector<uint8_t>& jpeg = frame.data;
+        ++frames;
+        if (uniform(rng) * 100 < damaged_pct) {
+            ++damaged;
+            size_t at = static_cast<size_t>(uniform(rng) * jpeg.size());
+            if (frames % 2) {
+                jpeg.resize(at);
+            } else {
+                jpeg.erase(jpeg.begin() + at, jpeg.begin() + std::min(jpeg.size(), at + 512));
+            }
+        }
+        strict_ok += strict.decode(jpeg.data(), jpeg.size(), strict_image) &&
+                     strict_image.valid_rows == strict_image.height;
+        if (resilient.decode(jpeg.data(), jpeg.size(), resilient_image)) {
+            ++resilient_ok;
+            if (resilient_image.valid_rows < resilient_image.height) {
+                ++partial;
+                kept += static_cast<double>(resilient_image.valid_rows) / resilient_image.height;
+            }
+        }
+    }
+    supercamera::log::flush();
+    if (frames == 0) {
+        std::cerr << "Error: No frame in \"" << RAW_FILENAME << "\"." << std::endl;
+        return false;
+    }
+
+    std::cout << std::fixed << std::setprecision(1) << "Resilient decode: " << frames << " frames, " << damaged
+              << " damaged" << std::endl
+              << "  strict, intact frames        " << std::setw(6) << strict_ok << std::endl
+              << "  resilient, frames delivered  " << std::setw(6) << resilient_ok << " (" << partial
+              << " partial, " << (partial ? 100.0 * kept / partial : 0.0) << "% of their rows kept)" << std::endl;
+    return true;
+}
+
+// --- Packet loss benchmark ---
+// Replays the capture `passes` times with a share of its 512-byte packets
+// lost whole or cut short in transfer, then reports what the deframer
+// caught and how many delivered frames decode without damage.
+
+bool run_packet_loss_bench(double loss_pct, int passes) {
+    std::vector<uint8_t> raw_data;
+    if (!read_raw_file(raw_data)) {
+        return false;
+    }
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::vector<uint8_t> stream;
+    uint64_t lost = 0, cut = 0;
+    for (int pass = 0; pass < passes; ++pass) {
+        for (size_t pos = 0, n = 0; pos < raw_data.size(); pos += n) {
+            // A frame's last packet is short, so find where the next one starts
+            n = 3;
+            while (pos + n < raw_data.size() && n < MAX_PACKET_SIZE &&
+                   !(raw_data[pos + n] == 0xAA && pos + n + 2 < raw_data.size() && raw_data[pos + n + 1] == 0xBB &&
+                     raw_data[pos + n + 2] == 0x07)) {
+                ++n;
+            }
+            n = std::min(n, raw_data.size() - pos);
+            if (uniform(rng) * 100 < loss_pct) {
+                if ((lost + cut) % 2 == 0) {
+                    ++lost;
+                    continue;
+                }
+                ++cut;
+                size_t kept = FrameAssembler::PACKET_HEADER_SIZE +
+                              static_cast<size_t>(uniform(rng) * (n - FrameAssembler::PACKET_HEADER_SIZE));
+                stream.insert(stream.end(), raw_data.begin() + pos, raw_data.begin() + pos + kept);
+                continue;
+            }
+            stream.insert(stream.end(), raw_data.begin() + pos, raw_data.begin() + pos + n);
+        }
+    }
+
+    FrameAssembler assembler;
+    assembler.set_check_packet_sizes(true);
+    assembler.push(stream.data(), stream.size());
+    assembler.finish();
+    Decoder decoder;
+    supercamera::DecodeOptions options;
+    options.resilient = true;
+    decoder.set_options(options);
+    Image image;
+    uint64_t delivered = 0, intact = 0;
+    AssembledFrame frame;
+    while (assembler.pop_frame(frame)) {
+        ++delivered;
+        unstuff_jpeg(frame.data);
+        intact += decoder.decode(frame.data.data(), frame.data.size(), image) && image.valid_rows == image.height;
+    }
+    supercamera::log::flush();
+
+    const FrameAssembler::Stats& stats = assembler.stats();
+    std::cout << "Packet loss: " << stats.packets << " packets, " << lost << " lost whole, " << cut << " cut short"
+              << std::endl
+              << "  packet gaps " << stats.packet_gaps << ", resyncs " << stats.resyncs << ", damaged frames dropped "
+              << stats.damaged_frames << std::endl
+              << "  frames delivered " << delivered << ", decoded without damage " << intact << std::endl;
+    return true;
+}
+
+// --- Zero-copy benchmark ---
+// Emulates the device side of a capture without hardware: the capture sits
+// in memory standing in for the buffers the host controller DMAs into, and
+// is consumed in transfer_size transfers. The copy path first copies each
+// transfer into a separate user buffer, as usbfs does for ordinary buffers;
+// the zero-copy path feeds the deframer straight from the DMA memory, as
+// Camera does with CameraConfig::zero_copy on a host that supports it.
+
+struct ZeroCopyResult {
+    double seconds;
+    uint64_t frames;
+    uint64_t copied_bytes;
+};
+
+static ZeroCopyResult run_zero_copy_phase(const std::vector<uint8_t>& dma, int passes, int transfer_size,
+                                          bool copy) {
+    FrameAssembler assembler;
+    std::vector<uint8_t> user_buffer(transfer_size);
+    ZeroCopyResult result = {0, 0, 0};
+    AssembledFrame frame;
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < passes; ++pass) {
+        for (size_t pos = 0; pos < dma.size(); pos += transfer_size) {
+            size_t n = std::min(dma.size() - pos, static_cast<size_t>(transfer_size));
+            const uint8_t* received = dma.data() + pos;
+            if (copy) {
+                std::memcpy(user_buffer.data(), received, n);
+                received = user_buffer.data();
+                result.copied_bytes += n;
+            }
+            assembler.push(received, n);
+            while (assembler.pop_frame(frame)) {
+                ++result.frames;
+            }
+        }
+    }
+    assembler.finish();
+    while (assembler.pop_frame(frame)) {
+        ++result.frames;
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+bool run_zero_copy_bench(int passes, int transfer_size) {
+    std::vector<uint8_t> raw_data;
+    if (!read_raw_file(raw_data)) {
+        return false;
+    }
+    // One warm-up pass each, so neither path pays for first-touch page faults
+    run_zero_copy_phase(raw_data, 1, transfer_size, true);
+    run_zero_copy_phase(raw_data, 1, transfer_size, false);
+    ZeroCopyResult copied = run_zero_copy_phase(raw_data, passes, transfer_size, true);
+    ZeroCopyResult direct = run_zero_copy_phase(raw_data, passes, transfer_size, false);
+    if (copied.frames != direct.frames) {
+        std::cerr << "Error: " << copied.frames << " frames via the copy, " << direct.frames << " without."
+                  << std::endl;
+        return false;
+    }
+
+    double mb = static_cast<double>(raw_data.size()) * passes / (1024.0 * 1024.0);
+    std::cout << std::fixed << std::setprecision(2) << "Zero-copy receive: " << passes << " passes of "
+              << raw_data.size() << " bytes in " << transfer_size << "-byte transfers, " << direct.frames
+              << " frames" << std::endl
+              << "  copy to user buffer  " << std::setw(8) << copied.seconds * 1000 << " ms  " << std::setw(8)
+              << mb / copied.seconds << " MB/s  (" << copied.copied_bytes / (1024 * 1024) << " MB copied)"
+              << std::endl
+              << "  zero-copy            " << std::setw(8) << direct.seconds * 1000 << " ms  " << std::setw(8)
+              << mb / direct.seconds << " MB/s  (0 MB copied)" << std::endl
+              << "  saved                " << std::setw(8) << (copied.seconds - direct.seconds) * 1000 << " ms  ("
+              << 100.0 * (copied.seconds - direct.seconds) / copied.seconds << "%)" << std::endl;
+    return true;
+}
+
+// --- Transfer tuner check ---
+// Table-driven check of pick_transfer_settings() and of which settings lines
+// load, independent of any USB hardware.
+
+struct TrialSpec {
+    int transfer_size;
+    int transfers_in_flight;
+    bool ok;
+    double kb_per_s;
+    double latency_ms;
+    double max_latency_ms;
+    double cpu_pct;
+};
+
+struct PickCase {
+    const char* name;
+    std::vector<TrialSpec> trials;
+    bool picked;             // Expected result of pick_transfer_settings()
+    int transfer_size;       // Expected choice, if picked
+    int transfers_in_flight;
+    unsigned timeout_ms;
+};
+
+struct LoadCase {
+    const char* line;
+    bool loads;
+};
+
+bool run_tuner_check() {
+    using supercamera::TransferSettings;
+    using supercamera::TransferTrial;
+
+    // Default TunerConfig: 95% throughput share, 35 ms latency target, 1% CPU
+    // tolerance, timeout 4x the worst wait within 250..1000 ms
+    const PickCase pick_cases[] = {
+        {"no trial succeeded", {{512, 1, false, 900, 5, 10, 1}, {4096, 2, false, 900, 5, 10, 1}}, false, 0, 0, 0},
+        {"only the fastest keeps up", {{512, 1, true, 400, 5, 10, 1}, {16384, 4, true, 900, 20, 30, 2}},
+         true, 16384, 4, 250},
+        {"latency target over CPU", {{65536, 8, true, 900, 60, 80, 0.5}, {4096, 4, true, 890, 20, 25, 3}},
+         true, 4096, 4, 250},
+        {"nothing meets the target: lowest latency", {{65536, 8, true, 900, 90, 100, 1}, {16384, 8, true, 900, 50, 70, 1}},
+         true, 16384, 8, 280},
+        {"CPU within tolerance: least memory", {{65536, 4, true, 900, 10, 20, 2.0}, {4096, 4, true, 900, 12, 20, 2.8}},
+         true, 4096, 4, 250},
+        {"CPU beyond tolerance: lowest CPU", {{65536, 4, true, 900, 10, 20, 2.0}, {4096, 4, true, 900, 12, 20, 3.5}},
+         true, 65536, 4, 250},
+        {"equal memory: lower latency", {{16384, 2, true, 900, 15, 20, 1}, {8192, 4, true, 900, 8, 20, 1}},
+         true, 8192, 4, 250},
+        {"timeout clamped to the maximum", {{4096, 2, true, 900, 30, 400, 1}}, true, 4096, 2, 1000},
+        {"failed trials are ignored", {{512, 1, true, 500, 5, 10, 1}, {65536, 8, false, 5000, 1, 1, 0}},
+         true, 512, 1, 250},
+    };
+    const LoadCase load_cases[] = {
+        {"dev 4096 4 500", true},
+        {"dev 65536 64 1000", true},
+        {"dev 1000 4 500", false},    // Not a multiple of the packet size
+        {"dev 0 4 500", false},
+        {"dev -512 4 500", false},
+        {"dev 2097152 4 500", false}, // Beyond MAX_TRANSFER_SIZE
+        {"dev 4096 0 500", false},
+        {"dev 4096 65 500", false},   // Beyond MAX_TRANSFERS_IN_FLIGHT
+        {"dev 4096 4 0", false},      // Would never time out
+        {"dev 4096 4", false},
+        {"dev", false},
+    };
+
+    supercamera::TunerConfig config;
+    int failures = 0;
+    for (const PickCase& c : pick_cases) {
+        std::vector<TransferTrial> trials;
+        for (const TrialSpec& spec : c.trials) {
+            TransferTrial trial;
+            trial.settings.transfer_size = spec.transfer_size;
+            trial.settings.transfers_in_flight = spec.transfers_in_flight;
+            trial.ok = spec.ok;
+            trial.bytes_per_s = spec.kb_per_s * 1024;
+            trial.latency_ms = spec.latency_ms;
+            trial.max_latency_ms = spec.max_latency_ms;
+            trial.cpu_pct = spec.cpu_pct;
+            trials.push_back(trial);
+        }
+        TransferSettings best;
+        bool picked = supercamera::pick_transfer_settings(trials, config, best);
+        bool pass = picked == c.picked &&
+                    (!picked || (best.transfer_size == c.transfer_size &&
+                                 best.transfers_in_flight == c.transfers_in_flight &&
+                                 best.transfer_timeout_ms == c.timeout_ms));
+        std::cout << (pass ? "  ok    " : "  FAIL  ") << "pick: " << c.name;
+        if (!pass && picked) {
+            std::cout << " (got " << best.transfers_in_flight << " x " << best.transfer_size << " bytes, "
+                      << best.transfer_timeout_ms << " ms)";
+        } else if (!pass) {
+            std::cout << " (got nothing)";
+        }
+        std::cout << std::endl;
+        failures += pass ? 0 : 1;
+    }
+
+    std::string path = "tuner_check." + std::to_string(getpid()) + ".txt";
+    supercamera::log::set_min_level(supercamera::log::Level::Error); // The rejects warn by design
+    for (const LoadCase& c : load_cases) {
+        {
+            std::ofstream out(path.c_str(), std::ios::trunc);
+            out << "other 512 1 250\n" << c.line << "\n";
+        }
+        TransferSettings loaded;
+        bool pass = supercamera::load_transfer_settings(path, "dev", loaded) == c.loads;
+        std::cout << (pass ? "  ok    " : "  FAIL  ") << "load \"" << c.line << "\": "
+                  << (c.loads ? "accepted" : "rejected") << std::endl;
+        failures += pass ? 0 : 1;
+    }
+    supercamera::log::flush();
+    supercamera::log::set_min_level(supercamera::log::Level::Debug);
+    std::remove(path.c_str());
+
+    std::cout << "Transfer tuner check: " << failures << " of "
+              << (sizeof(pick_cases) / sizeof(pick_cases[0]) + sizeof(load_cases) / sizeof(load_cases[0]))
+              << " cases failed" << std::endl;
+    return failures == 0;
+}
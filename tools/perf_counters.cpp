@@ -0,0 +1,99 @@
+#include "perf_counters.h"
+
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+static int open_counter(uint64_t config, int group_fd) {
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = (group_fd < 0) ? 1 : 0; // Members follow the leader
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0));
+}
+#endif
+
+PerfCounters::PerfCounters() : num_open_(0), leader_fd_(-1) {
+    for (int i = 0; i < NUM_COUNTERS; ++i) {
+        fds_[i] = -1;
+        order_[i] = -1;
+    }
+#if defined(__linux__)
+    const uint64_t configs[NUM_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+    };
+    for (int i = 0; i < NUM_COUNTERS; ++i) {
+        int fd = open_counter(configs[i], leader_fd_);
+        if (fd < 0) {
+            continue;
+        }
+        if (leader_fd_ < 0) {
+            leader_fd_ = fd;
+        }
+        fds_[i] = fd;
+        order_[num_open_++] = i;
+    }
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#if defined(__linux__)
+    for (int i = 0; i < NUM_COUNTERS; ++i) {
+        if (fds_[i] >= 0) {
+            close(fds_[i]);
+        }
+    }
+#endif
+}
+
+void PerfCounters::start() {
+#if defined(__linux__)
+    if (leader_fd_ < 0) {
+        return;
+    }
+    ioctl(leader_fd_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader_fd_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+PerfCounts PerfCounters::stop() {
+    PerfCounts counts;
+#if defined(__linux__)
+    if (leader_fd_ < 0) {
+        return counts;
+    }
+    ioctl(leader_fd_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    // PERF_FORMAT_GROUP layout: { nr, values[nr] }
+    uint64_t buf[1 + NUM_COUNTERS];
+    ssize_t n = read(leader_fd_, buf, sizeof(buf));
+    if (n < static_cast<ssize_t>(sizeof(uint64_t))) {
+        return counts;
+    }
+    uint64_t nr = buf[0];
+    for (uint64_t k = 0; k < nr && k < static_cast<uint64_t>(num_open_); ++k) {
+        uint64_t value = buf[1 + k];
+        switch (order_[k]) {
+            case CYCLES:        counts.cycles = value; break;
+            case INSTRUCTIONS:  counts.instructions = value; break;
+            case CACHE_MISSES:  counts.cache_misses = value; break;
+            case BRANCH_MISSES: counts.branch_misses = value; break;
+        }
+    }
+#endif
+    return counts;
+}
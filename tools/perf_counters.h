@@ -0,0 +1,44 @@
+#ifndef CAMERA_PERF_COUNTERS_H
+#define CAMERA_PERF_COUNTERS_H
+
+#include <cstdint>
+
+// Hardware counters read around one pipeline stage
+struct PerfCounts {
+    uint64_t cycles        = 0;
+    uint64_t instructions  = 0;
+    uint64_t cache_misses  = 0;
+    uint64_t branch_misses = 0;
+};
+
+// Thin perf_event_open wrapper counting user-space cycles, instructions,
+// cache misses and branch misses of the calling thread as one event group.
+// Counters the kernel or hypervisor refuses (containers, VMs, a strict
+// perf_event_paranoid) are skipped; if none can be opened available()
+// returns false and stop() always reports zeros.
+// start() and stop() are ioctls: bracket the clock reads with them, not
+// the other way round, so wall times leave the syscalls out.
+class PerfCounters {
+public:
+    enum Counter { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, NUM_COUNTERS };
+
+    PerfCounters();
+    ~PerfCounters();
+
+    bool available() const { return leader_fd_ >= 0; }
+    bool has(Counter c) const { return fds_[c] >= 0; }
+
+    void start();
+    PerfCounts stop();
+
+private:
+    PerfCounters(const PerfCounters&);
+    PerfCounters& operator=(const PerfCounters&);
+
+    int fds_[NUM_COUNTERS];
+    int order_[NUM_COUNTERS]; // Counter index of each group member, in read order
+    int num_open_;
+    int leader_fd_;
+};
+
+#endif // CAMERA_PERF_COUNTERS_H